@@ -0,0 +1,121 @@
+/**
+ * Drives many concurrent coroutine games from one thread. Each game pits
+ * a RemotePlayer, whose moves this driver delivers, against the GENIOUS
+ * strategy. Reports the frame memory per game, the RSS per game, games
+ * per second and the cost of one suspend/resume round trip.
+ *
+ *   coroutine_games [--games N] [--rounds R]
+ */
+#include "game_task.h"
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <memory>
+#include <string>
+#include <vector>
+using namespace std;
+
+typedef chrono::steady_clock Clock;
+
+long residentBytes() {
+  ifstream status("/proc/self/status");
+  string key;
+  while (status >> key) {
+    if (key == "VmRSS:") { long kb; status >> kb; return kb * 1024; }
+  }
+  return 0;
+}
+
+/** One hosted game and its remote user. */
+struct Slot {
+  explicit Slot(Scheduler& s): user(s), computer(GENIOUS) {}
+  RemotePlayer   user;
+  ComputerPlayer computer;
+  task<Outcome>  game;
+};
+
+/** Pick a random empty cell of the position the user is asked to move in. */
+int randomMove(const RemotePlayer& player) {
+  int (*board)[3] = player.board();
+  int empty[9], n = 0;
+  for (int i = 0; i < 9; i++) { if (board[i / 3][i % 3] == EMPTY) { empty[n++] = i; } }
+  return empty[rand() % n];
+}
+
+/**
+ * Cost of suspending a coroutine on a RemotePlayer and resuming it
+ * through the scheduler, without any game logic in between.
+ */
+task<Outcome> pingPong(RemotePlayer& player, long rounds) {
+  int board[3][3] = {};
+  for (long i = 0; i < rounds; i++) { co_await player.nextMove(board, USER); }
+  co_return Outcome{DRAW, 0, {}};
+}
+
+int main(int argc, char* argv[]) {
+  int  games  = 100000;
+  long rounds = 10000000;
+  for (int i = 1; i + 1 < argc; i += 2) {
+    string key = argv[i];
+    if      (key == "--games")  { games  = atoi(argv[i + 1]); }
+    else if (key == "--rounds") { rounds = atol(argv[i + 1]); }
+    else { fprintf(stderr, "unknown option %s\n", key.c_str()); return 1; }
+  }
+
+  Scheduler scheduler;
+
+  // 1. Start every game; each suspends as soon as the remote user must move
+  long rssBefore = residentBytes();
+  vector<unique_ptr<Slot>> slots;
+  slots.reserve(games);
+  for (int i = 0; i < games; i++) {
+    slots.emplace_back(new Slot(scheduler));
+    Slot& slot = *slots.back();
+    slot.game = playGame(slot.user, slot.computer, (i % 2) ? USER : COMPUTER);
+    slot.game.start();
+  }
+  long rssAfter = residentBytes();
+  size_t frameBytes = FramePool::bytesInUse();
+  size_t frames = FramePool::framesInUse();
+
+  // 2. Feed the users' moves until every game has finished
+  Clock::time_point start = Clock::now();
+  long resumes = 0;
+  size_t live = games;
+  while (live > 0) {
+    live = 0;
+    for (unique_ptr<Slot>& slot : slots) {
+      if (slot->user.waiting()) {
+        slot->user.deliver(randomMove(slot->user));
+        resumes++;
+      }
+      if (!slot->game.done()) { live++; }
+    }
+    scheduler.run();
+  }
+  double playSeconds = chrono::duration<double>(Clock::now() - start).count();
+
+  int results[DRAW + 1] = {};
+  for (unique_ptr<Slot>& slot : slots) { results[slot->game.result().status]++; }
+
+  // 3. Bare suspend/resume cost
+  RemotePlayer ping(scheduler);
+  task<Outcome> pinger = pingPong(ping, rounds);
+  pinger.start();
+  start = Clock::now();
+  while (!pinger.done()) {
+    ping.deliver(0);
+    scheduler.run();
+  }
+  double pingSeconds = chrono::duration<double>(Clock::now() - start).count();
+
+  printf("games:                 %d\n", games);
+  printf("frame bytes/game:      %.1f\n", double(frameBytes) / frames);
+  printf("rss bytes/game:        %.1f\n", double(rssAfter - rssBefore) / games);
+  printf("games/sec:             %.0f\n", games / playSeconds);
+  printf("ns/resumed move:       %.1f\n", playSeconds * 1e9 / resumes);
+  printf("ns/suspend+resume:     %.1f\n", pingSeconds * 1e9 / rounds);
+  printf("user/computer/draw:    %d/%d/%d\n", results[USER_WON], results[COMPUTER_WON], results[DRAW]);
+  return 0;
+}
@@ -0,0 +1,185 @@
+/**
+ * Runs the reference rules of engine.cpp side by side with every other
+ * implementation of them in the tree, over every move sequence of every
+ * game from the empty board with either player first, and stops at the
+ * first disagreements:
+ *
+ *   isGameOver      bitboardStatus, the status a Session keeps
+ *   encodeBoard     bitboardCode
+ *   playerCanWin    bitboardWinningCell, for both players
+ *   smartPreference, geniousPreference   the built-in move tables
+ *
+ *   differential [--passes N]
+ *
+ * Also checks the walk itself (5478 distinct positions and 255168 games
+ * for each first mover), then times each pair over the distinct
+ * positions. A new kernel lands here first: add it next to the one it
+ * replaces. Exits with 1 on any disagreement.
+ */
+#include "bitboard.h"
+#include "move_table.h"
+#include "session.h"
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+#include <vector>
+using namespace std;
+
+typedef chrono::steady_clock Clock;
+
+struct Options {
+  int passes = 200;
+};
+
+struct Position {
+  int      board[3][3];
+  unsigned user;
+  unsigned computer;
+};
+
+/** What the walk found. */
+struct Walk {
+  long             nodes = 0;
+  long             games = 0;
+  long             disagreements = 0;
+  vector<bool>     seen = vector<bool>(POSITION_CODES);
+  vector<Position> positions;   // distinct, in the order first reached
+};
+
+const MoveTables* tables;
+
+int cellIndex(Cell cell) { return (cell.row < 0) ? -1 : cell.row * 3 + cell.col; }
+
+void disagree(Walk& walk, const char* what, const Position& p, int reference, int other) {
+  if (walk.disagreements++ < 10) {
+    printf("  %s differs at position %d: %d, not %d\n", what, bitboardCode(p.user, p.computer), other, reference);
+  }
+}
+
+/** Check position `p`, which `session` has reached too. */
+void check(Walk& walk, Position& p, const Session& session) {
+  int status = isGameOver(p.board);
+  if (bitboardStatus(p.user, p.computer) != status) {
+    disagree(walk, "bitboardStatus", p, status, bitboardStatus(p.user, p.computer));
+  }
+  if (session.status != status) { disagree(walk, "Session status", p, status, session.status); }
+  int code = encodeBoard(p.board);
+  if (bitboardCode(p.user, p.computer) != code) {
+    disagree(walk, "bitboardCode", p, code, bitboardCode(p.user, p.computer));
+  }
+  int userWins = cellIndex(playerCanWin(p.board, USER));
+  int computerWins = cellIndex(playerCanWin(p.board, COMPUTER));
+  if (bitboardWinningCell(p.user, p.computer) != userWins) {
+    disagree(walk, "bitboardWinningCell (user)", p, userWins, bitboardWinningCell(p.user, p.computer));
+  }
+  if (bitboardWinningCell(p.computer, p.user) != computerWins) {
+    disagree(walk, "bitboardWinningCell (computer)", p, computerWins, bitboardWinningCell(p.computer, p.user));
+  }
+  if (status != IN_PROGRESS) { return; }
+  int smart = cellIndex(smartPreference(p.board)), genious = cellIndex(geniousPreference(p.board));
+  if ((*tables)[SMART][code] != smart) { disagree(walk, "SMART table", p, smart, (*tables)[SMART][code]); }
+  if ((*tables)[GENIOUS][code] != genious) {
+    disagree(walk, "GENIOUS table", p, genious, (*tables)[GENIOUS][code]);
+  }
+}
+
+/** Every continuation of `p`, with `session` at the same point. */
+void walk(Walk& w, Position& p, const Session& session) {
+  w.nodes++;
+  check(w, p, session);
+  int code = bitboardCode(p.user, p.computer);
+  if (!w.seen[code]) {
+    w.seen[code] = true;
+    w.positions.push_back(p);
+  }
+  if (session.status != IN_PROGRESS) {
+    w.games++;
+    return;
+  }
+  for (int cell = 0; cell < 9; cell++) {
+    if (!sessionLegal(session, cell)) { continue; }
+    Session next = session;
+    sessionClaim(next, cell);
+    unsigned& mine = (session.toMove == USER) ? p.user : p.computer;
+    p.board[cell / 3][cell % 3] = session.toMove;
+    mine |= 1u << cell;
+    walk(w, p, next);
+    mine &= ~(1u << cell);
+    p.board[cell / 3][cell % 3] = EMPTY;
+  }
+}
+
+/** Nanoseconds per position of `op` over `positions`, `passes` times. */
+template <typename Op>
+double timePerPosition(const vector<Position>& positions, int passes, Op op) {
+  long sink = 0;
+  Clock::time_point start = Clock::now();
+  for (int pass = 0; pass < passes; pass++) {
+    for (const Position& p : positions) { sink += op(p); }
+  }
+  double nanos = chrono::duration<double, nano>(Clock::now() - start).count();
+  if (sink == 1) { printf(" "); }
+  return nanos / passes / positions.size();
+}
+
+int main(int argc, char* argv[]) {
+  Options opt;
+  for (int i = 1; i < argc; i++) {
+    string key = argv[i];
+    if (key == "--passes" && i + 1 < argc) { opt.passes = atoi(argv[++i]); }
+    else { fprintf(stderr, "unknown option %s\n", key.c_str()); return 1; }
+  }
+
+  MoveTables* built = buildMoveTables();
+  tables = built;
+  long disagreements = 0;
+  bool walkOk = true;
+  vector<Position> positions;
+  for (int first : {USER, COMPUTER}) {
+    Walk w;
+    Position empty = {};
+    Session session = {};
+    session.toMove = first;
+    session.status = IN_PROGRESS;
+    walk(w, empty, session);
+    printf("%-8s first: %ld nodes, %zu positions, %ld games, %ld disagreements\n",
+           first == USER ? "user" : "computer", w.nodes, w.positions.size(), w.games, w.disagreements);
+    walkOk &= (w.positions.size() == 5478 && w.games == 255168);
+    disagreements += w.disagreements;
+    positions.insert(positions.end(), w.positions.begin(), w.positions.end());
+  }
+
+  // The reference functions take a mutable board
+  auto board = [](const Position& p) { return const_cast<int(*)[3]>(p.board); };
+  printf("\n%-34s %9s\n", "ns/position", "");
+  printf("%-34s %9.2f\n", "isGameOver", timePerPosition(positions, opt.passes, [&](const Position& p) {
+    return isGameOver(board(p));
+  }));
+  printf("%-34s %9.2f\n", "bitboardStatus", timePerPosition(positions, opt.passes, [](const Position& p) {
+    return bitboardStatus(p.user, p.computer);
+  }));
+  printf("%-34s %9.2f\n", "encodeBoard", timePerPosition(positions, opt.passes, [&](const Position& p) {
+    return encodeBoard(board(p));
+  }));
+  printf("%-34s %9.2f\n", "bitboardCode", timePerPosition(positions, opt.passes, [](const Position& p) {
+    return bitboardCode(p.user, p.computer);
+  }));
+  printf("%-34s %9.2f\n", "playerCanWin (both players)", timePerPosition(positions, opt.passes, [&](const Position& p) {
+    return cellIndex(playerCanWin(board(p), USER)) + cellIndex(playerCanWin(board(p), COMPUTER));
+  }));
+  printf("%-34s %9.2f\n", "bitboardWinningCell (both players)", timePerPosition(positions, opt.passes,
+         [](const Position& p) {
+    return bitboardWinningCell(p.user, p.computer) + bitboardWinningCell(p.computer, p.user);
+  }));
+  printf("%-34s %9.2f\n", "geniousPreference", timePerPosition(positions, opt.passes, [&](const Position& p) {
+    return cellIndex(geniousPreference(board(p)));
+  }));
+  printf("%-34s %9.2f\n", "GENIOUS table", timePerPosition(positions, opt.passes, [&](const Position& p) {
+    return (int)(*tables)[GENIOUS][bitboardCode(p.user, p.computer)];
+  }));
+  delete built;
+
+  printf("\n%s\n", (!disagreements && walkOk) ? "all implementations agree" : "FAILED");
+  return (!disagreements && walkOk) ? 0 : 1;
+}
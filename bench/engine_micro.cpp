@@ -0,0 +1,206 @@
+/**
+ * Microbenchmarks of the engine functions the interactive game calls on
+ * every move (see engine.h), over positions taken from simulated games
+ * between every pairing of strategies rather than the empty board.
+ *
+ *   engine_micro [--games N] [--seconds S] [--runs R] [--json]
+ *
+ * Each benchmark cycles through its positions for R timed runs of about
+ * S seconds each and reports the median run: nanoseconds and operations
+ * per second, and heap allocations per operation, counted by replacing
+ * the global operator new. With --json the same figures are printed as
+ * one JSON object, for tracking regressions.
+ *
+ * The strategies claim a cell on the board they are given, so they run
+ * on a copy of the position; `board_copy` is the cost of that copy.
+ */
+#include "engine.h"
+#include "game_record.h"
+#include "move_table.h"
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <new>
+#include <sstream>
+#include <string>
+#include <vector>
+using namespace std;
+
+typedef chrono::steady_clock Clock;
+
+atomic<uint64_t> allocations(0);
+
+void* operator new(size_t size) {
+  allocations.fetch_add(1, memory_order_relaxed);
+  if (void* p = malloc(size ? size : 1)) { return p; }
+  throw bad_alloc();
+}
+void* operator new[](size_t size) { return operator new(size); }
+void operator delete(void* p) noexcept { free(p); }
+void operator delete[](void* p) noexcept { free(p); }
+void operator delete(void* p, size_t) noexcept { free(p); }
+void operator delete[](void* p, size_t) noexcept { free(p); }
+
+struct Options {
+  long   games   = 20000;
+  double seconds = 0.1;
+  int    runs    = 5;
+  bool   json    = false;
+};
+
+struct Board {
+  int cells[3][3];
+};
+
+struct Result {
+  const char* name;
+  size_t      positions;
+  double      nanos;    // per operation, median run
+  double      allocs;   // per operation, median run
+};
+
+/**
+ * Every position of `games`, in the order they were played: all of them
+ * in `all`, and those with the computer to move in `computerToMove`.
+ */
+void samplePositions(const vector<GameRecord>& games, vector<Board>& all, vector<Board>& computerToMove) {
+  for (const GameRecord& game : games) {
+    Board board = {};
+    int player = game.first;
+    for (int i = 0; i <= game.moveCount; i++) {
+      all.push_back(board);
+      if (i == game.moveCount) { break; }
+      if (player == COMPUTER) { computerToMove.push_back(board); }
+      board.cells[game.moves[i] / 3][game.moves[i] % 3] = player;
+      player = (player == USER) ? COMPUTER : USER;
+    }
+  }
+}
+
+uint64_t sink = 0;
+
+/** Time `op(board)` over `positions`; see above. */
+template <typename Op>
+Result measure(const char* name, const vector<Board>& positions, const Options& opt, Op op) {
+  // Calibrate to about a run's worth of operations, whole passes when cheap
+  size_t ops = positions.size();
+  for (;;) {
+    Clock::time_point start = Clock::now();
+    for (size_t i = 0; i < ops; i++) { op(positions[i % positions.size()]); }
+    if (chrono::duration<double>(Clock::now() - start).count() >= opt.seconds / 4) { break; }
+    ops *= 2;
+  }
+  ops *= 4;
+  vector<pair<double, double>> runs;   // nanoseconds and allocations per operation
+  for (int r = 0; r < opt.runs; r++) {
+    uint64_t allocated = allocations.load(memory_order_relaxed);
+    Clock::time_point start = Clock::now();
+    for (size_t i = 0; i < ops; i++) { op(positions[i % positions.size()]); }
+    double nanos = chrono::duration<double, nano>(Clock::now() - start).count();
+    runs.push_back({nanos / ops, double(allocations.load(memory_order_relaxed) - allocated) / ops});
+  }
+  sort(runs.begin(), runs.end());
+  return Result{name, positions.size(), runs[runs.size() / 2].first, runs[runs.size() / 2].second};
+}
+
+int main(int argc, char* argv[]) {
+  Options opt;
+  for (int i = 1; i < argc; i++) {
+    string key = argv[i];
+    if      (key == "--json")                      { opt.json    = true; }
+    else if (key == "--games" && i + 1 < argc)     { opt.games   = atol(argv[++i]); }
+    else if (key == "--seconds" && i + 1 < argc)   { opt.seconds = atof(argv[++i]); }
+    else if (key == "--runs" && i + 1 < argc)      { opt.runs    = atoi(argv[++i]); }
+    else { fprintf(stderr, "unknown option %s\n", key.c_str()); return 1; }
+  }
+  if (opt.games < 1 || opt.runs < 1) { fprintf(stderr, "need at least one game and run\n"); return 1; }
+
+  MoveTables* tables = buildMoveTables();
+  vector<GameRecord> games(opt.games);
+  for (long i = 0; i < opt.games; i++) {
+    GameRecord& game = games[i];
+    game = GameRecord{};
+    game.seed             = i;
+    game.userStrategy     = i % 3;
+    game.computerStrategy = (i / 3) % 3;
+    game.first            = (i / 9) % 2 ? COMPUTER : USER;
+    simulateGame(game, *tables);
+  }
+  delete tables;
+  vector<Board> all, computerToMove;
+  samplePositions(games, all, computerToMove);
+  srand(1);
+
+  // The strategies in the order they meet mixed opponents, so that the
+  // dispatch is not predicted for free
+  vector<int> strategies(computerToMove.size());
+  for (size_t i = 0; i < strategies.size(); i++) { strategies[i] = (i * 7 + i / 5) % 3; }
+  ostringstream rendered;
+
+  vector<Result> results;
+  Board scratch;
+  results.push_back(measure("isGameOver", all, opt, [&](const Board& b) {
+    sink += isGameOver(const_cast<int(*)[3]>(b.cells));
+  }));
+  results.push_back(measure("playerCanWin", all, opt, [&](const Board& b) {
+    Cell cell = playerCanWin(const_cast<int(*)[3]>(b.cells), (sink & 1) ? USER : COMPUTER);
+    sink += cell.row + cell.col;
+  }));
+  results.push_back(measure("userCanWin", all, opt, [&](const Board& b) {
+    Cell cell = userCanWin(const_cast<int(*)[3]>(b.cells));
+    sink += cell.row + cell.col;
+  }));
+  results.push_back(measure("computerCanWin", all, opt, [&](const Board& b) {
+    Cell cell = computerCanWin(const_cast<int(*)[3]>(b.cells));
+    sink += cell.row + cell.col;
+  }));
+  results.push_back(measure("board_copy", computerToMove, opt, [&](const Board& b) {
+    scratch = b;
+    sink += scratch.cells[sink % 3][1];
+  }));
+  results.push_back(measure("ai_random", computerToMove, opt, [&](const Board& b) {
+    scratch = b;
+    ai_random(scratch.cells);
+    sink += scratch.cells[sink % 3][1];
+  }));
+  results.push_back(measure("ai_smart", computerToMove, opt, [&](const Board& b) {
+    scratch = b;
+    ai_smart(scratch.cells);
+    sink += scratch.cells[sink % 3][1];
+  }));
+  results.push_back(measure("ai_genious", computerToMove, opt, [&](const Board& b) {
+    scratch = b;
+    ai_genious(scratch.cells);
+    sink += scratch.cells[sink % 3][1];
+  }));
+  size_t next = 0;
+  results.push_back(measure("nextComputerMove", computerToMove, opt, [&](const Board& b) {
+    scratch = b;
+    nextComputerMove(scratch.cells, strategies[next++ % strategies.size()]);
+    sink += scratch.cells[sink % 3][1];
+  }));
+  results.push_back(measure("drawBoard", all, opt, [&](const Board& b) {
+    rendered.seekp(0);
+    drawBoard(const_cast<int(*)[3]>(b.cells), rendered);
+    sink += rendered.tellp();
+  }));
+
+  if (opt.json) {
+    printf("{\"games\":%ld,\"positions\":%zu,\"benchmarks\":[", opt.games, all.size());
+    for (size_t i = 0; i < results.size(); i++) {
+      const Result& r = results[i];
+      printf("%s\n  {\"name\":\"%s\",\"positions\":%zu,\"ns_per_op\":%.2f,\"ops_per_sec\":%.0f,\"allocs_per_op\":%.3f}",
+             i ? "," : "", r.name, r.positions, r.nanos, 1e9 / r.nanos, r.allocs);
+    }
+    printf("\n]}\n");
+  } else {
+    printf("%-18s %9s %9s %14s %10s\n", "benchmark", "positions", "ns/op", "ops/s", "allocs/op");
+    for (const Result& r : results) {
+      printf("%-18s %9zu %9.1f %14.0f %10.3f\n", r.name, r.positions, r.nanos, 1e9 / r.nanos, r.allocs);
+    }
+  }
+  return sink == 1 ? 2 : 0;
+}
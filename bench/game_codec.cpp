@@ -0,0 +1,113 @@
+/**
+ * Compresses simulated games with the engine as the model (see
+ * game_codec.h), per kind of pairing, and decompresses them again.
+ *
+ *   game_codec [--games N] [--block GAMES]
+ *
+ * Reports, per pairing, bits per move, bytes per game against the plain
+ * record format, and decompression rate in games and moves per second on
+ * one thread. Every game must come back as it went in.
+ */
+#include "game_codec.h"
+#include "move_table.h"
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+#include <vector>
+using namespace std;
+
+typedef chrono::steady_clock Clock;
+
+struct Options {
+  long games = 1000000;
+  long block = 16384;
+};
+
+struct Pairing {
+  const char* name;
+  int         user;       // strategy, or -1 for every one in turn
+  int         computer;
+};
+
+bool sameGame(const GameRecord& a, const GameRecord& b) {
+  if (a.seed != b.seed || a.userStrategy != b.userStrategy || a.computerStrategy != b.computerStrategy ||
+      a.first != b.first || a.status != b.status || a.moveCount != b.moveCount) {
+    return false;
+  }
+  for (int i = 0; i < a.moveCount; i++) {
+    if (a.moves[i] != b.moves[i]) { return false; }
+  }
+  return true;
+}
+
+int main(int argc, char* argv[]) {
+  Options opt;
+  for (int i = 1; i < argc; i++) {
+    string key = argv[i];
+    if      (key == "--games" && i + 1 < argc) { opt.games = atol(argv[++i]); }
+    else if (key == "--block" && i + 1 < argc) { opt.block = atol(argv[++i]); }
+    else { fprintf(stderr, "unknown option %s\n", key.c_str()); return 1; }
+  }
+
+  MoveTables* tables = buildMoveTables();
+  static const Pairing PAIRINGS[] = {
+    {"genious vs genious", GENIOUS, GENIOUS},
+    {"smart vs genious",   SMART,   GENIOUS},
+    {"random vs genious",  RANDOM,  GENIOUS},
+    {"random vs random",   RANDOM,  RANDOM},
+    {"every pairing",      -1,      -1},
+  };
+  printf("%-20s %10s %12s %12s %14s %14s\n", "pairing", "bits/move", "bytes/game", "plain bytes", "decode games/s",
+         "decode moves/s");
+  bool ok = true;
+  for (const Pairing& pairing : PAIRINGS) {
+    vector<GameRecord> games(opt.games);
+    long moves = 0;
+    size_t plainBytes = 0;
+    for (long i = 0; i < opt.games; i++) {
+      GameRecord& game = games[i];
+      game = GameRecord{};
+      game.seed             = i;
+      game.userStrategy     = pairing.user >= 0 ? pairing.user : i % 3;
+      game.computerStrategy = pairing.computer >= 0 ? pairing.computer : (i / 3) % 3;
+      game.first            = (i / 9) % 2 ? COMPUTER : USER;
+      simulateGame(game, *tables);
+      moves += game.moveCount;
+      plainBytes += GAME_HEADER_BYTES + (game.moveCount + 1) / 2;
+    }
+
+    // Blocks as the game file would cut them
+    vector<vector<uint8_t>> blocks;
+    CodecStats stats = {};
+    size_t codedBytes = 0;
+    for (long from = 0; from < opt.games; from += opt.block) {
+      blocks.emplace_back();
+      long count = min(opt.block, opt.games - from);
+      if (!compressGames(&games[from], count, *tables, blocks.back(), &stats)) {
+        fprintf(stderr, "%s: cannot code games\n", pairing.name);
+        return 1;
+      }
+      codedBytes += blocks.back().size() + 8;
+    }
+
+    vector<GameRecord> decoded(opt.block);
+    long wrong = 0;
+    double seconds = 0;
+    for (size_t b = 0; b < blocks.size(); b++) {
+      long from = b * opt.block, count = min(opt.block, opt.games - from);
+      Clock::time_point start = Clock::now();
+      bool intact = decompressGames(blocks[b].data(), blocks[b].size(), count, *tables, decoded.data());
+      seconds += chrono::duration<double>(Clock::now() - start).count();
+      for (long i = 0; i < count; i++) { wrong += !intact || !sameGame(decoded[i], games[from + i]); }
+    }
+    if (wrong) {
+      fprintf(stderr, "%s: %ld games decoded wrong\n", pairing.name, wrong);
+      ok = false;
+    }
+    printf("%-20s %10.3f %12.3f %12.2f %14.0f %14.0f\n", pairing.name, stats.moveBits / moves,
+           double(codedBytes) / opt.games, double(plainBytes) / opt.games, opt.games / seconds, moves / seconds);
+  }
+  delete tables;
+  return ok ? 0 : 1;
+}
@@ -0,0 +1,153 @@
+/**
+ * Aggregate queries over a column file (see game_columns.h) against the
+ * same queries decoding every game from the record file.
+ *
+ *   game_columns [--games N] [--threads T] [--dir PATH] [--repeat R]
+ *
+ * Runs win rate by opening move, by strategy pair, by game length, and
+ * by opening move of GENIOUS moving second, and reports for each the
+ * rate in games per second and in bytes of columns read per second, and
+ * the row-by-row rate for comparison. Both must give the same counts.
+ */
+#include "game_columns.h"
+#include "game_record.h"
+#include "move_table.h"
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <unistd.h>
+using namespace std;
+
+typedef chrono::steady_clock Clock;
+
+struct Options {
+  string dir     = "/tmp";
+  long   games   = 5000000;
+  int    threads = 1;
+  int    repeat  = 5;
+};
+
+struct NamedQuery {
+  const char* name;
+  GroupQuery  query;
+};
+
+/** Column value of a decoded game, as the column file holds it. */
+uint8_t rowValue(const GameRecord& game, int column) {
+  switch (column) {
+    case COLUMN_RESULT:   return resultCode(game.status);
+    case COLUMN_LENGTH:   return game.moveCount;
+    case COLUMN_USER:     return game.userStrategy;
+    case COLUMN_COMPUTER: return game.computerStrategy;
+    case COLUMN_FIRST:    return game.first == COMPUTER;
+    default: {
+      int m = column - COLUMN_MOVE0;
+      return (m < game.moveCount) ? game.moves[m] : (uint8_t)NO_MOVE;
+    }
+  }
+}
+
+/** The query answered by decoding every game. */
+void rowQuery(const GameReader& reader, const GroupQuery& query, GroupCounts& counts) {
+  memset(&counts, 0, sizeof(counts));
+  reader.forEach([&](const GameRecord& game) {
+    for (const ColumnRange& range : query.where) {
+      uint8_t value = rowValue(game, range.column);
+      if (value < range.low || value > range.high) { return; }
+    }
+    int a = (query.groupBy[0] >= 0) ? rowValue(game, query.groupBy[0]) : 0;
+    int b = (query.groupBy[1] >= 0) ? rowValue(game, query.groupBy[1]) : 0;
+    counts.games[a * 16 + b][resultCode(game.status)]++;
+  });
+}
+
+int main(int argc, char* argv[]) {
+  Options opt;
+  for (int i = 1; i < argc; i++) {
+    string key = argv[i];
+    if      (key == "--games" && i + 1 < argc)   { opt.games   = atol(argv[++i]); }
+    else if (key == "--threads" && i + 1 < argc) { opt.threads = atoi(argv[++i]); }
+    else if (key == "--repeat" && i + 1 < argc)  { opt.repeat  = atoi(argv[++i]); }
+    else if (key == "--dir" && i + 1 < argc)     { opt.dir     = argv[++i]; }
+    else { fprintf(stderr, "unknown option %s\n", key.c_str()); return 1; }
+  }
+  string gamesPath   = opt.dir + "/ttt-games-" + to_string(getpid()) + ".bin";
+  string columnsPath = opt.dir + "/ttt-columns-" + to_string(getpid()) + ".col";
+
+  MoveTables* tables = buildMoveTables();
+  GameWriter writer;
+  if (!writer.open(gamesPath.c_str())) { perror("open"); return 1; }
+  for (long i = 0; i < opt.games; i++) {
+    GameRecord game = {};
+    game.seed             = i;
+    game.userStrategy     = i % 3;
+    game.computerStrategy = (i / 3) % 3;
+    game.first            = (i / 9) % 2 ? COMPUTER : USER;
+    simulateGame(game, *tables);
+    if (!writer.write(game)) { perror("write"); return 1; }
+  }
+  if (!writer.close()) { perror("close"); return 1; }
+  delete tables;
+
+  GameReader reader;
+  if (!reader.open(gamesPath.c_str())) { perror("read"); return 1; }
+  Clock::time_point start = Clock::now();
+  if (!writeGameColumns(reader, columnsPath.c_str(), opt.threads)) { perror("columns"); return 1; }
+  double buildSeconds = chrono::duration<double>(Clock::now() - start).count();
+  GameColumns columns;
+  if (!columns.open(columnsPath.c_str())) { perror("open columns"); return 1; }
+
+  NamedQuery queries[4];
+  queries[0].name = "by opening move";
+  queries[0].query.groupBy[0] = COLUMN_MOVE0;
+  queries[1].name = "by strategy pair";
+  queries[1].query.groupBy[0] = COLUMN_USER;
+  queries[1].query.groupBy[1] = COLUMN_COMPUTER;
+  queries[2].name = "by game length";
+  queries[2].query.groupBy[0] = COLUMN_LENGTH;
+  queries[3].name = "genious second, by opening";
+  queries[3].query.where = {{COLUMN_COMPUTER, GENIOUS, GENIOUS}, {COLUMN_FIRST, 0, 0}};
+  queries[3].query.groupBy[0] = COLUMN_MOVE0;
+
+  printf("games:         %ld, columns built in %.2f s with %d thread(s)\n", opt.games, buildSeconds, opt.threads);
+  printf("%-28s %14s %10s %14s\n", "query", "columns games/s", "GB/s", "rows games/s");
+  bool ok = true;
+  for (NamedQuery& named : queries) {
+    const GroupQuery& query = named.query;
+    GroupCounts counts, expected;
+    columns.query(query, counts, opt.threads);   // warm the mapping
+    start = Clock::now();
+    for (int r = 0; r < opt.repeat; r++) { columns.query(query, counts, opt.threads); }
+    double columnSeconds = chrono::duration<double>(Clock::now() - start).count() / opt.repeat;
+    start = Clock::now();
+    rowQuery(reader, query, expected);
+    double rowSeconds = chrono::duration<double>(Clock::now() - start).count();
+
+    // The result column, the filtered ones and the grouped ones
+    int read = 1 + query.where.size() + (query.groupBy[0] >= 0) + (query.groupBy[1] >= 0);
+    printf("%-28s %14.0f %10.2f %14.0f\n", named.name, opt.games / columnSeconds,
+           read * opt.games / columnSeconds / 1e9, opt.games / rowSeconds);
+    if (memcmp(&counts, &expected, sizeof(counts)) != 0) {
+      fprintf(stderr, "%s: column and row counts differ\n", named.name);
+      ok = false;
+    }
+  }
+
+  // What the first query found
+  GroupCounts counts;
+  columns.query(queries[0].query, counts, opt.threads);
+  printf("\nopening cell   games    user won  computer won  draw\n");
+  for (int cell = 0; cell < 9; cell++) {
+    const uint64_t* c = counts.games[cell * 16];
+    uint64_t games = c[0] + c[1] + c[2] + c[3];
+    if (!games) { continue; }
+    printf("%c%d      %10llu %10.1f%% %12.1f%% %5.1f%%\n", 'A' + cell % 3, cell / 3, (unsigned long long)games,
+           100.0 * c[resultCode(USER_WON)] / games, 100.0 * c[resultCode(COMPUTER_WON)] / games,
+           100.0 * c[resultCode(DRAW)] / games);
+  }
+  unlink(gamesPath.c_str());
+  unlink(columnsPath.c_str());
+  return ok ? 0 : 1;
+}
@@ -0,0 +1,151 @@
+/**
+ * Builds a position index (see game_index.h) over simulated games and
+ * times queries against it, checking every answer against a scan of the
+ * record file.
+ *
+ *   game_index [--games N] [--threads T] [--queries Q] [--dir PATH]
+ *
+ * Reports index bytes per game, build time, and per query: the time to
+ * open the index and summarise one position, and the time to list the
+ * ids of a position's games, for positions sampled from the games.
+ */
+#include "game_index.h"
+#include "game_record.h"
+#include "move_table.h"
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <vector>
+using namespace std;
+
+typedef chrono::steady_clock Clock;
+
+struct Options {
+  string dir     = "/tmp";
+  long   games   = 2000000;
+  int    threads = 1;
+  int    queries = 2000;
+};
+
+struct Query {
+  unsigned user, computer;
+  uint64_t games;       // found by the scan
+  uint64_t idSum;
+};
+
+double micros(Clock::duration d) { return chrono::duration<double, micro>(d).count(); }
+
+int main(int argc, char* argv[]) {
+  Options opt;
+  for (int i = 1; i < argc; i++) {
+    string key = argv[i];
+    if      (key == "--games" && i + 1 < argc)   { opt.games   = atol(argv[++i]); }
+    else if (key == "--threads" && i + 1 < argc) { opt.threads = atoi(argv[++i]); }
+    else if (key == "--queries" && i + 1 < argc) { opt.queries = atoi(argv[++i]); }
+    else if (key == "--dir" && i + 1 < argc)     { opt.dir     = argv[++i]; }
+    else { fprintf(stderr, "unknown option %s\n", key.c_str()); return 1; }
+  }
+  string gamesPath = opt.dir + "/ttt-games-" + to_string(getpid()) + ".bin";
+  string indexPath = opt.dir + "/ttt-index-" + to_string(getpid()) + ".idx";
+
+  MoveTables* tables = buildMoveTables();
+  GameWriter writer;
+  if (!writer.open(gamesPath.c_str())) { perror("open"); return 1; }
+  for (long i = 0; i < opt.games; i++) {
+    GameRecord game = {};
+    game.seed             = i;
+    game.userStrategy     = i % 3;
+    game.computerStrategy = (i / 3) % 3;
+    game.first            = (i / 9) % 2 ? COMPUTER : USER;
+    simulateGame(game, *tables);
+    if (!writer.write(game)) { perror("write"); return 1; }
+  }
+  if (!writer.close()) { perror("close"); return 1; }
+  delete tables;
+
+  GameReader reader;
+  if (!reader.open(gamesPath.c_str())) { perror("read"); return 1; }
+  Clock::time_point start = Clock::now();
+  if (!buildGameIndex(reader, indexPath.c_str(), opt.threads)) { perror("index"); return 1; }
+  double buildSeconds = chrono::duration<double>(Clock::now() - start).count();
+  struct stat st;
+  stat(indexPath.c_str(), &st);
+
+  // Positions to ask about: those reached after a random number of moves
+  // of random games, found again by brute force over the whole file
+  vector<Query> queries;
+  srand(1);
+  for (int q = 0; q < opt.queries; q++) {
+    GameRecord game;
+    reader.game(rand() % opt.games, game);
+    int moves = rand() % (game.moveCount + 1);
+    unsigned boards[2] = {0, 0};
+    for (int i = 0; i < moves; i++) { boards[i & 1] |= 1u << game.moves[i]; }
+    bool userFirst = (game.first == USER);
+    queries.push_back(Query{boards[userFirst ? 0 : 1], boards[userFirst ? 1 : 0], 0, 0});
+  }
+  vector<int> codes(queries.size());
+  for (size_t q = 0; q < queries.size(); q++) { codes[q] = canonicalCode(queries[q].user, queries[q].computer); }
+  uint64_t id = 0;
+  reader.forEach([&](const GameRecord& game) {
+    unsigned boards[2] = {0, 0};
+    bool userFirst = (game.first == USER);
+    vector<int> reached(1, canonicalCode(0, 0));
+    for (int i = 0; i < game.moveCount; i++) {
+      boards[i & 1] |= 1u << game.moves[i];
+      reached.push_back(canonicalCode(boards[userFirst ? 0 : 1], boards[userFirst ? 1 : 0]));
+    }
+    for (size_t q = 0; q < queries.size(); q++) {
+      if (find(reached.begin(), reached.end(), codes[q]) != reached.end()) {
+        queries[q].games++;
+        queries[q].idSum += id;
+      }
+    }
+    id++;
+  });
+
+  // Open and summarise one position, cold process state aside
+  start = Clock::now();
+  GameIndex index;
+  if (!index.open(indexPath.c_str())) { perror("open index"); return 1; }
+  uint64_t first = index.position(queries[0].user, queries[0].computer).games;
+  double openMicros = micros(Clock::now() - start);
+
+  vector<double> summary, listing;
+  long wrong = (first != queries[0].games);
+  uint64_t listed = 0;
+  for (const Query& q : queries) {
+    start = Clock::now();
+    const PositionEntry& entry = index.position(q.user, q.computer);
+    uint64_t games = entry.games;
+    summary.push_back(micros(Clock::now() - start));
+
+    uint64_t idSum = 0, count = 0;
+    start = Clock::now();
+    bool ok = index.forEachGame(q.user, q.computer, [&](uint64_t id) {
+      idSum += id;
+      count++;
+    });
+    listing.push_back(micros(Clock::now() - start));
+    listed += count;
+    if (!ok || games != q.games || count != q.games || idSum != q.idSum) { wrong++; }
+  }
+  sort(summary.begin(), summary.end());
+  sort(listing.begin(), listing.end());
+  unlink(gamesPath.c_str());
+  unlink(indexPath.c_str());
+
+  printf("games:                 %ld\n", opt.games);
+  printf("index bytes/game:      %.2f\n", double(st.st_size) / opt.games);
+  printf("build (s):             %.2f with %d thread(s)\n", buildSeconds, opt.threads);
+  printf("open + first query:    %.1f us\n", openMicros);
+  printf("summary query (us):    p50 %.3f  p99 %.3f\n", summary[summary.size() / 2], summary[summary.size() * 99 / 100]);
+  printf("id listing (us):       p50 %.1f  p99 %.1f  (%.0f ids per query)\n", listing[listing.size() / 2],
+         listing[listing.size() * 99 / 100], double(listed) / queries.size());
+  printf("wrong answers:         %ld of %zu\n", wrong, queries.size());
+  return wrong ? 1 : 0;
+}
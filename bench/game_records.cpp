@@ -0,0 +1,116 @@
+/**
+ * Writes simulated games to a game record file (see game_record.h), then
+ * streams them back through the rules, checking that every recorded
+ * result is what the moves lead to.
+ *
+ *   game_records [--games N] [--threads T] [--file PATH] [--keep] [--compress]
+ *
+ * Reports bytes per game, write rate, and read + replay rate in total
+ * and per thread. The file is removed afterwards unless --keep is given.
+ * With --compress the file is coded with the move tables as the model
+ * (see game_codec.h).
+ */
+#include "game_record.h"
+#include "move_table.h"
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+#include <thread>
+#include <unistd.h>
+#include <vector>
+using namespace std;
+
+typedef chrono::steady_clock Clock;
+
+struct Options {
+  string file;
+  long   games   = 2000000;
+  int    threads = 1;
+  bool   keep    = false;
+  bool   compress = false;
+};
+
+/** Game `i` of the benchmark: every pairing of strategies, both first movers. */
+GameRecord benchGame(uint32_t i) {
+  GameRecord game = {};
+  game.seed             = i;
+  game.userStrategy     = i % 3;
+  game.computerStrategy = (i / 3) % 3;
+  game.first            = (i / 9) % 2 ? COMPUTER : USER;
+  return game;
+}
+
+int main(int argc, char* argv[]) {
+  Options opt;
+  opt.file = "/tmp/ttt-games-" + to_string(getpid()) + ".bin";
+  for (int i = 1; i < argc; i++) {
+    string key = argv[i];
+    if      (key == "--keep")                      { opt.keep    = true; }
+    else if (key == "--compress")                  { opt.compress = true; }
+    else if (key == "--games" && i + 1 < argc)     { opt.games   = atol(argv[++i]); }
+    else if (key == "--threads" && i + 1 < argc)   { opt.threads = atoi(argv[++i]); }
+    else if (key == "--file" && i + 1 < argc)      { opt.file    = argv[++i]; }
+    else { fprintf(stderr, "unknown option %s\n", key.c_str()); return 1; }
+  }
+
+  MoveTables* tables = buildMoveTables();
+  GameWriter writer;
+  if (!writer.open(opt.file.c_str(), opt.compress ? tables : nullptr)) { perror("open"); return 1; }
+  double simulateSeconds = 0;
+  Clock::time_point start = Clock::now();
+  for (long i = 0; i < opt.games; i++) {
+    GameRecord game = benchGame(i);
+    Clock::time_point before = Clock::now();
+    simulateGame(game, *tables);
+    simulateSeconds += chrono::duration<double>(Clock::now() - before).count();
+    if (!writer.write(game)) { perror("write"); return 1; }
+  }
+  if (!writer.close()) { perror("close"); return 1; }
+  double writeSeconds = chrono::duration<double>(Clock::now() - start).count() - simulateSeconds;
+
+  GameReader reader;
+  if (!reader.open(opt.file.c_str(), tables)) { perror("read"); return 1; }
+  // Split the blocks between the threads
+  vector<long> games(opt.threads), bad(opt.threads), moves(opt.threads);
+  vector<thread> threads;
+  atomic<bool> damaged(false);
+  start = Clock::now();
+  for (int t = 0; t < opt.threads; t++) {
+    threads.emplace_back([&, t] {
+      uint64_t from = reader.blocks() * t / opt.threads, to = reader.blocks() * (t + 1) / opt.threads;
+      for (uint64_t block = from; block < to; block++) {
+        bool ok = reader.forEachInBlock(block, [&](const GameRecord& game) {
+          games[t]++;
+          moves[t] += game.moveCount;
+          if (replayGame(game) != game.status) { bad[t]++; }
+        });
+        if (!ok) { damaged.store(true); }
+      }
+    });
+  }
+  for (thread& t : threads) { t.join(); }
+  double readSeconds = chrono::duration<double>(Clock::now() - start).count();
+
+  long totalGames = 0, totalBad = 0, totalMoves = 0;
+  for (int t = 0; t < opt.threads; t++) {
+    totalGames += games[t];
+    totalBad += bad[t];
+    totalMoves += moves[t];
+  }
+  FILE* f = fopen(opt.file.c_str(), "rb");
+  fseek(f, 0, SEEK_END);
+  long bytes = ftell(f);
+  fclose(f);
+  if (!opt.keep) { unlink(opt.file.c_str()); }
+  delete tables;
+
+  printf("games:                %ld (%.2f moves each)\n", totalGames, double(totalMoves) / totalGames);
+  printf("file bytes/game:      %.2f (%llu blocks)\n", double(bytes) / totalGames, (unsigned long long)reader.blocks());
+  printf("write (games/s):      %.0f (excluding simulation)\n", opt.games / writeSeconds);
+  printf("read+replay (games/s): %.0f with %d thread(s), %.0f per thread\n", totalGames / readSeconds, opt.threads,
+         totalGames / readSeconds / opt.threads);
+  printf("wrong results:        %ld%s\n", totalBad, damaged.load() ? " (damaged blocks)" : "");
+  return (totalBad || damaged.load() || totalGames != opt.games) ? 1 : 0;
+}
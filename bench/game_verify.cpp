@@ -0,0 +1,123 @@
+/**
+ * Verifies a file of simulated games, some of them spoilt on purpose
+ * (see game_verify.h), checking every verdict against a plain replay
+ * written for clarity rather than speed.
+ *
+ *   game_verify [--games N] [--threads T] [--bad-every K] [--file PATH]
+ *
+ * Every K-th game is spoilt in one of several ways. Reports the rate in
+ * games per second and per minute, in total and per thread.
+ */
+#include "game_verify.h"
+#include "move_table.h"
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+#include <unistd.h>
+using namespace std;
+
+typedef chrono::steady_clock Clock;
+
+struct Options {
+  string file;
+  long   games    = 5000000;
+  int    threads  = 1;
+  long   badEvery = 1000;
+};
+
+/** The same checks, one after the other. */
+VerifyResult reference(const GameRecord& game) {
+  unsigned boards[2] = {0, 0};
+  bool userFirst = (game.first == USER);
+  int status = IN_PROGRESS;
+  for (int i = 0; i < game.moveCount && i < 9; i++) {
+    unsigned cell = game.moves[i];
+    if (status != IN_PROGRESS) { return VerifyResult{i, VERIFY_MOVE_AFTER_END}; }
+    if (cell > 8) { return VerifyResult{i, VERIFY_BAD_CELL}; }
+    if ((boards[0] | boards[1]) & (1u << cell)) { return VerifyResult{i, VERIFY_CELL_TAKEN}; }
+    boards[i & 1] |= 1u << cell;
+    status = bitboardStatus(boards[userFirst ? 0 : 1], boards[userFirst ? 1 : 0]);
+  }
+  if (game.moveCount > 9) { return VerifyResult{9, VERIFY_TOO_MANY_MOVES}; }
+  if (game.first != USER && game.first != COMPUTER) { return VerifyResult{0, VERIFY_BAD_HEADER}; }
+  if (status != game.status) { return VerifyResult{game.moveCount, VERIFY_WRONG_RESULT}; }
+  return VerifyResult{-1, VERIFY_OK};
+}
+
+/** Spoil `game` in the way picked by `how`. */
+void spoil(GameRecord& game, uint32_t how) {
+  int ply = how % 9 % (game.moveCount ? game.moveCount : 1);
+  switch (how % 5) {
+    case 0: game.moves[ply] = 9 + how % 7; break;                        // off the board
+    case 1: if (ply > 0) { game.moves[ply] = game.moves[how % ply]; } break;   // onto a claimed cell
+    case 2:                                                              // one move too many
+      if (game.moveCount < 9) { game.moves[game.moveCount++] = 0; }
+      break;
+    case 3: game.status = (game.status == DRAW) ? USER_WON : DRAW; break;
+    case 4: std::swap(game.moves[0], game.moves[game.moveCount - 1]); break;
+  }
+}
+
+int main(int argc, char* argv[]) {
+  Options opt;
+  opt.file = "/tmp/ttt-verify-" + to_string(getpid()) + ".bin";
+  for (int i = 1; i < argc; i++) {
+    string key = argv[i];
+    if      (key == "--games" && i + 1 < argc)     { opt.games    = atol(argv[++i]); }
+    else if (key == "--threads" && i + 1 < argc)   { opt.threads  = atoi(argv[++i]); }
+    else if (key == "--bad-every" && i + 1 < argc) { opt.badEvery = atol(argv[++i]); }
+    else if (key == "--file" && i + 1 < argc)      { opt.file     = argv[++i]; }
+    else { fprintf(stderr, "unknown option %s\n", key.c_str()); return 1; }
+  }
+
+  MoveTables* tables = buildMoveTables();
+  GameWriter writer;
+  if (!writer.open(opt.file.c_str())) { perror("open"); return 1; }
+  for (long i = 0; i < opt.games; i++) {
+    GameRecord game = {};
+    game.seed             = i;
+    game.userStrategy     = i % 3;
+    game.computerStrategy = (i / 3) % 3;
+    game.first            = (i / 9) % 2 ? COMPUTER : USER;
+    simulateGame(game, *tables);
+    if (opt.badEvery > 0 && i % opt.badEvery == opt.badEvery - 1) { spoil(game, i / opt.badEvery * 2654435761u >> 7); }
+    if (!writer.write(game)) { perror("write"); return 1; }
+  }
+  if (!writer.close()) { perror("close"); return 1; }
+  delete tables;
+
+  GameReader reader;
+  if (!reader.open(opt.file.c_str())) { perror("read"); return 1; }
+  // Every verdict against the reference, one thread
+  long disagree = 0, expectedBad = 0;
+  reader.forEach([&](const GameRecord& game) {
+    VerifyResult fast = verifyGame(game), slow = reference(game);
+    disagree += (fast.ply != slow.ply || fast.error != slow.error);
+    expectedBad += (slow.error != VERIFY_OK);
+  });
+
+  // The same pass with the plain replay, which only says good or bad
+  Clock::time_point start = Clock::now();
+  long replayBad = 0;
+  reader.forEach([&](const GameRecord& game) { replayBad += (replayGame(game) != game.status); });
+  double replaySeconds = chrono::duration<double>(Clock::now() - start).count();
+
+  start = Clock::now();
+  VerifyReport report = verifyGames(reader, opt.threads, 10);
+  double seconds = chrono::duration<double>(Clock::now() - start).count();
+  unlink(opt.file.c_str());
+
+  printf("games:              %llu, %llu bad (%ld expected)\n", (unsigned long long)report.games,
+         (unsigned long long)report.bad, expectedBad);
+  for (const BadGame& bad : report.first) {
+    printf("  game %llu: ply %d: %s\n", (unsigned long long)bad.id, bad.result.ply, verifyErrorName(bad.result.error));
+  }
+  printf("verify (games/s):   %.0f with %d thread(s), %.0f per thread\n", report.games / seconds, opt.threads,
+         report.games / seconds / opt.threads);
+  printf("replay (games/s):   %.0f with 1 thread (%ld bad)\n", opt.games / replaySeconds, replayBad);
+  printf("verify (games/min): %.0f\n", report.games / seconds * 60);
+  printf("disagreements:      %ld\n", disagree);
+  bool ok = !disagree && !report.damaged && (long)report.bad == expectedBad && (long)report.games == opt.games;
+  return ok ? 0 : 1;
+}
@@ -0,0 +1,163 @@
+/**
+ * Load generator for the HTTP move oracle. Each connection keeps
+ * `pipeline` requests in flight, sent in one write, over positions
+ * sampled from random games. Reports requests/sec and latency
+ * percentiles.
+ *
+ *   http_load [--address A] [--threads N] [--backend epoll|uring]
+ *             [--connections C] [--pipeline P] [--seconds S]
+ *
+ * Without --address a server is started in-process on a Unix socket.
+ */
+#include "engine.h"
+#include "http_server.h"
+#include "net.h"
+#include "server.h"
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <thread>
+#include <unistd.h>
+#include <vector>
+using namespace std;
+
+typedef chrono::steady_clock Clock;
+
+struct Options {
+  string address;
+  int    threads     = 1;
+  int    backend     = BACKEND_EPOLL;
+  int    connections = 4;
+  int    pipeline    = 16;
+  double seconds     = 3;
+};
+
+/** Requests for positions reached by playing random moves from the empty board. */
+vector<string> samplePositions(int count) {
+  vector<string> requests;
+  while ((int)requests.size() < count) {
+    int board[3][3] = {};
+    int player = USER;
+    while (isGameOver(board) == IN_PROGRESS && (int)requests.size() < count) {
+      string cells;
+      for (int i = 0; i < 9; i++) {
+        int v = board[i / 3][i % 3];
+        cells += (v == USER) ? 'x' : (v == COMPUTER) ? 'o' : '.';
+      }
+      requests.push_back("GET /move?board=" + cells + "&strategy=" + to_string(rand() % 3) +
+                         " HTTP/1.1\r\nHost: oracle\r\n\r\n");
+      Cell c = chooseMove(board, player, RANDOM);
+      board[c.row][c.col] = player;
+      player = (player == USER) ? COMPUTER : USER;
+    }
+  }
+  return requests;
+}
+
+/**
+ * Length of the complete response at the front of [p, end).
+ *
+ * @return size_t  0 if the response is not complete yet
+ */
+size_t responseLength(const char* p, const char* end) {
+  const char* head = static_cast<const char*>(memmem(p, end - p, "\r\n\r\n", 4));
+  if (!head) { return 0; }
+  const char* cl = static_cast<const char*>(memmem(p, head - p, "Content-Length: ", 16));
+  size_t body = cl ? strtoul(cl + 16, nullptr, 10) : 0;
+  size_t total = head + 4 - p + body;
+  return (size_t)(end - p) >= total ? total : 0;
+}
+
+void client(const Options& opt, const vector<string>& positions, Clock::time_point deadline,
+            vector<uint32_t>& latencies, long& requests) {
+  int fd = connectTo(opt.address);
+  if (fd < 0) { perror("connect"); return; }
+
+  string batch;
+  vector<char> buf(1 << 20);
+  size_t next = rand();
+  while (Clock::now() < deadline) {
+    batch.clear();
+    for (int i = 0; i < opt.pipeline; i++) { batch += positions[next++ % positions.size()]; }
+
+    Clock::time_point sent = Clock::now();
+    if (write(fd, batch.data(), batch.size()) != (ssize_t)batch.size()) { break; }
+
+    int done = 0;
+    size_t have = 0, off = 0;
+    while (done < opt.pipeline) {
+      ssize_t n = read(fd, buf.data() + have, buf.size() - have);
+      if (n <= 0) { close(fd); return; }
+      have += n;
+      Clock::time_point now = Clock::now();
+      size_t len;
+      while ((len = responseLength(buf.data() + off, buf.data() + have)) > 0) {
+        latencies.push_back(chrono::duration_cast<chrono::nanoseconds>(now - sent).count());
+        off += len;
+        done++;
+      }
+    }
+    requests += opt.pipeline;
+  }
+  close(fd);
+}
+
+int main(int argc, char* argv[]) {
+  Options opt;
+  for (int i = 1; i + 1 < argc; i += 2) {
+    string key = argv[i];
+    if      (key == "--address")     { opt.address     = argv[i + 1]; }
+    else if (key == "--threads")     { opt.threads     = atoi(argv[i + 1]); }
+    else if (key == "--backend")     { opt.backend     = string(argv[i + 1]) == "uring" ? BACKEND_URING : BACKEND_EPOLL; }
+    else if (key == "--connections") { opt.connections = atoi(argv[i + 1]); }
+    else if (key == "--pipeline")    { opt.pipeline    = atoi(argv[i + 1]); }
+    else if (key == "--seconds")     { opt.seconds     = atof(argv[i + 1]); }
+    else { fprintf(stderr, "unknown option %s\n", key.c_str()); return 1; }
+  }
+
+  Server server;
+  bool local = opt.address.empty();
+  if (local) {
+    opt.address = "unix:/tmp/ttt-http-" + to_string(getpid()) + ".sock";
+    ServerConfig config;
+    config.address = opt.address;
+    config.threads = opt.threads;
+    config.backend = opt.backend;
+    if (!server.start(config, makeHttpHandler, nullptr)) { perror("server"); return 1; }
+  }
+
+  vector<string> positions = samplePositions(4096);
+  Clock::time_point start = Clock::now();
+  Clock::time_point deadline = start + chrono::duration_cast<Clock::duration>(chrono::duration<double>(opt.seconds));
+  vector<vector<uint32_t>> latencies(opt.connections);
+  vector<long> requests(opt.connections);
+  vector<thread> clients;
+  for (int i = 0; i < opt.connections; i++) {
+    clients.emplace_back(client, cref(opt), cref(positions), deadline, ref(latencies[i]), ref(requests[i]));
+  }
+  for (thread& t : clients) { t.join(); }
+  double elapsed = chrono::duration<double>(Clock::now() - start).count();
+
+  vector<uint32_t> all;
+  long total = 0;
+  for (int i = 0; i < opt.connections; i++) {
+    all.insert(all.end(), latencies[i].begin(), latencies[i].end());
+    total += requests[i];
+  }
+  sort(all.begin(), all.end());
+
+  printf("connections:       %d\n", opt.connections);
+  printf("pipeline:          %d\n", opt.pipeline);
+  printf("requests/sec:      %.0f\n", total / elapsed);
+  if (!all.empty()) {
+    printf("p50 (us):          %.1f\n", all[all.size() / 2] / 1000.0);
+    printf("p99 (us):          %.1f\n", all[all.size() * 99 / 100] / 1000.0);
+    printf("p99.9 (us):        %.1f\n", all[all.size() * 999 / 1000] / 1000.0);
+  }
+  if (local) { unlink(opt.address.c_str() + 5); }
+  server.stop();
+  return 0;
+}
@@ -0,0 +1,122 @@
+/**
+ * Round-trip latency of asking an engine in another process for a move,
+ * through the shared-memory queues (shm_engine.h) and through the line
+ * protocol over pipes (protocol.h). Both engines are forked from this
+ * process; requests are sent one at a time, each waiting for its answer.
+ *
+ *   ipc_latency [--calls N]
+ */
+#include "engine.h"
+#include "protocol.h"
+#include "shm_engine.h"
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+#include <sys/wait.h>
+#include <unistd.h>
+#include <vector>
+using namespace std;
+
+typedef chrono::steady_clock Clock;
+
+/** A position reached in a random game, with the moves that led to it. */
+struct Sample {
+  int    board[3][3];
+  int    player;
+  string request;   // "position <moves>\ngo\n"
+};
+
+vector<Sample> samplePositions(int count) {
+  vector<Sample> samples;
+  while ((int)samples.size() < count) {
+    Sample s = {};
+    s.player = USER;
+    string moves;
+    while (isGameOver(s.board) == IN_PROGRESS && (int)samples.size() < count) {
+      s.request = "position" + moves + "\ngo\n";
+      samples.push_back(s);
+      Cell c = chooseMove(s.board, s.player, RANDOM);
+      s.board[c.row][c.col] = s.player;
+      moves += string(" ") + char('A' + c.col) + char('0' + c.row);
+      s.player = (s.player == USER) ? COMPUTER : USER;
+    }
+  }
+  return samples;
+}
+
+void report(const char* name, vector<double>& ns) {
+  sort(ns.begin(), ns.end());
+  double sum = 0;
+  for (double v : ns) { sum += v; }
+  printf("%-10s mean %8.0f ns   p50 %8.0f ns   p99 %8.0f ns   %10.0f calls/sec\n",
+         name, sum / ns.size(), ns[ns.size() / 2], ns[ns.size() * 99 / 100], ns.size() / (sum / 1e9));
+}
+
+void benchShm(const vector<Sample>& samples, int calls) {
+  string name = "/ttt-ipc-" + to_string(getpid());
+  pid_t child = fork();
+  if (child == 0) { _exit(runShmEngine(name.c_str())); }
+
+  ShmEngineClient client;
+  if (!client.open(name.c_str())) { fprintf(stderr, "shm: engine did not start\n"); return; }
+  vector<double> ns;
+  ns.reserve(calls);
+  for (int i = 0; i < calls; i++) {
+    const Sample& s = samples[i % samples.size()];
+    Clock::time_point t0 = Clock::now();
+    client.call(const_cast<int(*)[3]>(s.board), s.player, GENIOUS);
+    ns.push_back(chrono::duration<double, nano>(Clock::now() - t0).count());
+  }
+  client.shutdownEngine();
+  waitpid(child, nullptr, 0);
+  report("shm", ns);
+}
+
+void benchPipe(const vector<Sample>& samples, int calls) {
+  int toEngine[2], fromEngine[2];
+  if (pipe(toEngine) < 0 || pipe(fromEngine) < 0) { perror("pipe"); return; }
+  pid_t child = fork();
+  if (child == 0) {
+    close(toEngine[1]);
+    close(fromEngine[0]);
+    _exit(runEngineProtocol(toEngine[0], fromEngine[1]));
+  }
+  close(toEngine[0]);
+  close(fromEngine[1]);
+
+  vector<double> ns;
+  ns.reserve(calls);
+  char buf[256];
+  for (int i = 0; i < calls; i++) {
+    const Sample& s = samples[i % samples.size()];
+    Clock::time_point t0 = Clock::now();
+    if (write(toEngine[1], s.request.data(), s.request.size()) < 0) { break; }
+    // Replies are single short lines
+    size_t have = 0;
+    do {
+      ssize_t n = read(fromEngine[0], buf + have, sizeof(buf) - have);
+      if (n <= 0) { break; }
+      have += n;
+    } while (buf[have - 1] != '\n');
+    ns.push_back(chrono::duration<double, nano>(Clock::now() - t0).count());
+  }
+  close(toEngine[1]);
+  waitpid(child, nullptr, 0);
+  close(fromEngine[0]);
+  report("pipe", ns);
+}
+
+int main(int argc, char* argv[]) {
+  int calls = 200000;
+  for (int i = 1; i + 1 < argc; i += 2) {
+    string key = argv[i];
+    if (key == "--calls") { calls = atoi(argv[i + 1]); }
+    else { fprintf(stderr, "unknown option %s\n", key.c_str()); return 1; }
+  }
+  vector<Sample> samples = samplePositions(4096);
+  benchShm(samples, calls);
+  benchPipe(samples, calls);
+  return 0;
+}
@@ -0,0 +1,126 @@
+/**
+ * Cost and accuracy of the latency histograms (see latency.h).
+ *
+ *   latency [--samples N] [--threads T]
+ *
+ * Times isGameOver over the positions of simulated games with recording
+ * off and on, and recordLatency on its own from T threads at once,
+ * checking that no sample is lost. Then records N samples spread over
+ * six orders of magnitude and compares the reported percentiles with
+ * the exact ones.
+ */
+#include "engine.h"
+#include "game_record.h"
+#include "latency.h"
+#include "move_table.h"
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+#include <thread>
+#include <vector>
+using namespace std;
+
+typedef chrono::steady_clock Clock;
+
+struct Options {
+  long samples = 2000000;
+  int  threads = 1;
+};
+
+struct Board {
+  int cells[3][3];
+};
+
+double secondsSince(Clock::time_point start) { return chrono::duration<double>(Clock::now() - start).count(); }
+
+/** Nanoseconds per isGameOver call over `boards`. */
+double timeGameOver(vector<Board>& boards, int passes) {
+  long sink = 0;
+  Clock::time_point start = Clock::now();
+  for (int pass = 0; pass < passes; pass++) {
+    for (Board& b : boards) { sink += isGameOver(b.cells); }
+  }
+  double nanos = secondsSince(start) * 1e9 / passes / boards.size();
+  if (sink == 1) { printf(" "); }
+  return nanos;
+}
+
+int main(int argc, char* argv[]) {
+  Options opt;
+  for (int i = 1; i < argc; i++) {
+    string key = argv[i];
+    if      (key == "--samples" && i + 1 < argc) { opt.samples = atol(argv[++i]); }
+    else if (key == "--threads" && i + 1 < argc) { opt.threads = atoi(argv[++i]); }
+    else { fprintf(stderr, "unknown option %s\n", key.c_str()); return 1; }
+  }
+
+  MoveTables* tables = buildMoveTables();
+  vector<Board> boards;
+  for (long i = 0; i < 20000; i++) {
+    GameRecord game = {};
+    game.seed             = i;
+    game.userStrategy     = i % 3;
+    game.computerStrategy = (i / 3) % 3;
+    game.first            = (i / 9) % 2 ? COMPUTER : USER;
+    simulateGame(game, *tables);
+    Board board = {};
+    int player = game.first;
+    for (int m = 0; m < game.moveCount; m++) {
+      board.cells[game.moves[m] / 3][game.moves[m] % 3] = player;
+      player = (player == USER) ? COMPUTER : USER;
+      boards.push_back(board);
+    }
+  }
+  delete tables;
+
+  double off = timeGameOver(boards, 20);
+  enableLatency(true);
+  double on = timeGameOver(boards, 20);
+  enableLatency(false);
+  uint64_t timed = latencySummary(LATENCY_GAME_OVER).count;
+
+  // Recording alone, every thread into the same metric
+  long perThread = opt.samples;
+  Clock::time_point start = Clock::now();
+  vector<thread> threads;
+  for (int t = 0; t < opt.threads; t++) {
+    threads.emplace_back([perThread, t] {
+      for (long i = 0; i < perThread; i++) { recordLatency(LATENCY_RANDOM_MOVE, 50 + ((i * 7919 + t) & 1023)); }
+    });
+  }
+  for (thread& t : threads) { t.join(); }
+  double recordNanos = secondsSince(start) * 1e9 / perThread;
+  uint64_t recorded = latencySummary(LATENCY_RANDOM_MOVE).count;
+
+  // Log-uniform samples from 10 ns to 10 ms
+  vector<uint64_t> values(opt.samples);
+  uint64_t state = 88172645463325252ull;
+  for (uint64_t& v : values) {
+    state ^= state << 13;
+    state ^= state >> 7;
+    state ^= state << 17;
+    v = (uint64_t)pow(10.0, 1 + 6 * double(state >> 11) / double(1ull << 53));
+    recordLatency(LATENCY_USER_MOVE, v);
+  }
+  sort(values.begin(), values.end());
+  LatencySummary s = latencySummary(LATENCY_USER_MOVE);
+  const double SHARES[5] = {0.5, 0.9, 0.99, 0.999, 0.9999};
+  uint64_t reported[5] = {s.p50, s.p90, s.p99, s.p999, s.p9999};
+  double worst = 0;
+  for (int i = 0; i < 5; i++) {
+    uint64_t exact = values[(size_t)ceil(SHARES[i] * values.size()) - 1];
+    worst = max(worst, fabs(double(reported[i]) - double(exact)) / double(exact));
+  }
+
+  printf("isGameOver (ns):        %.1f off, %.1f recording (%llu samples)\n", off, on, (unsigned long long)timed);
+  printf("recordLatency (ns):     %.1f per sample per thread, %d thread(s)\n", recordNanos, opt.threads);
+  printf("samples lost:           %lld\n", (long long)perThread * opt.threads - (long long)recorded);
+  printf("percentiles (ns):       p50 %llu  p99 %llu  p99.9 %llu  p99.99 %llu\n", (unsigned long long)s.p50,
+         (unsigned long long)s.p99, (unsigned long long)s.p999, (unsigned long long)s.p9999);
+  printf("worst percentile error: %.2f%%\n", worst * 100);
+  bool ok = recorded == (uint64_t)perThread * opt.threads && timed == 20 * boards.size() && worst < 0.016;
+  return ok ? 0 : 1;
+}
@@ -0,0 +1,139 @@
+/**
+ * Records simulated games into the opening statistics (see
+ * opening_stats.h) from several threads while another thread queries
+ * them, then checks the counts.
+ *
+ *   opening_stats [--games N] [--threads T] [--seconds S] [--plies P]
+ *
+ * Reports the ingest rate, in total and per thread, and query latency
+ * percentiles with nothing being recorded and during the ingest.
+ */
+#include "move_table.h"
+#include "opening_stats.h"
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+#include <thread>
+#include <vector>
+using namespace std;
+
+typedef chrono::steady_clock Clock;
+
+struct Options {
+  long   games   = 1000000;
+  int    threads = 1;
+  double seconds = 2;
+  int    plies   = OpeningStats::DEFAULT_PLIES;
+};
+
+/** Positions of the first plies of `games`, to query. */
+vector<pair<unsigned, unsigned>> samplePositions(const vector<GameRecord>& games, int plies) {
+  vector<pair<unsigned, unsigned>> positions;
+  for (size_t g = 0; g < games.size() && positions.size() < 4096; g += 97) {
+    const GameRecord& game = games[g];
+    unsigned boards[2] = {0, 0};
+    int moves = min<int>(game.moveCount, (g / 97) % (plies + 1));
+    for (int i = 0; i < moves; i++) { boards[i & 1] |= 1u << game.moves[i]; }
+    bool userFirst = (game.first == USER);
+    positions.push_back({boards[userFirst ? 0 : 1], boards[userFirst ? 1 : 0]});
+  }
+  return positions;
+}
+
+/** Time queries of `positions` until `stop`, or `count` of them. */
+vector<double> timeQueries(const OpeningStats& stats, const vector<pair<unsigned, unsigned>>& positions,
+                           const atomic<bool>* stop, size_t count) {
+  vector<double> nanos;
+  uint64_t sink = 0;
+  for (size_t i = 0; stop ? !stop->load(memory_order_relaxed) : i < count; i++) {
+    const pair<unsigned, unsigned>& p = positions[i % positions.size()];
+    Clock::time_point start = Clock::now();
+    OpeningStats::Counts counts = stats.position(p.first, p.second);
+    nanos.push_back(chrono::duration<double, nano>(Clock::now() - start).count());
+    sink += counts.games;
+    if (stop && i % 64 == 63) { this_thread::yield(); }   // leave the CPU to the ingest when there are few
+  }
+  if (sink == 1) { printf(" "); }
+  sort(nanos.begin(), nanos.end());
+  return nanos;
+}
+
+int main(int argc, char* argv[]) {
+  Options opt;
+  for (int i = 1; i < argc; i++) {
+    string key = argv[i];
+    if      (key == "--games" && i + 1 < argc)   { opt.games   = atol(argv[++i]); }
+    else if (key == "--threads" && i + 1 < argc) { opt.threads = atoi(argv[++i]); }
+    else if (key == "--seconds" && i + 1 < argc) { opt.seconds = atof(argv[++i]); }
+    else if (key == "--plies" && i + 1 < argc)   { opt.plies   = atoi(argv[++i]); }
+    else { fprintf(stderr, "unknown option %s\n", key.c_str()); return 1; }
+  }
+
+  MoveTables* tables = buildMoveTables();
+  vector<GameRecord> games(opt.games);
+  for (long i = 0; i < opt.games; i++) {
+    GameRecord& game = games[i];
+    game = GameRecord{};
+    game.seed             = i;
+    game.userStrategy     = i % 3;
+    game.computerStrategy = (i / 3) % 3;
+    game.first            = (i / 9) % 2 ? COMPUTER : USER;
+    simulateGame(game, *tables);
+  }
+  delete tables;
+
+  // The counts of one pass over the games, to check against
+  OpeningStats once(opt.plies);
+  {
+    OpeningStats::Recorder recorder(once);
+    for (const GameRecord& game : games) { recorder.record(game); }
+  }
+
+  OpeningStats stats(opt.plies);
+  vector<pair<unsigned, unsigned>> positions = samplePositions(games, opt.plies);
+  vector<double> idle = timeQueries(stats, positions, nullptr, 200000);
+
+  // Whole passes over the games per thread, until time is up
+  atomic<bool> stop(false), queriesDone(false);
+  vector<long> passes(opt.threads);
+  vector<thread> threads;
+  Clock::time_point start = Clock::now();
+  for (int t = 0; t < opt.threads; t++) {
+    threads.emplace_back([&, t] {
+      OpeningStats::Recorder recorder(stats);
+      while (!stop.load(memory_order_relaxed)) {
+        for (const GameRecord& game : games) { recorder.record(game); }
+        passes[t]++;
+      }
+    });
+  }
+  vector<double> busy;
+  thread querier([&] { busy = timeQueries(stats, positions, &queriesDone, 0); });
+  this_thread::sleep_for(chrono::duration<double>(opt.seconds));
+  stop.store(true);
+  for (thread& t : threads) { t.join(); }
+  double seconds = chrono::duration<double>(Clock::now() - start).count();
+  queriesDone.store(true);
+  querier.join();
+
+  long totalPasses = 0;
+  for (long p : passes) { totalPasses += p; }
+  long wrong = 0;
+  for (const pair<unsigned, unsigned>& p : positions) {
+    OpeningStats::Counts expected = once.position(p.first, p.second), got = stats.position(p.first, p.second);
+    wrong += (got.games != expected.games * totalPasses);
+    for (int r = 0; r < 4; r++) { wrong += (got.results[r] != expected.results[r] * totalPasses); }
+  }
+
+  double rate = totalPasses * opt.games / seconds;
+  printf("positions:            %zu (first %d plies)\n", stats.positions(), opt.plies);
+  printf("ingest (games/s):     %.0f with %d thread(s), %.0f per thread\n", rate, opt.threads, rate / opt.threads);
+  printf("query idle (ns):      p50 %.0f  p99 %.0f\n", idle[idle.size() / 2], idle[idle.size() * 99 / 100]);
+  printf("query ingesting (ns): p50 %.0f  p99 %.0f  (%zu queries)\n", busy[busy.size() / 2],
+         busy[busy.size() * 99 / 100], busy.size());
+  printf("wrong counts:         %ld\n", wrong);
+  return wrong ? 1 : 0;
+}
@@ -0,0 +1,60 @@
+/**
+ * Rate of the game-tree count (see perft.h) from the empty board to
+ * depth 9, walked plainly and with the subtree table, on 1 to T threads.
+ *
+ *   perft [--threads T] [--seconds S]
+ *
+ * Repeats each count for about S seconds and reports nodes per second
+ * and counts per second; every count must come to the known totals.
+ * Hashed nodes are those of the whole tree, most of them added in bulk
+ * rather than visited.
+ */
+#include "game_record.h"
+#include "perft.h"
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+using namespace std;
+
+typedef chrono::steady_clock Clock;
+
+struct Options {
+  int    threads = 1;
+  double seconds = 1;
+};
+
+int main(int argc, char* argv[]) {
+  Options opt;
+  for (int i = 1; i < argc; i++) {
+    string key = argv[i];
+    if      (key == "--threads" && i + 1 < argc) { opt.threads = atoi(argv[++i]); }
+    else if (key == "--seconds" && i + 1 < argc) { opt.seconds = atof(argv[++i]); }
+    else { fprintf(stderr, "unknown option %s\n", key.c_str()); return 1; }
+  }
+
+  long wrong = 0;
+  printf("%-7s %7s %8s %14s %10s\n", "walk", "threads", "counts", "nodes/s", "counts/s");
+  for (bool hashed : {false, true}) {
+    for (int threads = 1;; threads = (threads * 2 < opt.threads) ? threads * 2 : opt.threads) {
+      long counts = 0;
+      uint64_t nodes = 0;
+      Clock::time_point start = Clock::now();
+      double seconds = 0;
+      while (seconds < opt.seconds) {
+        PerftCounts c = perft(0, 0, USER, 9, threads, hashed);
+        wrong += c.nodes != 549946 || c.leaves != 127872 || c.games != 255168
+              || c.results[resultCode(USER_WON)] != 131184 || c.results[resultCode(COMPUTER_WON)] != 77904
+              || c.results[resultCode(DRAW)] != 46080;
+        nodes += c.nodes;
+        counts++;
+        seconds = chrono::duration<double>(Clock::now() - start).count();
+      }
+      printf("%-7s %7d %8ld %14.0f %10.1f\n", hashed ? "hashed" : "plain", threads, counts, nodes / seconds,
+             counts / seconds);
+      if (threads >= opt.threads) { break; }
+    }
+  }
+  printf("wrong counts: %ld\n", wrong);
+  return wrong ? 1 : 0;
+}
@@ -0,0 +1,112 @@
+/**
+ * Cost of streaming game results (see result_writer.h), on its own: the
+ * games are simulated first, then written in each format to /dev/null,
+ * which isolates formatting and buffering, and to a file.
+ *
+ *   result_output [--games N] [--file PATH]
+ *
+ * Reports nanoseconds and bytes per game and games per second for each
+ * format, next to the simulation rate and an fprintf line per game.
+ */
+#include "move_table.h"
+#include "result_writer.h"
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <fcntl.h>
+#include <string>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <vector>
+using namespace std;
+
+typedef chrono::steady_clock Clock;
+
+struct Options {
+  string file;
+  long   games = 2000000;
+};
+
+struct Output {
+  const char* name;
+  int         format;
+  uint64_t    batch;
+};
+
+double seconds(Clock::time_point start) { return chrono::duration<double>(Clock::now() - start).count(); }
+
+void report(const char* name, const char* target, long games, double secs, long bytes) {
+  printf("%-18s %-10s %9.1f %12.0f %10.1f\n", name, target, secs * 1e9 / games, games / secs, double(bytes) / games);
+}
+
+int main(int argc, char* argv[]) {
+  Options opt;
+  opt.file = "/tmp/ttt-results-" + to_string(getpid());
+  for (int i = 1; i < argc; i++) {
+    string key = argv[i];
+    if      (key == "--games" && i + 1 < argc) { opt.games = atol(argv[++i]); }
+    else if (key == "--file" && i + 1 < argc)  { opt.file  = argv[++i]; }
+    else { fprintf(stderr, "unknown option %s\n", key.c_str()); return 1; }
+  }
+
+  MoveTables* tables = buildMoveTables();
+  vector<GameRecord> games(opt.games);
+  Clock::time_point start = Clock::now();
+  for (long i = 0; i < opt.games; i++) {
+    GameRecord& game = games[i];
+    game = GameRecord{};
+    game.seed             = i;
+    game.userStrategy     = i % 3;
+    game.computerStrategy = (i / 3) % 3;
+    game.first            = (i / 9) % 2 ? COMPUTER : USER;
+    simulateGame(game, *tables);
+  }
+  double simulateSeconds = seconds(start);
+  delete tables;
+
+  printf("%-18s %-10s %9s %12s %10s\n", "output", "to", "ns/game", "games/s", "bytes/game");
+  report("(simulation)", "-", opt.games, simulateSeconds, 0);
+  static const Output OUTPUTS[] = {
+    {"ndjson", OUTPUT_NDJSON, 0},
+    {"csv", OUTPUT_CSV, 0},
+    {"ndjson summaries", OUTPUT_NDJSON, 100000},
+  };
+  for (const Output& output : OUTPUTS) {
+    for (int toFile = 0; toFile < 2; toFile++) {
+      const char* path = toFile ? opt.file.c_str() : "/dev/null";
+      int fd = open(path, O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+      if (fd < 0) { perror(path); return 1; }
+      start = Clock::now();
+      {
+        ResultWriter writer(fd, output.format, output.batch);
+        for (const GameRecord& game : games) {
+          if (!writer.write(game)) { perror("write"); return 1; }
+        }
+        if (!writer.finish()) { perror("write"); return 1; }
+      }
+      double secs = seconds(start);
+      close(fd);
+      struct stat st;
+      long bytes = (toFile && stat(path, &st) == 0) ? st.st_size : 0;
+      report(output.name, toFile ? "file" : "/dev/null", opt.games, secs, bytes);
+    }
+  }
+
+  // The obvious way, for comparison
+  FILE* f = fopen(opt.file.c_str(), "w");
+  if (!f) { perror("fopen"); return 1; }
+  start = Clock::now();
+  for (long i = 0; i < opt.games; i++) {
+    const GameRecord& game = games[i];
+    char moves[10];
+    for (int m = 0; m < game.moveCount; m++) { moves[m] = '0' + game.moves[m]; }
+    moves[game.moveCount] = '\0';
+    fprintf(f, "{\"game\":%ld,\"seed\":%u,\"user\":%d,\"computer\":%d,\"first\":%d,\"result\":%d,\"moves\":\"%s\"}\n",
+            i, game.seed, game.userStrategy, game.computerStrategy, game.first, game.status, moves);
+    fflush(f);
+  }
+  fclose(f);
+  report("fprintf + fflush", "file", opt.games, seconds(start), 0);
+  unlink(opt.file.c_str());
+  return 0;
+}
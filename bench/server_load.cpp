@@ -0,0 +1,210 @@
+/**
+ * Load generator for the game server. Each client connection plays a
+ * number of concurrent games, sending one move for every game in a
+ * single write and timing each reply. Reports throughput, p50/p99 move
+ * latency and, when the server runs in this process, the memory cost of
+ * idle sessions and the occupancy of the server's pools.
+ *
+ *   server_load [--address A] [--threads N] [--backend epoll|uring]
+ *               [--connections C] [--games G] [--seconds S] [--idle N]
+ *               [--batch B]
+ *
+ * Without --address a server is started in-process on a Unix socket, and
+ * the CPU time its reactor threads use per request is reported as well,
+ * to compare the network backends. --batch sets how many computer moves
+ * that server collects before computing them (1 disables batching).
+ */
+#include "engine.h"
+#include "game_server.h"
+#include "net.h"
+#include "server.h"
+#include "wire_client.h"
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <thread>
+#include <unistd.h>
+#include <vector>
+using namespace std;
+
+typedef chrono::steady_clock Clock;
+
+struct Options {
+  string address;
+  int    threads     = 1;
+  int    backend     = BACKEND_EPOLL;
+  int    connections = 4;
+  int    games       = 64;      // concurrent games per connection
+  double seconds     = 3;
+  int    idle        = 1000000; // sessions created for the memory measurement
+  int    batch       = 64;      // GameServerOptions::maxBatch of the in-process server
+};
+
+/** A game as tracked by the client, to pick legal moves. */
+struct ClientGame {
+  uint32_t id;
+  uint8_t  cells[9];
+  uint8_t  status;
+};
+
+void newGame(ClientGame& g, const WireReply& rep) {
+  g.id = rep.session;
+  memset(g.cells, EMPTY, sizeof(g.cells));
+  if (rep.cell != NO_CELL) { g.cells[rep.cell] = COMPUTER; }
+  g.status = rep.status;
+}
+
+/**
+ * One client connection: keeps `games` games going until `deadline`,
+ * recording the latency of every move.
+ */
+void client(const Options& opt, Clock::time_point deadline, vector<uint32_t>& latencies, long& requests) {
+  int fd = connectTo(opt.address);
+  if (fd < 0) { perror("connect"); return; }
+
+  vector<ClientGame> games(opt.games);
+  vector<WireRequest> batch;
+  vector<int> owner;  // game index for each request in the batch
+
+  // Open the games
+  for (int i = 0; i < opt.games; i++) {
+    WireRequest req = {OP_NEW, GENIOUS, (uint8_t)(rand() % 2 ? NEW_COMPUTER_FIRST : 0), 0, 0};
+    batch.push_back(req);
+  }
+  sendAll(fd, batch.data(), batch.size() * sizeof(WireRequest));
+  readReplies(fd, batch.size(), [&](size_t i, const WireReply& rep, Clock::time_point) { newGame(games[i], rep); });
+
+  while (Clock::now() < deadline) {
+    batch.clear();
+    owner.clear();
+    for (int i = 0; i < opt.games; i++) {
+      ClientGame& g = games[i];
+      if (g.status != IN_PROGRESS) {
+        // Replace finished games
+        batch.push_back(WireRequest{OP_CLOSE, 0, 0, 0, g.id});
+        owner.push_back(i);
+        batch.push_back(WireRequest{OP_NEW, GENIOUS, 0, 0, 0});
+        owner.push_back(i);
+        continue;
+      }
+      int empty[9], n = 0;
+      for (int c = 0; c < 9; c++) { if (g.cells[c] == EMPTY) { empty[n++] = c; } }
+      int cell = empty[rand() % n];
+      g.cells[cell] = USER;
+      batch.push_back(WireRequest{OP_MOVE, (uint8_t)cell, 0, 0, g.id});
+      owner.push_back(i);
+    }
+
+    Clock::time_point sent = Clock::now();
+    if (!sendAll(fd, batch.data(), batch.size() * sizeof(WireRequest))) { break; }
+    bool ok = readReplies(fd, batch.size(), [&](size_t i, const WireReply& rep, Clock::time_point now) {
+      ClientGame& g = games[owner[i]];
+      if (rep.op == OP_NEW) { newGame(g, rep); return; }
+      if (rep.op != OP_MOVE) { return; }
+      latencies.push_back(chrono::duration_cast<chrono::nanoseconds>(now - sent).count());
+      if (rep.cell != NO_CELL) { g.cells[rep.cell] = COMPUTER; }
+      g.status = rep.status;
+    });
+    if (!ok) { break; }
+    requests += batch.size();
+  }
+  close(fd);
+}
+
+/**
+ * Create `count` idle sessions and measure how much memory they cost.
+ *
+ * @return double  bytes per session
+ */
+double measureSessionMemory(const Options& opt) {
+  int fd = connectTo(opt.address);
+  if (fd < 0) { return 0; }
+  long before = residentBytes();
+  const int chunk = 1024;
+  vector<WireRequest> batch(chunk, WireRequest{OP_NEW, GENIOUS, 0, 0, 0});
+  for (int made = 0; made < opt.idle; made += chunk) {
+    sendAll(fd, batch.data(), batch.size() * sizeof(WireRequest));
+    readReplies(fd, batch.size(), [](size_t, const WireReply&, Clock::time_point) {});
+  }
+  long after = residentBytes();
+  close(fd);
+  return double(after - before) / opt.idle;
+}
+
+int main(int argc, char* argv[]) {
+  Options opt;
+  for (int i = 1; i + 1 < argc; i += 2) {
+    string key = argv[i];
+    if      (key == "--address")     { opt.address     = argv[i + 1]; }
+    else if (key == "--threads")     { opt.threads     = atoi(argv[i + 1]); }
+    else if (key == "--backend")     { opt.backend     = string(argv[i + 1]) == "uring" ? BACKEND_URING : BACKEND_EPOLL; }
+    else if (key == "--connections") { opt.connections = atoi(argv[i + 1]); }
+    else if (key == "--games")       { opt.games       = atoi(argv[i + 1]); }
+    else if (key == "--seconds")     { opt.seconds     = atof(argv[i + 1]); }
+    else if (key == "--idle")        { opt.idle        = atoi(argv[i + 1]); }
+    else if (key == "--batch")       { opt.batch       = atoi(argv[i + 1]); }
+    else { fprintf(stderr, "unknown option %s\n", key.c_str()); return 1; }
+  }
+
+  Server server;
+  GameServerOptions gameOptions;
+  gameOptions.maxBatch = opt.batch;
+  bool local = opt.address.empty();
+  if (local) {
+    opt.address = "unix:/tmp/ttt-load-" + to_string(getpid()) + ".sock";
+    ServerConfig config;
+    config.address = opt.address;
+    config.threads = opt.threads;
+    config.backend = opt.backend;
+    if (!server.start(config, makeGameHandler, &gameOptions)) { perror("server"); return 1; }
+  }
+
+  double cpuBefore = server.cpuSeconds();
+  Clock::time_point start = Clock::now();
+  Clock::time_point deadline = start + chrono::duration_cast<Clock::duration>(chrono::duration<double>(opt.seconds));
+  vector<vector<uint32_t>> latencies(opt.connections);
+  vector<long> requests(opt.connections);
+  vector<thread> clients;
+  for (int i = 0; i < opt.connections; i++) {
+    clients.emplace_back(client, cref(opt), deadline, ref(latencies[i]), ref(requests[i]));
+  }
+  for (thread& t : clients) { t.join(); }
+  double elapsed = chrono::duration<double>(Clock::now() - start).count();
+  double cpu = server.cpuSeconds() - cpuBefore;
+
+  vector<uint32_t> all;
+  long total = 0;
+  for (int i = 0; i < opt.connections; i++) {
+    all.insert(all.end(), latencies[i].begin(), latencies[i].end());
+    total += requests[i];
+  }
+  sort(all.begin(), all.end());
+
+  if (local) { printf("backend:           %s\n", opt.backend == BACKEND_URING ? "uring" : "epoll"); }
+  if (local) { printf("batch:             %d\n", opt.batch); }
+  printf("connections:       %d\n", opt.connections);
+  printf("games/connection:  %d\n", opt.games);
+  printf("requests/sec:      %.0f\n", total / elapsed);
+  printf("moves:             %zu\n", all.size());
+  if (local && total > 0) { printf("server cpu/request (ns): %.0f\n", cpu * 1e9 / total); }
+  if (!all.empty()) {
+    printf("move p50 (us):     %.1f\n", all[all.size() / 2] / 1000.0);
+    printf("move p99 (us):     %.1f\n", all[all.size() * 99 / 100] / 1000.0);
+  }
+  if (local && opt.idle > 0) {
+    double perSession = measureSessionMemory(opt);
+    printf("bytes/session:     %.1f\n", perSession);
+    if (perSession > 0) { printf("sessions/GB:       %.0f\n", (1 << 30) / perSession); }
+    unlink(opt.address.c_str() + 5);
+  }
+  if (local) {
+    PoolStats sessions = server.sessionStats(), connections = server.connectionStats();
+    printf("session pool:      %zu live / %zu slots, %.1f MiB\n", sessions.live, sessions.capacity, sessions.bytes / 1048576.0);
+    printf("connection pool:   %zu live / %zu slots, %.1f MiB\n", connections.live, connections.capacity, connections.bytes / 1048576.0);
+  }
+  server.stop();
+  return 0;
+}
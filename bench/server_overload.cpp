@@ -0,0 +1,187 @@
+/**
+ * Overload test for the game server's admission control. An in-process
+ * server is driven past saturation by bulk clients (REQUEST_BULK), each
+ * keeping a large window of moves in flight, while interactive clients
+ * play a few games each and time every move. Reports the interactive
+ * p50/p99/p99.9 latency and how much bulk work was served or turned away.
+ *
+ *   server_overload [--bulk B] [--window W] [--interactive N] [--games G]
+ *                   [--seconds S] [--backend epoll|uring]
+ *                   [--queue Q] [--bulk-limit L]
+ *
+ * --queue and --bulk-limit set GameServerOptions::maxQueue and maxBulk;
+ * 0 turns the limit off, to compare against an unprotected server.
+ */
+#include "engine.h"
+#include "game_server.h"
+#include "net.h"
+#include "server.h"
+#include "wire_client.h"
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <thread>
+#include <unistd.h>
+#include <vector>
+using namespace std;
+
+typedef chrono::steady_clock Clock;
+
+struct Options {
+  string address;
+  int    backend     = BACKEND_EPOLL;
+  int    bulk        = 4;      // bulk connections
+  int    window      = 1024;   // bulk games (moves in flight) per connection
+  int    interactive = 4;      // interactive connections
+  int    games       = 4;      // games per interactive connection
+  double seconds     = 3;
+  GameServerOptions server;
+};
+
+struct ClientGame {
+  uint32_t id;
+  uint8_t  cells[9];
+  uint8_t  status;
+};
+
+struct Counters {
+  vector<uint32_t> latencies;   // interactive moves, in ns
+  long             served = 0;  // requests answered RESULT_OK
+  long             busy   = 0;  // requests answered RESULT_BUSY
+};
+
+/**
+ * One client connection playing `count` games until `deadline`: every
+ * round sends one request per game in a single write and waits for all
+ * the replies. Busy replies leave the game as it was, to be retried;
+ * any busy reply makes the client back off briefly before the next round.
+ */
+void client(const Options& opt, int count, uint8_t flags, Clock::time_point deadline, Counters& out) {
+  int fd = connectTo(opt.address);
+  if (fd < 0) { perror("connect"); return; }
+
+  vector<ClientGame> games(count);
+  for (ClientGame& g : games) { g.status = DRAW; g.id = 0; }  // opened in the first round
+  vector<WireRequest> batch;
+  vector<int> owner;
+  vector<int> claimed;  // cell each move request claimed, to undo on busy
+
+  while (Clock::now() < deadline) {
+    batch.clear();
+    owner.clear();
+    claimed.clear();
+    for (int i = 0; i < count; i++) {
+      ClientGame& g = games[i];
+      if (g.status != IN_PROGRESS) {
+        if (g.id) {
+          batch.push_back(WireRequest{OP_CLOSE, 0, flags, 0, g.id});
+          owner.push_back(i);
+          claimed.push_back(-1);
+          g.id = 0;
+        }
+        batch.push_back(WireRequest{OP_NEW, GENIOUS, flags, 0, 0});
+        owner.push_back(i);
+        claimed.push_back(-1);
+        continue;
+      }
+      int empty[9], n = 0;
+      for (int c = 0; c < 9; c++) { if (g.cells[c] == EMPTY) { empty[n++] = c; } }
+      int cell = empty[rand() % n];
+      g.cells[cell] = USER;
+      batch.push_back(WireRequest{OP_MOVE, (uint8_t)cell, flags, 0, g.id});
+      owner.push_back(i);
+      claimed.push_back(cell);
+    }
+
+    Clock::time_point sent = Clock::now();
+    if (!sendAll(fd, batch.data(), batch.size() * sizeof(WireRequest))) { break; }
+    long busy = 0;
+    bool ok = readReplies(fd, batch.size(), [&](size_t i, const WireReply& rep, Clock::time_point now) {
+      ClientGame& g = games[owner[i]];
+      if (rep.result == RESULT_BUSY) {
+        busy++;
+        if (claimed[i] >= 0) { g.cells[claimed[i]] = EMPTY; }
+        return;
+      }
+      out.served++;
+      if (rep.op == OP_NEW) {
+        g.id = rep.session;
+        g.status = IN_PROGRESS;
+        memset(g.cells, EMPTY, sizeof(g.cells));
+        if (rep.cell != NO_CELL) { g.cells[rep.cell] = COMPUTER; }
+        return;
+      }
+      if (rep.op != OP_MOVE) { return; }
+      if (!flags) { out.latencies.push_back(chrono::duration_cast<chrono::nanoseconds>(now - sent).count()); }
+      if (rep.cell != NO_CELL) { g.cells[rep.cell] = COMPUTER; }
+      g.status = rep.status;
+    });
+    if (!ok) { break; }
+    out.busy += busy;
+    if (busy > 0) { this_thread::sleep_for(chrono::microseconds(200)); }
+  }
+  close(fd);
+}
+
+int main(int argc, char* argv[]) {
+  Options opt;
+  for (int i = 1; i + 1 < argc; i += 2) {
+    string key = argv[i];
+    if      (key == "--bulk")        { opt.bulk        = atoi(argv[i + 1]); }
+    else if (key == "--window")      { opt.window      = atoi(argv[i + 1]); }
+    else if (key == "--interactive") { opt.interactive = atoi(argv[i + 1]); }
+    else if (key == "--games")       { opt.games       = atoi(argv[i + 1]); }
+    else if (key == "--seconds")     { opt.seconds     = atof(argv[i + 1]); }
+    else if (key == "--backend")     { opt.backend     = string(argv[i + 1]) == "uring" ? BACKEND_URING : BACKEND_EPOLL; }
+    else if (key == "--queue")       { opt.server.maxQueue = atoi(argv[i + 1]); }
+    else if (key == "--bulk-limit")  { opt.server.maxBulk  = atoi(argv[i + 1]); }
+    else { fprintf(stderr, "unknown option %s\n", key.c_str()); return 1; }
+  }
+
+  opt.address = "unix:/tmp/ttt-overload-" + to_string(getpid()) + ".sock";
+  ServerConfig config;
+  config.address = opt.address;
+  config.backend = opt.backend;
+  Server server;
+  if (!server.start(config, makeGameHandler, &opt.server)) { perror("server"); return 1; }
+
+  Clock::time_point start = Clock::now();
+  Clock::time_point deadline = start + chrono::duration_cast<Clock::duration>(chrono::duration<double>(opt.seconds));
+  vector<Counters> interactive(opt.interactive), bulk(opt.bulk);
+  vector<thread> clients;
+  for (Counters& c : interactive) { clients.emplace_back(client, cref(opt), opt.games, 0, deadline, ref(c)); }
+  for (Counters& c : bulk)        { clients.emplace_back(client, cref(opt), opt.window, REQUEST_BULK, deadline, ref(c)); }
+  for (thread& t : clients) { t.join(); }
+  double elapsed = chrono::duration<double>(Clock::now() - start).count();
+  server.stop();
+  unlink(opt.address.c_str() + 5);
+
+  vector<uint32_t> all;
+  long bulkServed = 0, bulkBusy = 0, interactiveBusy = 0;
+  for (Counters& c : interactive) {
+    all.insert(all.end(), c.latencies.begin(), c.latencies.end());
+    interactiveBusy += c.busy;
+  }
+  for (Counters& c : bulk) {
+    bulkServed += c.served;
+    bulkBusy += c.busy;
+  }
+  sort(all.begin(), all.end());
+
+  printf("max queue/bulk:      %zu / %zu\n", opt.server.maxQueue, opt.server.maxBulk);
+  printf("bulk connections:    %d x %d in flight\n", opt.bulk, opt.window);
+  printf("interactive moves/s: %.0f\n", all.size() / elapsed);
+  if (!all.empty()) {
+    printf("interactive p50 (us):   %.1f\n", all[all.size() / 2] / 1000.0);
+    printf("interactive p99 (us):   %.1f\n", all[all.size() * 99 / 100] / 1000.0);
+    printf("interactive p99.9 (us): %.1f\n", all[all.size() * 999 / 1000] / 1000.0);
+  }
+  printf("interactive busy:    %ld\n", interactiveBusy);
+  printf("bulk served/s:       %.0f\n", bulkServed / elapsed);
+  printf("bulk busy/s:         %.0f\n", bulkBusy / elapsed);
+  return 0;
+}
@@ -0,0 +1,222 @@
+/**
+ * Fan-out of a featured game to many spectators. A player connection
+ * plays games against an in-process server as fast as it can; every
+ * watcher connection watches the game being played (OP_WATCH) and moves
+ * on to the next one when an event says the game was closed. Watchers
+ * are served from one epoll thread. Some watchers may be slow: they never
+ * read until the end, to show that the server bounds what it keeps for
+ * them instead of queueing every event.
+ *
+ *   spectators [--threads T] [--watchers W] [--slow S] [--seconds N]
+ *              [--backend epoll|uring]
+ *
+ * Reports moves played, events delivered per second, how many events
+ * the fast watchers missed, and the memory each watcher costs.
+ */
+#include "engine.h"
+#include "game_server.h"
+#include "net.h"
+#include "server.h"
+#include "wire_client.h"
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <sys/epoll.h>
+#include <thread>
+#include <unistd.h>
+#include <vector>
+using namespace std;
+
+typedef chrono::steady_clock Clock;
+
+struct Options {
+  string address;
+  int    threads  = 2;
+  int    backend  = BACKEND_EPOLL;
+  int    watchers = 1000;
+  int    slow     = 10;
+  double seconds  = 3;
+};
+
+/** The game being played, for watchers to follow. */
+atomic<uint32_t> featured(0);
+atomic<bool>     playing(true);
+
+/**
+ * Plays games one after the other. Each game is published before the
+ * previous one is closed, so watchers always have somewhere to go.
+ */
+void player(const Options& opt, long& moves) {
+  int fd = connectTo(opt.address);
+  if (fd < 0) { perror("connect"); return; }
+  Clock::time_point deadline = Clock::now() + chrono::duration_cast<Clock::duration>(chrono::duration<double>(opt.seconds));
+  uint32_t previous = 0;
+  bool havePrevious = false;
+  while (Clock::now() < deadline) {
+    WireReply rep = call(fd, WireRequest{OP_NEW, GENIOUS, 0, 0, 0});
+    uint32_t id = rep.session;
+    featured.store(id);
+    if (havePrevious) { call(fd, WireRequest{OP_CLOSE, 0, 0, 0, previous}); }
+    uint8_t cells[9] = {};
+    int status = IN_PROGRESS;
+    while (status == IN_PROGRESS) {
+      int empty[9], n = 0;
+      for (int c = 0; c < 9; c++) { if (!cells[c]) { empty[n++] = c; } }
+      int cell = empty[rand() % n];
+      cells[cell] = USER;
+      rep = call(fd, WireRequest{OP_MOVE, (uint8_t)cell, 0, 0, id});
+      if (rep.cell != NO_CELL) { cells[rep.cell] = COMPUTER; }
+      status = rep.status;
+      moves += (rep.cell != NO_CELL) ? 2 : 1;
+    }
+    previous = id;
+    havePrevious = true;
+  }
+  if (havePrevious) { call(fd, WireRequest{OP_CLOSE, 0, 0, 0, previous}); }
+  playing.store(false);
+  close(fd);
+}
+
+struct Watcher {
+  int    fd;
+  char   buf[4096];
+  size_t have = 0;
+  int    lastPly = -1;
+  long   events = 0;
+  long   missed = 0;   // plies skipped between consecutive events
+};
+
+/**
+ * Parse the replies and events buffered for `w`. On a closed event the
+ * watcher follows the next featured game.
+ */
+void consume(Watcher& w) {
+  size_t off = 0;
+  for (;;) {
+    if (w.have - off < sizeof(WireReply)) { break; }
+    if ((uint8_t)w.buf[off] != OP_EVENT) { off += sizeof(WireReply); continue; }
+    if (w.have - off < sizeof(WireEvent)) { break; }
+    WireEvent ev;
+    memcpy(&ev, w.buf + off, sizeof(ev));
+    off += sizeof(ev);
+    w.events++;
+    if (w.lastPly >= 0 && ev.cell != NO_CELL && ev.ply > w.lastPly + 1) { w.missed += ev.ply - w.lastPly - 1; }
+    w.lastPly = ev.ply;
+    if (ev.flags & EVENT_CLOSED) {
+      // Session ids are reused, so the next game may have the same id
+      w.lastPly = -1;
+      WireRequest req = {OP_WATCH, 0, 0, 0, featured.load()};
+      sendAll(w.fd, &req, sizeof(req));
+    }
+  }
+  memmove(w.buf, w.buf + off, w.have - off);
+  w.have -= off;
+}
+
+int main(int argc, char* argv[]) {
+  Options opt;
+  for (int i = 1; i + 1 < argc; i += 2) {
+    string key = argv[i];
+    if      (key == "--threads")  { opt.threads  = atoi(argv[i + 1]); }
+    else if (key == "--watchers") { opt.watchers = atoi(argv[i + 1]); }
+    else if (key == "--slow")     { opt.slow     = atoi(argv[i + 1]); }
+    else if (key == "--seconds")  { opt.seconds  = atof(argv[i + 1]); }
+    else if (key == "--backend")  { opt.backend  = string(argv[i + 1]) == "uring" ? BACKEND_URING : BACKEND_EPOLL; }
+    else { fprintf(stderr, "unknown option %s\n", key.c_str()); return 1; }
+  }
+
+  opt.address = "unix:/tmp/ttt-spectators-" + to_string(getpid()) + ".sock";
+  ServerConfig config;
+  config.address = opt.address;
+  config.threads = opt.threads;
+  config.backend = opt.backend;
+  Server server;
+  if (!server.start(config, makeGameHandler, nullptr)) { perror("server"); return 1; }
+
+  // A first game for the watchers to join
+  int control = connectTo(opt.address);
+  uint32_t first = call(control, WireRequest{OP_NEW, GENIOUS, 0, 0, 0}).session;
+  featured.store(first);
+
+  long before = residentBytes();
+  PoolStats poolBefore = server.connectionStats();
+  vector<Watcher> watchers(opt.watchers + opt.slow);
+  int ep = epoll_create1(0);
+  for (size_t i = 0; i < watchers.size(); i++) {
+    Watcher& w = watchers[i];
+    w.fd = connectTo(opt.address);
+    if (w.fd < 0) { perror("connect"); return 1; }
+    WireRequest req = {OP_WATCH, 0, 0, 0, first};
+    sendAll(w.fd, &req, sizeof(req));
+    if ((int)i < opt.watchers) {
+      setNonBlocking(w.fd);
+      epoll_event ev = {};
+      ev.events = EPOLLIN;
+      ev.data.ptr = &w;
+      epoll_ctl(ep, EPOLL_CTL_ADD, w.fd, &ev);
+    }
+  }
+  // Let the subscriptions settle before measuring their cost
+  this_thread::sleep_for(chrono::milliseconds(200));
+  long after = residentBytes();
+  PoolStats poolAfter = server.connectionStats();
+
+  long moves = 0;
+  Clock::time_point start = Clock::now();
+  thread play(player, cref(opt), ref(moves));
+  // Move the watchers on to the player's first game
+  while (featured.load() == first) { this_thread::yield(); }
+  call(control, WireRequest{OP_CLOSE, 0, 0, 0, first});
+  epoll_event events[256];
+  while (playing.load()) {
+    int n = epoll_wait(ep, events, 256, 10);
+    for (int i = 0; i < n; i++) {
+      Watcher& w = *static_cast<Watcher*>(events[i].data.ptr);
+      ssize_t got = read(w.fd, w.buf + w.have, sizeof(w.buf) - w.have);
+      if (got > 0) {
+        w.have += got;
+        consume(w);
+      }
+    }
+  }
+  double elapsed = chrono::duration<double>(Clock::now() - start).count();
+  play.join();
+
+  long fastEvents = 0, fastMissed = 0;
+  for (int i = 0; i < opt.watchers; i++) {
+    fastEvents += watchers[i].events;
+    fastMissed += watchers[i].missed;
+  }
+  // Slow watchers read only now: they get what the server kept for them
+  long slowEvents = 0;
+  for (size_t i = opt.watchers; i < watchers.size(); i++) {
+    Watcher& w = watchers[i];
+    setNonBlocking(w.fd);
+    ssize_t got;
+    while ((got = read(w.fd, w.buf + w.have, sizeof(w.buf) - w.have)) > 0) {
+      w.have += got;
+      consume(w);
+    }
+    slowEvents += w.events;
+  }
+
+  printf("server threads:       %d\n", opt.threads);
+  printf("watchers:             %d (+%d slow)\n", opt.watchers, opt.slow);
+  printf("moves/sec:            %.0f\n", moves / elapsed);
+  printf("events delivered/sec: %.0f\n", fastEvents / elapsed);
+  printf("fast watcher missed:  %.2f%% of moves\n", fastEvents ? 100.0 * fastMissed / (fastEvents + fastMissed) : 0);
+  if (opt.slow > 0) { printf("slow watcher got:     %.0f events of %ld moves\n", double(slowEvents) / opt.slow, moves); }
+  size_t connections = watchers.size();
+  printf("rss/watcher (bytes):  %.0f\n", double(after - before) / connections);
+  printf("pool/watcher (bytes): %.0f\n", double(poolAfter.bytes - poolBefore.bytes) / connections);
+
+  for (Watcher& w : watchers) { close(w.fd); }
+  close(control);
+  close(ep);
+  server.stop();
+  unlink(opt.address.c_str() + 5);
+  return 0;
+}
@@ -0,0 +1,162 @@
+/**
+ * Move latency of the game server while its move tables are replaced
+ * under it. Interactive clients play against an in-process server, one
+ * move in flight each, timing every move. The run is split in two
+ * halves: in the second, a background thread reloads the tables from a
+ * file every few milliseconds (alternating between the built-in tables
+ * and a variant where GENIOUS plays like SMART), waiting out each grace
+ * period before the next reload. It runs at nice 19, so under full load
+ * it reloads less often than asked.
+ *
+ *   table_swap [--clients C] [--threads T] [--seconds S] [--interval MS]
+ *              [--backend epoll|uring]
+ *
+ * Reports p50/p99/p99.9/max move latency of each half, the number of
+ * reloads, and how long old tables waited for readers to move on.
+ */
+#include "engine.h"
+#include "game_server.h"
+#include "move_table.h"
+#include "net.h"
+#include "server.h"
+#include "wire_client.h"
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <sys/resource.h>
+#include <thread>
+#include <unistd.h>
+#include <vector>
+using namespace std;
+
+typedef chrono::steady_clock Clock;
+
+struct Options {
+  string address;
+  int    clients  = 4;
+  int    threads  = 2;
+  int    backend  = BACKEND_EPOLL;
+  double seconds  = 4;
+  int    interval = 5;   // ms between reloads
+};
+
+atomic<bool> swapping(false);
+atomic<bool> running(true);
+
+/** Latencies of the moves made without, then with, reloads. */
+struct Latencies {
+  vector<uint32_t> steady;
+  vector<uint32_t> swapping;
+};
+
+void client(const Options& opt, Latencies& out) {
+  int fd = connectTo(opt.address);
+  if (fd < 0) { perror("connect"); return; }
+  while (running.load()) {
+    uint32_t id = call(fd, WireRequest{OP_NEW, GENIOUS, 0, 0, 0}).session;
+    unsigned taken = 0;
+    int status = IN_PROGRESS;
+    while (status == IN_PROGRESS && running.load()) {
+      int empty[9], n = 0;
+      for (int c = 0; c < 9; c++) { if (!(taken & (1 << c))) { empty[n++] = c; } }
+      int cell = empty[rand() % n];
+      taken |= 1 << cell;
+      bool during = swapping.load();
+      Clock::time_point sent = Clock::now();
+      WireReply rep = call(fd, WireRequest{OP_MOVE, (uint8_t)cell, 0, 0, id});
+      uint32_t ns = chrono::duration_cast<chrono::nanoseconds>(Clock::now() - sent).count();
+      (during ? out.swapping : out.steady).push_back(ns);
+      if (rep.cell != NO_CELL) { taken |= 1 << rep.cell; }
+      status = rep.status;
+    }
+    call(fd, WireRequest{OP_CLOSE, 0, 0, 0, id});
+  }
+  close(fd);
+}
+
+void report(const char* name, vector<uint32_t>& all, double seconds) {
+  sort(all.begin(), all.end());
+  if (all.empty()) { return; }
+  printf("%-9s moves/s %8.0f  p50 %6.1f us  p99 %6.1f us  p99.9 %6.1f us  max %7.1f us\n", name, all.size() / seconds,
+         all[all.size() / 2] / 1000.0, all[all.size() * 99 / 100] / 1000.0, all[all.size() * 999 / 1000] / 1000.0,
+         all.back() / 1000.0);
+}
+
+int main(int argc, char* argv[]) {
+  Options opt;
+  for (int i = 1; i + 1 < argc; i += 2) {
+    string key = argv[i];
+    if      (key == "--clients")  { opt.clients  = atoi(argv[i + 1]); }
+    else if (key == "--threads")  { opt.threads  = atoi(argv[i + 1]); }
+    else if (key == "--seconds")  { opt.seconds  = atof(argv[i + 1]); }
+    else if (key == "--interval") { opt.interval = atoi(argv[i + 1]); }
+    else if (key == "--backend")  { opt.backend  = string(argv[i + 1]) == "uring" ? BACKEND_URING : BACKEND_EPOLL; }
+    else { fprintf(stderr, "unknown option %s\n", key.c_str()); return 1; }
+  }
+
+  // The two table files to alternate between
+  string files[2];
+  MoveTables* tables = buildMoveTables();
+  for (int i = 0; i < 2; i++) {
+    files[i] = "/tmp/ttt-tables-" + to_string(getpid()) + "-" + to_string(i);
+    if (i == 1) { memcpy(tables->cells[GENIOUS], tables->cells[SMART], sizeof(tables->cells[GENIOUS])); }
+    if (!saveMoveTables(files[i].c_str(), *tables)) { perror("save"); return 1; }
+  }
+  delete tables;
+
+  opt.address = "unix:/tmp/ttt-tables-" + to_string(getpid()) + ".sock";
+  ServerConfig config;
+  config.address = opt.address;
+  config.threads = opt.threads;
+  config.backend = opt.backend;
+  Server server;
+  if (!server.start(config, makeGameHandler, nullptr)) { perror("server"); return 1; }
+
+  vector<Latencies> latencies(opt.clients);
+  vector<thread> clients;
+  for (Latencies& l : latencies) { clients.emplace_back(client, cref(opt), ref(l)); }
+
+  double half = opt.seconds / 2;
+  this_thread::sleep_for(chrono::duration<double>(half));
+  // Reload at the lowest priority, as `tictactoe --serve` does; only this
+  // thread, the server's threads keep theirs
+  setpriority(PRIO_PROCESS, 0, 19);
+  swapping.store(true);
+  Clock::time_point deadline = Clock::now() + chrono::duration_cast<Clock::duration>(chrono::duration<double>(half));
+  long reloads = 0;
+  double graceTotal = 0, graceMax = 0;
+  while (Clock::now() < deadline) {
+    if (!loadMoveTables(files[reloads % 2].c_str())) { perror("load"); break; }
+    reloads++;
+    Clock::time_point published = Clock::now();
+    while (reclaimMoveTables() > 0) { this_thread::sleep_for(chrono::microseconds(50)); }
+    double grace = chrono::duration<double, micro>(Clock::now() - published).count();
+    graceTotal += grace;
+    graceMax = max(graceMax, grace);
+    this_thread::sleep_for(chrono::milliseconds(opt.interval));
+  }
+  running.store(false);
+  for (thread& t : clients) { t.join(); }
+  server.stop();
+  unlink(opt.address.c_str() + 5);
+  for (const string& file : files) { unlink(file.c_str()); }
+
+  vector<uint32_t> steady, during;
+  for (Latencies& l : latencies) {
+    steady.insert(steady.end(), l.steady.begin(), l.steady.end());
+    during.insert(during.end(), l.swapping.begin(), l.swapping.end());
+  }
+  printf("clients: %d, server threads: %d\n", opt.clients, opt.threads);
+  report("steady", steady, half);
+  report("swapping", during, half);
+  printf("reloads:            %ld (every %d ms)\n", reloads, opt.interval);
+  if (reloads > 0) { printf("grace period (us):  avg %.1f, max %.1f\n", graceTotal / reloads, graceMax); }
+  MoveTableReader reader;
+  MoveTableReader::Section section(reader);
+  printf("table version now:  %llu\n", (unsigned long long)moveTables()->version);
+  return 0;
+}
@@ -0,0 +1,85 @@
+/**
+ * Cost of the tracing hooks (see trace.h): plays whole games between
+ * the strategies through `playGame`, which passes every hook (game
+ * start and end, moves, strategy decisions), and counts a perft tree,
+ * which passes a search span per subtree. Build once with and once
+ * without -DTTT_TRACE=ON and compare.
+ *
+ *   trace_overhead [--games N] [--file PATH]
+ *
+ * With tracing compiled in also reports events per game, the cost of
+ * recording one event, and writes the rings to PATH as a Chrome trace.
+ */
+#include "game_task.h"
+#include "perft.h"
+#include "trace.h"
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+#include <sys/stat.h>
+#include <unistd.h>
+using namespace std;
+
+typedef chrono::steady_clock Clock;
+
+struct Options {
+  string file;
+  long   games = 500000;
+};
+
+double secondsSince(Clock::time_point start) { return chrono::duration<double>(Clock::now() - start).count(); }
+
+int main(int argc, char* argv[]) {
+  Options opt;
+  opt.file = "/tmp/ttt-trace-" + to_string(getpid()) + ".json";
+  for (int i = 1; i < argc; i++) {
+    string key = argv[i];
+    if      (key == "--games" && i + 1 < argc) { opt.games = atol(argv[++i]); }
+    else if (key == "--file" && i + 1 < argc)  { opt.file  = argv[++i]; }
+    else { fprintf(stderr, "unknown option %s\n", key.c_str()); return 1; }
+  }
+  srand(1);
+
+  // Every pairing of the three strategies, the user moving first in half
+  ComputerPlayer players[3] = {ComputerPlayer(RANDOM), ComputerPlayer(SMART), ComputerPlayer(GENIOUS)};
+  long moves = 0;
+  uint64_t eventsBefore = TRACE_ENABLED ? traceEvents() : 0;
+  Clock::time_point start = Clock::now();
+  for (long i = 0; i < opt.games; i++) {
+    task<Outcome> game = playGame(players[i % 3], players[(i / 3) % 3], (i / 9) % 2 ? COMPUTER : USER);
+    game.start();
+    moves += game.result().moves;
+  }
+  double gameSeconds = secondsSince(start);
+  uint64_t gameEvents = TRACE_ENABLED ? traceEvents() - eventsBefore : 0;
+
+  start = Clock::now();
+  long counts = 0;
+  while (secondsSince(start) < 0.5) {
+    perft(0, 0, USER, 9, 1, false);
+    counts++;
+  }
+  double perftSeconds = secondsSince(start);
+
+  printf("tracing:            %s\n", TRACE_ENABLED ? "compiled in" : "compiled out");
+  printf("games (ns/game):    %.0f, %.1f moves a game\n", gameSeconds * 1e9 / opt.games, double(moves) / opt.games);
+  printf("perft 9 (ms):       %.2f\n", perftSeconds * 1e3 / counts);
+  if (!TRACE_ENABLED) { return 0; }
+
+  const long EVENTS = 10000000;
+  start = Clock::now();
+  for (long i = 0; i < EVENTS; i++) { trace(TRACE_DECISION, DECISION_CENTER); }
+  double eventNanos = secondsSince(start) * 1e9 / EVENTS;
+
+  start = Clock::now();
+  if (!writeChromeTrace(opt.file.c_str())) { perror("trace"); return 1; }
+  double writeSeconds = secondsSince(start);
+  struct stat st = {};
+  stat(opt.file.c_str(), &st);
+  printf("events per game:    %.1f\n", double(gameEvents) / opt.games);
+  printf("record (ns/event):  %.1f\n", eventNanos);
+  printf("chrome trace:       %s, %lld KiB in %.0f ms\n", opt.file.c_str(), (long long)st.st_size / 1024,
+         writeSeconds * 1e3);
+  return 0;
+}
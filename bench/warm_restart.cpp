@@ -0,0 +1,252 @@
+/**
+ * Warm restart of the game server. A server running in a child process
+ * with a state file hosts games that a client has played part way; the
+ * child is killed (SIGKILL) with a window of moves still in flight, and a
+ * new server is started in this process on the same files. Reports how
+ * long the new server took to start, and checks every game: its board
+ * must have every move the client saw acknowledged, and at most the move
+ * that was in flight (with the computer's reply) on top, and the user
+ * must be able to carry on playing it.
+ *
+ *   warm_restart [--games N] [--in-flight F] [--kill-after US] [--threads T]
+ *                [--state PATH] [--backend epoll|uring]
+ *
+ * Use one thread (the default) to check that play carries on: with more,
+ * a game can only be played on a connection served by its own thread.
+ */
+#include "engine.h"
+#include "game_server.h"
+#include "net.h"
+#include "server.h"
+#include "wire_client.h"
+#include <chrono>
+#include <csignal>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <sys/stat.h>
+#include <sys/wait.h>
+#include <thread>
+#include <unistd.h>
+#include <vector>
+using namespace std;
+
+typedef chrono::steady_clock Clock;
+
+struct Options {
+  string address;
+  string state;
+  int    games    = 100000;
+  int    inFlight = 4096;    // moves sent just before the kill
+  int    killAfter = 500;    // us between sending them and the kill
+  int    threads  = 1;
+  int    backend  = BACKEND_EPOLL;
+};
+
+/** The client's view of a game: what it has seen acknowledged. */
+struct ClientGame {
+  uint32_t id;
+  uint16_t user;       // bitboards
+  uint16_t computer;
+  int8_t   pending;    // cell sent but not acknowledged, or -1
+  uint8_t  status;
+};
+
+/** Send `reqs` in windows and collect one reply per request. */
+bool exchange(int fd, const vector<WireRequest>& reqs, vector<WireReply>& reps) {
+  const size_t WINDOW = 1024;
+  reps.resize(reqs.size());
+  for (size_t i = 0; i < reqs.size(); i += WINDOW) {
+    size_t n = min(WINDOW, reqs.size() - i);
+    if (!sendAll(fd, &reqs[i], n * sizeof(WireRequest))) { return false; }
+    if (!readAll(fd, &reps[i], n * sizeof(WireReply))) { return false; }
+  }
+  return true;
+}
+
+int randomEmpty(const ClientGame& g) {
+  int empty[9], n = 0;
+  for (int c = 0; c < 9; c++) {
+    if (!((g.user | g.computer) & (1 << c))) { empty[n++] = c; }
+  }
+  return empty[rand() % n];
+}
+
+/** Child: serve with the state file until killed. */
+void runServer(const Options& opt) {
+  GameServerOptions options;
+  options.stateFile = opt.state.c_str();
+  ServerConfig config;
+  config.address = opt.address;
+  config.threads = opt.threads;
+  config.backend = opt.backend;
+  Server server;
+  if (!server.start(config, makeGameHandler, &options)) { perror("server"); _exit(1); }
+  for (;;) { pause(); }
+}
+
+/** Connect, retrying while the child starts up. */
+int connectRetry(const string& address) {
+  for (int i = 0; i < 1000; i++) {
+    int fd = connectTo(address);
+    if (fd >= 0) { return fd; }
+    this_thread::sleep_for(chrono::milliseconds(5));
+  }
+  return -1;
+}
+
+int main(int argc, char* argv[]) {
+  Options opt;
+  opt.state = "/tmp/ttt-restart-" + to_string(getpid()) + ".state";
+  for (int i = 1; i + 1 < argc; i += 2) {
+    string key = argv[i];
+    if      (key == "--games")     { opt.games    = atoi(argv[i + 1]); }
+    else if (key == "--in-flight") { opt.inFlight = atoi(argv[i + 1]); }
+    else if (key == "--kill-after") { opt.killAfter = atoi(argv[i + 1]); }
+    else if (key == "--threads")   { opt.threads  = atoi(argv[i + 1]); }
+    else if (key == "--state")     { opt.state    = argv[i + 1]; }
+    else if (key == "--backend")   { opt.backend  = string(argv[i + 1]) == "uring" ? BACKEND_URING : BACKEND_EPOLL; }
+    else { fprintf(stderr, "unknown option %s\n", key.c_str()); return 1; }
+  }
+  opt.address = "unix:/tmp/ttt-restart-" + to_string(getpid()) + ".sock";
+  for (int i = 0; i < opt.threads; i++) { unlink((opt.state + "." + to_string(i)).c_str()); }
+
+  pid_t child = fork();
+  if (child == 0) { runServer(opt); }
+  int fd = connectRetry(opt.address);
+  if (fd < 0) { perror("connect"); return 1; }
+
+  // Open the games, half with the computer moving first, and play each a
+  // random number of moves
+  vector<ClientGame> games(opt.games);
+  vector<WireRequest> reqs;
+  vector<WireReply> reps;
+  for (int i = 0; i < opt.games; i++) {
+    reqs.push_back(WireRequest{OP_NEW, (uint8_t)(i % 3), (uint8_t)(i % 2 ? NEW_COMPUTER_FIRST : 0), 0, 0});
+  }
+  if (!exchange(fd, reqs, reps)) { perror("new"); return 1; }
+  for (int i = 0; i < opt.games; i++) {
+    games[i] = ClientGame{reps[i].session, 0, 0, -1, IN_PROGRESS};
+    if (reps[i].cell != NO_CELL) { games[i].computer |= 1 << reps[i].cell; }
+  }
+  for (int round = 0; round < 3; round++) {
+    reqs.clear();
+    vector<int> owner;
+    for (int i = 0; i < opt.games; i++) {
+      ClientGame& g = games[i];
+      if (g.status != IN_PROGRESS || rand() % 4 == 0) { continue; }
+      int cell = randomEmpty(g);
+      g.pending = cell;
+      reqs.push_back(WireRequest{OP_MOVE, (uint8_t)cell, 0, 0, g.id});
+      owner.push_back(i);
+    }
+    if (!exchange(fd, reqs, reps)) { perror("move"); return 1; }
+    for (size_t k = 0; k < owner.size(); k++) {
+      ClientGame& g = games[owner[k]];
+      g.user |= 1 << g.pending;
+      g.pending = -1;
+      if (reps[k].cell != NO_CELL) { g.computer |= 1 << reps[k].cell; }
+      g.status = reps[k].status;
+    }
+  }
+
+  // A window of moves the client never hears back about
+  reqs.clear();
+  for (int i = 0; i < opt.games && (int)reqs.size() < opt.inFlight; i++) {
+    ClientGame& g = games[i];
+    if (g.status != IN_PROGRESS) { continue; }
+    g.pending = randomEmpty(g);
+    reqs.push_back(WireRequest{OP_MOVE, (uint8_t)g.pending, 0, 0, g.id});
+  }
+  size_t inFlight = reqs.size();
+  sendAll(fd, reqs.data(), reqs.size() * sizeof(WireRequest));
+  this_thread::sleep_for(chrono::microseconds(opt.killAfter));
+  kill(child, SIGKILL);
+  waitpid(child, nullptr, 0);
+  close(fd);
+
+  off_t fileBytes = 0;
+  for (int i = 0; i < opt.threads; i++) {
+    struct stat st;
+    if (stat((opt.state + "." + to_string(i)).c_str(), &st) == 0) { fileBytes += st.st_size; }
+  }
+
+  GameServerOptions options;
+  options.stateFile = opt.state.c_str();
+  ServerConfig config;
+  config.address = opt.address;
+  config.threads = opt.threads;
+  config.backend = opt.backend;
+  Server server;
+  Clock::time_point start = Clock::now();
+  if (!server.start(config, makeGameHandler, &options)) { perror("restart"); return 1; }
+  double startMs = chrono::duration<double, milli>(Clock::now() - start).count();
+  PoolStats restored = server.sessionStats();
+
+  // Check every game against a snapshot of it (OP_WATCH), in windows
+  // small enough that the server never has to drop a snapshot
+  fd = connectTo(opt.address);
+  long lost = 0, wrong = 0, inFlightMade = 0;
+  const int WATCH_WINDOW = 16;
+  for (int i = 0; i < opt.games; i += WATCH_WINDOW) {
+    int n = min(WATCH_WINDOW, opt.games - i);
+    reqs.clear();
+    for (int k = 0; k < n; k++) { reqs.push_back(WireRequest{OP_WATCH, 0, 0, 0, games[i + k].id}); }
+    sendAll(fd, reqs.data(), n * sizeof(WireRequest));
+    int replies = 0, events = 0;
+    while (replies < n || events < n) {
+      WireEvent ev;
+      if (!readAll(fd, &ev, sizeof(WireReply))) { perror("watch"); return 1; }
+      if (ev.op != OP_EVENT) {
+        replies++;
+        continue;
+      }
+      readAll(fd, reinterpret_cast<char*>(&ev) + sizeof(WireReply), sizeof(ev) - sizeof(WireReply));
+      if (ev.flags & EVENT_CLOSED) { events++; lost++; continue; }
+      if (ev.cell != NO_CELL) { continue; }   // a move of a game already checked
+      events++;
+      int k = 0;
+      while (k < n - 1 && games[i + k].id != ev.session) { k++; }
+      const ClientGame& g = games[i + k];
+      uint16_t user = 0, computer = 0;
+      for (int c = 0; c < 9; c++) {
+        unsigned owner = (ev.board >> (2 * c)) & 3;
+        user |= (owner == 1) << c;
+        computer |= (owner == 2) << c;
+      }
+      uint16_t extraUser = user & ~g.user, extraComputer = computer & ~g.computer;
+      bool kept = (user & g.user) == g.user && (computer & g.computer) == g.computer;
+      bool made = g.pending >= 0 && extraUser == (1 << g.pending) && __builtin_popcount(extraComputer) <= 1;
+      if (!kept || ((extraUser || extraComputer) && !made)) { wrong++; }
+      inFlightMade += made;
+    }
+  }
+  // Stop watching, then make one more move in every unfinished game
+  close(fd);
+  fd = connectTo(opt.address);
+  long played = 0, refused = 0;
+  if (opt.threads == 1) {
+    reqs.clear();
+    for (ClientGame& g : games) {
+      if (g.status != IN_PROGRESS || g.pending >= 0) { continue; }
+      reqs.push_back(WireRequest{OP_MOVE, (uint8_t)randomEmpty(g), 0, 0, g.id});
+    }
+    if (!exchange(fd, reqs, reps)) { perror("carry on"); return 1; }
+    for (const WireReply& rep : reps) { (rep.result == RESULT_OK) ? played++ : refused++; }
+  }
+  close(fd);
+  server.stop();
+  unlink(opt.address.c_str() + 5);
+  for (int i = 0; i < opt.threads; i++) { unlink((opt.state + "." + to_string(i)).c_str()); }
+
+  printf("games:                %d (%zu moves in flight at the kill)\n", opt.games, inFlight);
+  printf("state file (bytes):   %lld\n", (long long)fileBytes);
+  printf("restart (ms):         %.2f\n", startMs);
+  printf("sessions restored:    %zu\n", restored.live);
+  printf("games lost:           %ld\n", lost);
+  printf("games wrong:          %ld\n", wrong);
+  printf("in-flight moves made: %ld\n", inFlightMade);
+  if (opt.threads == 1) { printf("carried on:           %ld played, %ld refused\n", played, refused); }
+  return (lost || wrong || refused) ? 1 : 0;
+}
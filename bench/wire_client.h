@@ -0,0 +1,85 @@
+#ifndef TICTACTOE_BENCH_WIRE_CLIENT_H
+#define TICTACTOE_BENCH_WIRE_CLIENT_H
+
+#include "game_server.h"
+#include <cerrno>
+#include <chrono>
+#include <cstddef>
+#include <cstring>
+#include <fstream>
+#include <string>
+#include <thread>
+#include <unistd.h>
+#include <vector>
+
+/**
+ * Client side of the game server's binary protocol (see game_server.h),
+ * shared by the benchmarks that drive a server over its sockets.
+ */
+
+/** Resident set size of this process in bytes. */
+inline long residentBytes() {
+  std::ifstream status("/proc/self/status");
+  std::string key;
+  while (status >> key) {
+    if (key == "VmRSS:") { long kb; status >> kb; return kb * 1024; }
+  }
+  return 0;
+}
+
+/** Write all of `data`, waiting out a full non-blocking socket. */
+inline bool sendAll(int fd, const void* data, size_t len) {
+  const char* p = static_cast<const char*>(data);
+  while (len > 0) {
+    ssize_t n = write(fd, p, len);
+    if (n < 0 && errno == EAGAIN) { std::this_thread::yield(); continue; }
+    if (n <= 0) { return false; }
+    p += n;
+    len -= n;
+  }
+  return true;
+}
+
+/** Read exactly `len` bytes; false if the connection ends first. */
+inline bool readAll(int fd, void* data, size_t len) {
+  char* p = static_cast<char*>(data);
+  while (len > 0) {
+    ssize_t n = read(fd, p, len);
+    if (n <= 0) { return false; }
+    p += n;
+    len -= n;
+  }
+  return true;
+}
+
+/** One request, one reply, on a blocking connection; a zeroed reply on failure. */
+inline WireReply call(int fd, const WireRequest& req) {
+  WireReply rep = {};
+  if (sendAll(fd, &req, sizeof(req))) { readAll(fd, &rep, sizeof(rep)); }
+  return rep;
+}
+
+/**
+ * Read `count` replies, calling `onReply(index, reply, now)` as each one
+ * arrives so that latencies reflect arrival rather than batch end.
+ */
+template <typename F>
+bool readReplies(int fd, size_t count, F onReply) {
+  static thread_local std::vector<char> buf;
+  buf.resize(count * sizeof(WireReply));
+  size_t have = 0, done = 0;
+  while (done < count) {
+    ssize_t n = read(fd, buf.data() + have, buf.size() - have);
+    if (n <= 0) { return false; }
+    have += n;
+    std::chrono::steady_clock::time_point now = std::chrono::steady_clock::now();
+    for (; (done + 1) * sizeof(WireReply) <= have; done++) {
+      WireReply rep;
+      memcpy(&rep, buf.data() + done * sizeof(WireReply), sizeof(rep));
+      onReply(done, rep, now);
+    }
+  }
+  return true;
+}
+
+#endif
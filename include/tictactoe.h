@@ -0,0 +1,107 @@
+#ifndef TICTACTOE_H
+#define TICTACTOE_H
+
+/**
+ * C interface to the tic-tac-toe engine.
+ *
+ * Cells are addressed by index 0..8 in row-major order, i.e. the cell
+ * in row `r` and column `c` (A=0, B=1, C=2) is `r * 3 + c`. Player,
+ * status and strategy values match the enums in the engine, so they
+ * can be compared directly against the TTT_* constants below.
+ *
+ * Functions returning int report failures as negative TTT_ERR_* codes.
+ */
+
+#include <stddef.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* Players / cell contents */
+#define TTT_EMPTY        0
+#define TTT_USER         7
+#define TTT_COMPUTER    11
+
+/* Game status */
+#define TTT_IN_PROGRESS  0
+#define TTT_USER_WON     7
+#define TTT_COMPUTER_WON 11
+#define TTT_DRAW        12
+
+/* Strategies */
+#define TTT_RANDOM       0
+#define TTT_SMART        1
+#define TTT_GENIOUS      2
+
+/* Errors */
+#define TTT_ERR_ARGUMENT  -1  /* bad handle, cell index or player */
+#define TTT_ERR_OCCUPIED  -2  /* the requested cell is not empty */
+#define TTT_ERR_GAME_OVER -3  /* the game has already finished */
+
+typedef struct ttt_game ttt_game;
+
+/**
+ * Create a new game with an empty board.
+ *
+ * @param  int strategy  Strategy used by `ttt_choose_move`
+ * @param  int first     Player to move first (TTT_USER or TTT_COMPUTER)
+ * @return ttt_game*     New game, or NULL on bad arguments / no memory
+ */
+ttt_game* ttt_game_create(int strategy, int first);
+
+/** Release a game created by `ttt_game_create`. NULL is ignored. */
+void ttt_game_destroy(ttt_game* game);
+
+/** Clear the board and set the player to move first. */
+int ttt_game_reset(ttt_game* game, int first);
+
+/** Change the strategy used by `ttt_choose_move`. */
+int ttt_set_strategy(ttt_game* game, int strategy);
+
+/**
+ * Claim `cell` for the player to move and pass the turn.
+ *
+ * @return int  The game status after the move, or a TTT_ERR_* code
+ */
+int ttt_apply_move(ttt_game* game, int cell);
+
+/**
+ * Pick a move for the player to move using the game's strategy. The
+ * board is left untouched.
+ *
+ * @return int  The chosen cell, or a TTT_ERR_* code
+ */
+int ttt_choose_move(ttt_game* game);
+
+/** Status of the game (TTT_IN_PROGRESS, TTT_USER_WON, ...). */
+int ttt_status(const ttt_game* game);
+
+/** Player to move next (TTT_USER or TTT_COMPUTER). */
+int ttt_to_move(const ttt_game* game);
+
+/** Contents of `cell` (TTT_EMPTY, TTT_USER or TTT_COMPUTER). */
+int ttt_cell(const ttt_game* game, int cell);
+
+/**
+ * Choose and apply a move in each of `count` games. Finished games are
+ * skipped. When `cells` is not NULL it receives the cell played in each
+ * game, or a TTT_ERR_* code for the games that could not move.
+ *
+ * @return size_t  Number of games in which a move was played
+ */
+size_t ttt_play_batch(ttt_game* const* games, size_t count, int* cells);
+
+/**
+ * Apply `cells[i]` to `games[i]` for each of `count` games. When
+ * `status` is not NULL it receives the result of each `ttt_apply_move`.
+ *
+ * @return size_t  Number of moves that were applied
+ */
+size_t ttt_apply_batch(ttt_game* const* games, size_t count, const int* cells, int* status);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -1,76 +1,259 @@
 #include <iostream>
+#include <chrono>
+#include <cstdio>
 #include <cstdlib>
 #include <ctime>
+#include <csignal>
+#include <cstring>
+#include <string>
+#include <thread>
+#include <fcntl.h>
+#include <sys/resource.h>
+#include "engine.h"
+#include "game_columns.h"
+#include "game_index.h"
+#include "game_record.h"
+#include "game_server.h"
+#include "game_task.h"
+#include "game_verify.h"
+#include "http_server.h"
+#include "latency.h"
+#include "move_table.h"
+#include "perft.h"
+#include "protocol.h"
+#include "result_writer.h"
+#include "server.h"
+#include "shm_engine.h"
+#include "trace.h"
 using namespace std;
 
 /**
- * Enumerate the possible players in the game. Each is given
- * a unique prime integer so that the math involved with determining
- * available winning moves on the board is made easier.
+ * Serve network clients until interrupted (SIGINT or SIGTERM). See
+ * game_server.h and http_server.h for the protocols. With a `tables`
+ * file, the move tables are loaded from it at startup and again on every
+ * SIGHUP, while the server keeps running (see move_table.h).
  *
- * See the `ai_*` functions and the `drawBoard` for relevant logic
+ * @param  HandlerFactory factory  Creates the protocol handler of each reactor
+ * @param  string         address  Where to listen, ex: tcp:127.0.0.1:7777
+ * @param  int            threads  Number of reactor threads
+ * @param  int            backend  BACKEND_EPOLL or BACKEND_URING
+ * @param  void*          context  Passed to `factory`
+ * @param  char*          tables   Move table file, or nullptr
+ * @return int                     Process exit code
  */
-enum {EMPTY=0, USER=7, COMPUTER=11};
+int serve(HandlerFactory factory, const string& address, int threads, int backend, void* context,
+          const char* tables) {
+  // Block the signals in every thread; this one collects them below
+  sigset_t signals;
+  sigemptyset(&signals);
+  sigaddset(&signals, SIGINT);
+  sigaddset(&signals, SIGTERM);
+  sigaddset(&signals, SIGHUP);
+  pthread_sigmask(SIG_BLOCK, &signals, nullptr);
+
+  if (tables && !loadMoveTables(tables)) {
+    cerr << "Unable to load move tables from " << tables << ": " << strerror(errno) << endl;
+    return 1;
+  }
+
+  ServerConfig config;
+  config.address = address;
+  config.threads = threads;
+  config.backend = backend;
+  Server server;
+  if (!server.start(config, factory, context)) {
+    cerr << "Unable to serve on " << address << ": " << strerror(errno) << endl;
+    return 1;
+  }
+  cerr << "Serving on " << address << " with " << threads << " thread(s)" << endl;
+  // Reloads run on this thread: lower its priority so they don't take the
+  // CPU from the reactors. Linux keeps a nice value per thread, and the
+  // reactors, started above, stay at theirs
+  setpriority(PRIO_PROCESS, 0, 19);
+
+  int received;
+  while (sigwait(&signals, &received) == 0 && received == SIGHUP) {
+    if (!tables) { continue; }
+    if (!loadMoveTables(tables)) {
+      cerr << "Kept the move tables in use, " << tables << " is unusable: " << strerror(errno) << endl;
+      continue;
+    }
+    // The old tables go once every reactor has finished its batch; the
+    // reactors never wait for this thread
+    for (int i = 0; i < 1000 && reclaimMoveTables() > 0; i++) {
+      this_thread::sleep_for(chrono::milliseconds(1));
+    }
+    cerr << "Reloaded the move tables from " << tables << endl;
+  }
+  server.stop();
+  return 0;
+}
 
 /**
- * Enumerate possible states the game can be in. The game is either
- *  IN_PROGRESS  - neither player has won, and there are still valid moves
- *  USER_WON     - user won by matching three in a row
- *  COMPUTER_WON - computer won by matching three in a row
- *  DRAW         - neither player has won, but there are no valid moves left
+ * Print how the games through a position ended, from a game index (see
+ * game_index.h), and the first few of them if their record file is
+ * given.
  *
- * See the function `isGameOver` for related logic
+ * @param  char* indexPath  Index built by --index-games
+ * @param  char* board      9 cells, row by row: x for the user, o for the
+ *                          computer, . for empty
+ * @param  char* gamesPath  Record file the index was built from, or nullptr
+ * @return int              Process exit code
  */
-enum {IN_PROGRESS=0, USER_WON=USER, COMPUTER_WON=COMPUTER, DRAW};
+int queryGames(const char* indexPath, const char* board, const char* gamesPath) {
+  unsigned user = 0, computer = 0;
+  for (int i = 0; i < 9; i++) {
+    switch (board[i]) {
+      case 'x': case 'X': user |= 1u << i; break;
+      case 'o': case 'O': computer |= 1u << i; break;
+      case '.': case '-': case '_': break;
+      default: cerr << "Board must be 9 cells of x, o or ." << endl; return 1;
+    }
+  }
+  if (strlen(board) != 9) {
+    cerr << "Board must be 9 cells of x, o or ." << endl;
+    return 1;
+  }
+
+  GameIndex index;
+  if (!index.open(indexPath)) {
+    cerr << "Unable to open " << indexPath << ": " << strerror(errno) << endl;
+    return 1;
+  }
+  const PositionEntry& entry = index.position(user, computer);
+  cout << "games:         " << entry.games << " of " << index.games() << endl;
+  cout << "user won:      " << entry.results[resultCode(USER_WON)] << endl;
+  cout << "computer won:  " << entry.results[resultCode(COMPUTER_WON)] << endl;
+  cout << "draw:          " << entry.results[resultCode(DRAW)] << endl;
+  cout << "unfinished:    " << entry.results[resultCode(IN_PROGRESS)] << endl;
+  if (!gamesPath) { return 0; }
+
+  // Compressed record files are read with the built-in tables
+  MoveTables* tables = buildMoveTables();
+  GameReader games;
+  if (!games.open(gamesPath, tables)) {
+    cerr << "Unable to open " << gamesPath << ": " << strerror(errno) << endl;
+    delete tables;
+    return 1;
+  }
+  int shown = 0;
+  index.forEachGame(user, computer, [&](uint64_t id) {
+    GameRecord game;
+    if (shown++ >= 10 || !games.game(id, game)) { return; }
+    cout << "game " << id << ":";
+    for (int i = 0; i < game.moveCount; i++) { cout << " " << char('A' + game.moves[i] % 3) << game.moves[i] / 3; }
+    cout << endl;
+  });
+  delete tables;
+  return 0;
+}
 
 /**
- * Enumerate possible strategies the computer might employ to try to
- * win the game. Available strategies are:
- *   0 RANDOM       - Randomly pick one of the available cells
- *   1 SMART        - Prefer strategic locations if available
- *   2 GENIOUS      - Defend and attack in all situations
+ * Print the games of a column file (see game_columns.h) by result,
+ * grouped by up to two columns.
  *
- * GENIOUS is the default strategy used if no other is requested. See the
- * function `nextComputerMove` for relevant logic
+ * @param  char* path     Column file built by --columnize-games
+ * @param  char* groupBy  Column names separated by a comma, ex: user,computer
+ * @param  int   threads  Threads to scan with
+ * @return int            Process exit code
  */
-enum {RANDOM, SMART, GENIOUS};
+int groupGames(const char* path, const char* groupBy, int threads) {
+  static const char* NAMES[COLUMN_COUNT] = {"result", "length", "user", "computer", "first",
+                                            "move0", "move1", "move2", "move3"};
+  GroupQuery query;
+  string spec = groupBy;
+  for (int g = 0; g < 2 && !spec.empty(); g++) {
+    size_t comma = spec.find(',');
+    string name = spec.substr(0, comma);
+    spec = (comma == string::npos) ? "" : spec.substr(comma + 1);
+    for (int c = 0; c < COLUMN_COUNT; c++) {
+      if (name == NAMES[c]) { query.groupBy[g] = c; }
+    }
+    if (query.groupBy[g] < 0) {
+      cerr << "Unknown column " << name << endl;
+      return 1;
+    }
+  }
+
+  GameColumns columns;
+  GroupCounts counts;
+  if (!columns.open(path) || !columns.query(query, counts, threads)) {
+    cerr << "Unable to query " << path << ": " << strerror(errno) << endl;
+    return 1;
+  }
+  cout << "group      games     user won  computer won  draw" << endl;
+  for (int key = 0; key < 256; key++) {
+    const uint64_t* c = counts.games[key];
+    uint64_t games = c[0] + c[1] + c[2] + c[3];
+    if (!games) { continue; }
+    string group = to_string(key >> 4);
+    if (query.groupBy[1] >= 0) { group += ',' + to_string(key & 0xF); }
+    printf("%-8s %10llu %10.1f%% %12.1f%% %5.1f%%\n", group.c_str(), (unsigned long long)games,
+           100.0 * c[resultCode(USER_WON)] / games, 100.0 * c[resultCode(COMPUTER_WON)] / games,
+           100.0 * c[resultCode(DRAW)] / games);
+  }
+  return 0;
+}
 
 /**
- * Container to represent a single cell on the board. This makes
- * it possible to use a board location as the return value of a
- * function ex: `playerCanWin`.
+ * Play `games` games between the strategies without anyone at the
+ * keyboard, cycling through every pairing and first mover, and stream
+ * their results to stdout (see result_writer.h).
+ *
+ * @param  long  games   Number of games
+ * @param  char* format  "ndjson" or "csv"
+ * @param  long  batch   Games per summary line, 0 for a line per game
+ * @return int           Process exit code
  */
-struct Cell {
-  Cell(int r, int c): row(r), col(c) {};
-  int row;
-  int col;
-};
+int simulate(long games, const char* format, long batch) {
+  MoveTables* tables = buildMoveTables();
+  ResultWriter writer(1, string(format) == "csv" ? OUTPUT_CSV : OUTPUT_NDJSON, batch > 0 ? batch : 0);
+  bool ok = true;
+  for (long i = 0; ok && i < games; i++) {
+    GameRecord game = {};
+    game.seed             = i;
+    game.userStrategy     = i % 3;
+    game.computerStrategy = (i / 3) % 3;
+    game.first            = (i / 9) % 2 ? COMPUTER : USER;
+    simulateGame(game, *tables);
+    ok = writer.write(game);
+  }
+  ok = writer.finish() && ok;
+  delete tables;
+  if (!ok) { cerr << "Unable to write the results: " << strerror(errno) << endl; }
+  return ok ? 0 : 1;
+}
 
 /**
- * Draw a 3x3 tic-tac-toe board with row and column labels
- * The cell data in board will be interpreted as follows:
- *   1 = owned by 'x'
- *   2 = owned by 'o'
- *   all other values = empty
+ * Count the move sequences from the empty board to every depth up to
+ * `depth`, as a check of the rules and a measure of their speed (see
+ * perft.h). At depth 9 the totals must be the known ones.
  *
- * @param  int[3][3] board The current state of each board cell
- * @return void
+ * @param  int   depth    Deepest count
+ * @param  int   threads  Threads to count with
+ * @param  bool  hashed   Add up repeated subtrees from a table
+ * @return int            Process exit code
  */
-void drawBoard(int board[][3]) {
-  cout << "  " << "  A   B   C  " << endl;
-  cout << "  " << "+---+---+---+" << endl;
-  for (int row = 0; row < 3; row++) {
-    cout << row << " ";
-    for (int col = 0; col < 3; col++) {
-      switch (board[row][col]) {
-        case USER:     cout << "| " << 'x' << " "; break;
-        case COMPUTER: cout << "| " << 'o' << " "; break;
-        default:       cout << "| " << ' ' << " "; break;
-      }
-    }
-    cout << "|" << endl;
-    cout << " " << " " << "+---+---+---+" << endl;
+int runPerft(int depth, int threads, bool hashed) {
+  printf("%5s %10s %10s %10s %12s %8s %10s %12s\n", "depth", "leaves", "games", "user_won", "computer_won", "draw",
+         "nodes", "nodes/s");
+  PerftCounts counts = {};
+  for (int d = 0; d <= depth; d++) {
+    chrono::steady_clock::time_point start = chrono::steady_clock::now();
+    counts = perft(0, 0, USER, d, threads, hashed);
+    double seconds = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+    printf("%5d %10llu %10llu %10llu %12llu %8llu %10llu %12.0f\n", d, (unsigned long long)counts.leaves,
+           (unsigned long long)counts.games, (unsigned long long)counts.results[resultCode(USER_WON)],
+           (unsigned long long)counts.results[resultCode(COMPUTER_WON)],
+           (unsigned long long)counts.results[resultCode(DRAW)], (unsigned long long)counts.nodes,
+           counts.nodes / (seconds > 0 ? seconds : 1e-9));
   }
+  if (depth < 9) { return 0; }
+  // Known totals, with the user moving first
+  bool ok = counts.games == 255168 && counts.results[resultCode(USER_WON)] == 131184
+         && counts.results[resultCode(COMPUTER_WON)] == 77904 && counts.results[resultCode(DRAW)] == 46080;
+  printf("%s\n", ok ? "totals match" : "totals DIFFER from 255168 games (131184 / 77904 / 46080)");
+  return ok ? 0 : 1;
 }
 
 /**
@@ -79,12 +262,12 @@ void drawBoard(int board[][3]) {
  *   - column value is within bounds [A, B, C]
  *   - row value is within bounds    [0, 1, 2]
  *   - the selected cell is empty    board[row][col] == 0
- * Once input has been validated, update the board.
+ * Once input has been validated, return the chosen cell.
  *
  * @param  int[3][3] board  The current state of the board
- * @return void
+ * @return cell             The cell the user wants to claim
  */
-void nextPlayerMove(int board[][3]) {
+Cell nextPlayerMove(int board[][3]) {
   bool row_valid;
   bool col_valid;
   char col_c;             // container for the character value of the column
@@ -124,305 +307,181 @@ void nextPlayerMove(int board[][3]) {
     }
   } while (!col_valid || !row_valid);
 
-  // Update the board with the user's latest choice
-  board[row][col] = USER;
+  return Cell(row, col);
 }
 
 /**
- * AI strategy based on randomly picking available cells
- *
- * @param  int[3][3]  board  The current state of the board
- * @return void
- **/
-void ai_random(int board[][3]) {
-  int row, col;
-  do {
-    row = rand() % 3;  // Choose a random row
-    col = rand() % 3;  // Choose a random column
-  } while (board[row][col] != EMPTY); // If taken, try again
-
-  // Update the board state
-  board[row][col] = COMPUTER;
-}
-
-/**
- * AI strategy based on preferring strategic cells if they
- * are available. Defaults to randomly picking a cell if they
- * are not.
- *
- * @param  int[3][3] board  The current state of the board
- * @return void
+ * The person at the keyboard, as a player for `playGame`. Reading the
+ * move blocks, which is what we want for the single interactive game.
  */
-void ai_smart(int board[][3]) {
-  int row, col;
-
-  // Prefer B1 if it is available
-  if (board[1][1] == EMPTY) { row = 1; col = 1; }
-  else {
-    // Prefer corners if they are available
-    if (board[0][0] == EMPTY)      { row = 0; col = 0; }
-    else if (board[0][2] == EMPTY) { row = 0; col = 2; }
-    else if (board[2][0] == EMPTY) { row = 2; col = 0; }
-    else if (board[2][2] == EMPTY) { row = 2; col = 2; }
-    else {
-      // Resort to random available location
-      ai_random(board);
-      row = -1;
-      col = -1; // set to prevent later logic
+struct ConsolePlayer {
+  struct Move {
+    int (*board)[3];
+    bool await_ready() const { return true; }
+    void await_suspend(coroutine_handle<>) {}
+    int await_resume() const {
+      LatencyTimer timer(LATENCY_USER_MOVE);
+      Cell c = nextPlayerMove(board);
+      return c.row * 3 + c.col;
     }
-  }
+  };
 
-  if (row >= 0 && col >= 0) {
-    board[row][col] = COMPUTER;
+  Move nextMove(int board[][3], int player) {
+    (void)player;
+    return Move{board};
   }
-}
+};
 
-/**
- * Determine whether a user could win by claiming
- * one more cell along any of the possible winning
- * axes.
- * There are 8 possible winning axes. The user can
- * win if the sum of the cells on that axis is currently
- * 2 and if one of the cells is empty (=0).
- *
- * @param  int[3][3] board  The current state of the board
- * @param  int       which  Which player (USER or COMPUTER)
- * @return cell  The location of the cell the user could win with
- */
-Cell playerCanWin(int board[][3], int which) {
-  // Target sum depends on which player we're calculating for
-  int target = which * 2;
-  // Iterate through the 8 possible winning axes:
-  // Rows:
-  for (int r = 0; r < 3; r++) {
-    int sum  = board[r][0] + board[r][1] + board[r][2];
-    if (sum == target ) {
-      for (int c = 0; c < 3; c++) {
-        if (board[r][c] == EMPTY) { return Cell(r,c); }
-      }
+
+
+
+int main (int argc, char* argv[])
+{
+  // Record latency histograms in whatever mode follows, and dump them to
+  // a file ("-" for stderr) on exit and on SIGUSR1; see latency.h
+  if (argc > 2 && string(argv[1]) == "--latency") {
+    int fd = (string(argv[2]) == "-") ? 2 : open(argv[2], O_WRONLY | O_CREAT | O_APPEND | O_CLOEXEC, 0644);
+    if (fd < 0) {
+      cerr << "Unable to open " << argv[2] << ": " << strerror(errno) << endl;
+      return 1;
     }
+    startLatencyDumps(fd);
+    argv[2] = argv[0];
+    argv += 2;
+    argc -= 2;
   }
 
-  // Columns:
-  for (int c = 0; c < 3; c++) {
-    int sum  = board[0][c] + board[1][c] + board[2][c];
-    if (sum == target) {
-      for (int r = 0; r < 3; r++) {
-        if (board[r][c] == EMPTY) { return Cell(r,c); }
-      }
+  // Write a Chrome trace of whatever mode follows to a file at exit, in
+  // a build with tracing compiled in; see trace.h
+  if (argc > 2 && string(argv[1]) == "--trace") {
+    if (!TRACE_ENABLED) {
+      cerr << "Tracing is not compiled in; configure with -DTTT_TRACE=ON" << endl;
+      return 1;
     }
+    writeTraceAtExit(argv[2]);
+    argv[2] = argv[0];
+    argv += 2;
+    argc -= 2;
   }
 
-  // Diagonals:
-  int sum_ltr = board[0][0] + board[1][1] + board[2][2];
-  if (sum_ltr == target) {
-    if (board[0][0] == EMPTY) { return Cell(0,0); }
-    if (board[1][1] == EMPTY) { return Cell(1,1); }
-    if (board[2][2] == EMPTY) { return Cell(2,2); }
+  // Run as an engine driven by another program instead of a person.
+  // See protocol.h for the commands understood in this mode.
+  if (argc > 1 && string(argv[1]) == "--engine") {
+    return runEngineProtocol(0, 1);
   }
-  int sum_rtl = board[0][2] + board[1][1] + board[2][0];
-  if (sum_rtl == target) {
-    if (board[0][2] == EMPTY) { return Cell(0,2); }
-    if (board[1][1] == EMPTY) { return Cell(1,1); }
-    if (board[2][0] == EMPTY) { return Cell(2,0); }
-  }
-  // No possible win
-  return Cell(-1,-1);
-}
 
-Cell userCanWin(int board[][3]) {
-  return playerCanWin(board, USER);
-}
-
-Cell computerCanWin(int board[][3]) {
-  return playerCanWin(board, COMPUTER);
-}
+  // Same, but reached through shared memory; see shm_engine.h
+  if (argc > 2 && string(argv[1]) == "--shm") {
+    return runShmEngine(argv[2]);
+  }
 
-void ai_genious(int board[][3]) {
-
-  // Prefer B1 if it is available
-  if (board[1][1] == EMPTY) {
-    board[1][1] = COMPUTER;
-  } else {
-    // Determine if there's any way for the computer
-    // to win on this turn
-    Cell c = computerCanWin(board);
-
-    // If the computer can win, then make it happen:
-    if (c.row >= 0 && c.col >= 0) {
-      board[c.row][c.col] = COMPUTER; // computer is always 'o'
-    } else {
-      // Otherwise, determine whether there's any way for
-      // the user to win on their next turn
-      Cell c = userCanWin(board);
-
-      // If the user can win on the next turn, attempt to
-      // block that action now:
-      if (c.row >= 0 && c.col >= 0) {
-        board[c.row][c.col] = COMPUTER; // computer is always 'o'
-      } else {
-        // Otherwise, try to pick a strategic location
-        ai_smart(board);
-      }
-    }
+  // Write the built-in move tables to a file, to edit or replace and
+  // then hand to --serve
+  if (argc > 2 && string(argv[1]) == "--save-tables") {
+    MoveTables* tables = buildMoveTables();
+    bool saved = saveMoveTables(argv[2], *tables);
+    delete tables;
+    if (!saved) { cerr << "Unable to write " << argv[2] << ": " << strerror(errno) << endl; }
+    return saved ? 0 : 1;
   }
-}
 
+  // Build a position index of a game record file, and query it; see
+  // game_index.h
+  if (argc > 3 && string(argv[1]) == "--index-games") {
+    MoveTables* tables = buildMoveTables();
+    GameReader games;
+    bool ok = games.open(argv[2], tables) &&
+              buildGameIndex(games, argv[3], (argc > 4) ? atoi(argv[4]) : (int)thread::hardware_concurrency());
+    delete tables;
+    if (!ok) { cerr << "Unable to index " << argv[2] << " into " << argv[3] << ": " << strerror(errno) << endl; }
+    return ok ? 0 : 1;
+  }
+  if (argc > 3 && string(argv[1]) == "--query-games") {
+    return queryGames(argv[2], argv[3], (argc > 4) ? argv[4] : nullptr);
+  }
 
-/**
- * Determine the next move the computer should make. For now
- * the strategy will be simple: randomly pick an available
- * cell.
- * Once a cell has been picked, update the board
- *
- * @param  int[3][3] board   The current state of the board
- * @param  int    strategy   The strategy to use
- * @return void
- */
-void nextComputerMove(int board[][3], int strategy) {
-  switch (strategy) {
-    case SMART:
-      ai_smart(board);
-      break;
-    case GENIOUS:
-      ai_genious(board);
-      break;
-    case RANDOM:
-    default:
-      ai_random(board);
-      break;
+  // Play games with no one at the keyboard, for bulk runs, and stream
+  // their results as NDJSON or CSV
+  if (argc > 2 && string(argv[1]) == "--simulate") {
+    return simulate(atol(argv[2]), (argc > 3) ? argv[3] : "ndjson", (argc > 4) ? atol(argv[4]) : 0);
   }
-}
 
-/**
- * Determine the status of the game given the current state
- * of the board. The status can be one of 4 values:
- *   0 - valid: no one has won yet, and there are valid moves remaining
- *   1 - invalid, user has won
- *   2 - invalid, computer has won
- *   3 - invalid, draw - no one has won but there are no valid moves remaining
- *
- * @param  int[3][3] board   The current state of the board
- * @return int               The status of the board in its current state
- */
-int isGameOver (int board[][3]) {
-
-  // Strategy: examine the "middle" square for each axis. There are only a
-  //           limited number of these squares on the board. Specifically:
-  //     A   B   C
-  //   +---+---+---+
-  // 0 |   | x |   |
-  //   +---+---+---+
-  // 1 | x | x | x |
-  //   +---+---+---+
-  // 2 |   | x |   |
-  //   +---+---+---+
-  // If a given user owns one of these middle squares, and also owns two
-  // neighbors along the same axis, then that user has won. Each "middle
-  // square" has only one axis to check, except B1, which has four axes.
-  // In other words you have won if you own:
-  //   B0  (and A0 and C0)
-  //   A1  (and A0 and A2)
-  //   B2  (and A2 and C2)
-  //   C1  (and C0 and C2)
-  //   B1  (and B0 and B2), (and A1 and C1), (and A0 and C2), (and A2 and C0)
-
-  // Check each player sequentially:
-  for (int player = USER; player <= COMPUTER; player += (COMPUTER - USER)) {
-
-    // Determine if the current player won
-    if ((board[0][1] == player && board[0][0] == player && board[0][2] == player)
-    	||(board[1][0] == player && board[0][0] == player && board[2][0] == player)
-    	||(board[2][1] == player && board[2][0] == player && board[2][2] == player)
-    	||(board[1][2] == player && board[0][2] == player && board[2][2] == player)
-    	||(board[1][1] == player && (
-  	   (board[0][1] == player && board[2][1] == player)
-  	   ||(board[1][0] == player && board[1][2] == player)
-  	   ||(board[0][0] == player && board[2][2] == player)
-  	   ||(board[2][0] == player && board[0][2] == player))
-	    )
-	  ){
-      return player;
-    }
+  // Count the game tree; see perft.h
+  if (argc > 2 && string(argv[1]) == "--perft") {
+    int threads = (argc > 3) ? atoi(argv[3]) : 1;
+    bool hashed = (argc > 4) && string(argv[4]) == "hash";
+    return runPerft(atoi(argv[2]), threads, hashed);
   }
 
-  // Determine if there are no further moves available
-  bool moreMoves = false;
-  for (int col = 0; col < 3; col++) {
-    for (int row = 0; row < 3; row++) {
-      if (board[row][col] == EMPTY) { moreMoves = true; }
+  // Check that every game of a record file is legal and has the right
+  // result; see game_verify.h
+  if (argc > 2 && string(argv[1]) == "--verify-games") {
+    int threads = (argc > 3) ? atoi(argv[3]) : (int)thread::hardware_concurrency();
+    size_t keep = (argc > 4) ? atol(argv[4]) : 1000;
+    MoveTables* tables = buildMoveTables();
+    GameReader games;
+    if (!games.open(argv[2], tables)) {
+      cerr << "Unable to open " << argv[2] << ": " << strerror(errno) << endl;
+      delete tables;
+      return 1;
+    }
+    VerifyReport report = verifyGames(games, threads, keep);
+    delete tables;
+    for (const BadGame& bad : report.first) {
+      cout << "game " << bad.id << ": ply " << bad.result.ply << ": " << verifyErrorName(bad.result.error) << endl;
     }
+    if (report.bad > report.first.size()) { cout << "... and " << report.bad - report.first.size() << " more" << endl; }
+    cout << report.games << " games, " << report.bad << " bad" << (report.damaged ? ", damaged blocks" : "") << endl;
+    return (report.bad || report.damaged) ? 1 : 0;
   }
 
-  if (moreMoves) {
-    return IN_PROGRESS;// game still valid;
-  } else {
-    return DRAW;       // game over without a winner
+  // Lay a game record file out in columns, and aggregate over them; see
+  // game_columns.h
+  if (argc > 3 && string(argv[1]) == "--columnize-games") {
+    MoveTables* tables = buildMoveTables();
+    GameReader games;
+    bool ok = games.open(argv[2], tables) &&
+              writeGameColumns(games, argv[3], (argc > 4) ? atoi(argv[4]) : (int)thread::hardware_concurrency());
+    delete tables;
+    if (!ok) { cerr << "Unable to write the columns of " << argv[2] << ": " << strerror(errno) << endl; }
+    return ok ? 0 : 1;
+  }
+  if (argc > 3 && string(argv[1]) == "--group-games") {
+    return groupGames(argv[2], argv[3], (argc > 4) ? atoi(argv[4]) : (int)thread::hardware_concurrency());
   }
-}
-
-
-
-int main (int argc, char* argv[])
-{
-  // State variables
-  //
-  // Board:
-  //     0   1   2
-  //   +---+---+---+
-  // 0 |   |   | x | x = board[0][2]
-  //   +---+---+---+
-  // 1 |   |   |   |
-  //   +---+---+---+
-  // 2 |   |   |   |
-  //   +---+---+---+
-  //
-  // Each board square will be in one of three possible
-  // states:  0=empty, 1=owned by 'x', 2=owned by 'o'.
-  int board[3][3] = {};
-
-  // Variable to hold the current status of the game. See the
-  // enum declaration at the top of this file for the possible
-  // values of status.
-  int gameStatus = IN_PROGRESS;
-
-  // Flag to determine whose turn it is
-  // false: it is the computer's turn to make a move
-  // true:  it is the player's turn to make a move
-  bool playerTurn = true;
 
+  // Host many games at once (--serve), or answer one-off move queries
+  // over HTTP (--http), for network clients. A fifth argument to --serve
+  // names the state file that lets games survive a restart ("-" for
+  // none), a sixth the move table file to load, and reload on SIGHUP.
+  if (argc > 2 && (string(argv[1]) == "--serve" || string(argv[1]) == "--http")) {
+    bool http = (string(argv[1]) == "--http");
+    int threads = (argc > 3) ? atoi(argv[3]) : (int)thread::hardware_concurrency();
+    int backend = (argc > 4 && string(argv[4]) == "uring") ? BACKEND_URING : BACKEND_EPOLL;
+    GameServerOptions options;
+    if (argc > 5 && !http && string(argv[5]) != "-") { options.stateFile = argv[5]; }
+    const char* tables = (argc > 6 && !http) ? argv[6] : nullptr;
+    return serve(http ? makeHttpHandler : makeGameHandler, argv[2], threads > 0 ? threads : 1, backend,
+                 http ? nullptr : &options, tables);
+  }
 
   /* Game Flow */
 
   // 1. determine who goes first
-  playerTurn = rand() % 2; // coin flip
-
-  // 2. Enter the main game "loop"
-  while (gameStatus == IN_PROGRESS) {
-    // a. draw the board
-    drawBoard(board);
-
-    // b. current player makes a move
-    //    the logic here depends on whether or not the
-    //    computer or the player is the current player
-    if (playerTurn) {
-      // Some function for asking the user what the
-      // next move should be...
-      nextPlayerMove(board);
-
-    } else {
-      // Some function for determining what the next
-      // move should be...
-      nextComputerMove(board, GENIOUS);
-    }
-
-    // c. Check the current status of the game to determine
-    //    if the game can continue...
-    gameStatus = isGameOver(board);
-
-    // d. swap current player
-    playerTurn = (playerTurn) ? false : true;
-  }
+  int first = (rand() % 2) ? USER : COMPUTER; // coin flip
+
+  // 2. Play the game. The flow (draw the board, current player makes a
+  //    move, check the status, swap players) lives in `playGame`; here
+  //    we only pick the players and draw the board before every turn.
+  ConsolePlayer  user;
+  ComputerPlayer computer(GENIOUS);
+  task<Outcome> game = playGame(user, computer, first, [](int board[][3], int) { drawBoard(board); });
+  game.start();
+
+  // Neither player ever suspends the game, so it has finished by now
+  Outcome outcome = game.result();
+  int (*board)[3] = outcome.board;
+  int gameStatus  = outcome.status;
 
   // 3. print final game result message
   cout << "Game over! Here's what the final board looked like:" << endl;
@@ -0,0 +1,133 @@
+#ifndef TICTACTOE_BITBOARD_H
+#define TICTACTOE_BITBOARD_H
+
+#include "engine.h"
+#include <cstdint>
+
+/**
+ * Bitboard form of the rules, for code that checks many positions in a
+ * row. A board is two 9-bit masks, one per player, where bit `row * 3 +
+ * col` is set if the player owns that cell. The checks are small table
+ * lookups rather than loops over the axes.
+ */
+
+/** The 8 winning axes as cell masks. */
+constexpr uint16_t LINES[8] = {
+  0007, 0070, 0700,   // rows
+  0111, 0222, 0444,   // columns
+  0421, 0124          // diagonals
+};
+
+constexpr uint16_t FULL_BOARD = 0777;
+
+/** Tables indexed by a 9-bit cell mask, built at compile time. */
+struct MaskTables {
+  uint8_t  hasLine[512];      // 1 if the mask contains a complete axis
+  uint16_t ternary[512];      // sum of 3^i over the set bits i
+  uint16_t symmetry[8][512];  // the mask under the 8 rotations and reflections
+  uint8_t  pairLines[512];    // bit i set if the mask holds two cells of LINES[i]
+  uint8_t  touchLines[512];   // bit i set if the mask holds any cell of LINES[i]
+
+  constexpr MaskTables(): hasLine(), ternary(), symmetry(), pairLines(), touchLines() {
+    for (int mask = 0; mask < 512; mask++) {
+      for (int t = 0; t < 8; t++) {
+        for (int cell = 0; cell < 9; cell++) {
+          if (!(mask & (1 << cell))) { continue; }
+          // Reflect in the vertical axis for t >= 4, then rotate a
+          // quarter turn t % 4 times
+          int row = cell / 3, col = (t >= 4) ? 2 - cell % 3 : cell % 3;
+          for (int turn = 0; turn < t % 4; turn++) {
+            int was = row;
+            row = col;
+            col = 2 - was;
+          }
+          symmetry[t][mask] |= 1 << (row * 3 + col);
+        }
+      }
+      for (int i = 0; i < 8; i++) {
+        int held = mask & LINES[i];
+        if (held == LINES[i]) { hasLine[mask] = 1; }
+        int cells = 0;
+        for (int cell = 0; cell < 9; cell++) { cells += (held >> cell) & 1; }
+        if (cells == 2) { pairLines[mask] |= 1 << i; }
+        if (cells > 0) { touchLines[mask] |= 1 << i; }
+      }
+      int power = 1;
+      for (int i = 0; i < 9; i++, power *= 3) {
+        if (mask & (1 << i)) { ternary[mask] += power; }
+      }
+    }
+  }
+};
+
+inline constexpr MaskTables MASKS{};
+
+/** Game status (IN_PROGRESS, USER_WON, ...) of a bitboard position. */
+inline int bitboardStatus(unsigned user, unsigned computer) {
+  // Only one side can own a line in a legal position
+  unsigned userWon = MASKS.hasLine[user];
+  unsigned computerWon = MASKS.hasLine[computer];
+  unsigned full = ((user | computer) == FULL_BOARD);
+  return userWon     ? USER_WON
+       : computerWon ? COMPUTER_WON
+       : full        ? DRAW
+       :               IN_PROGRESS;
+}
+
+/**
+ * The cell that completes a line for the owner of `own`, the one
+ * `playerCanWin` finds (the first such line of LINES, its first empty
+ * cell), or -1 if there is none.
+ */
+inline int bitboardWinningCell(unsigned own, unsigned other) {
+  unsigned lines = MASKS.pairLines[own] & ~MASKS.touchLines[other];
+  return lines ? __builtin_ctz(LINES[__builtin_ctz(lines)] & ~own) : -1;
+}
+
+/**
+ * The `n % k`-th of the k cells not in `taken`, in cell order, of which
+ * there must be at least one: a uniform pick for a uniform `n`.
+ */
+inline int bitboardEmptyCell(unsigned taken, uint32_t n) {
+  unsigned empty = FULL_BOARD & ~taken;
+  for (unsigned skip = n % __builtin_popcount(empty); skip > 0; skip--) { empty &= empty - 1; }
+  return __builtin_ctz(empty);
+}
+
+/**
+ * xorshift64*, seeded so that seed 0 is as good as any other. Cheap
+ * random choices for code that owns its sequence, ex: one per game or
+ * per thread, instead of sharing the state of `rand()`.
+ */
+struct SeededRandom {
+  uint64_t state;
+
+  explicit SeededRandom(uint32_t seed): state(seed * 0x9E3779B97F4A7C15ull + 0x2545F4914F6CDD1Dull) {}
+
+  uint32_t next() {
+    state ^= state >> 12;
+    state ^= state << 25;
+    state ^= state >> 27;
+    return (state * 0x2545F4914F6CDD1Dull) >> 32;
+  }
+};
+
+/** The `encodeBoard` position code of a bitboard position. */
+inline int bitboardCode(unsigned user, unsigned computer) {
+  return MASKS.ternary[user] + 2 * MASKS.ternary[computer];
+}
+
+/**
+ * The smallest position code among the 8 rotations and reflections of a
+ * position, the same for every position that plays the same.
+ */
+inline int canonicalCode(unsigned user, unsigned computer) {
+  int best = bitboardCode(user, computer);
+  for (int t = 1; t < 8; t++) {
+    int code = bitboardCode(MASKS.symmetry[t][user], MASKS.symmetry[t][computer]);
+    best = (code < best) ? code : best;
+  }
+  return best;
+}
+
+#endif
@@ -0,0 +1,366 @@
+#include "engine.h"
+#include "latency.h"
+#include "trace.h"
+#include <cstdlib>
+using namespace std;
+
+/**
+ * Draw a 3x3 tic-tac-toe board with row and column labels
+ * The cell data in board will be interpreted as follows:
+ *   1 = owned by 'x'
+ *   2 = owned by 'o'
+ *   all other values = empty
+ *
+ * @param  int[3][3] board The current state of each board cell
+ * @param  ostream   out   Stream the board is rendered to
+ * @return void
+ */
+void drawBoard(int board[][3], ostream& out) {
+  LatencyTimer timer(LATENCY_RENDER);
+  out << "  " << "  A   B   C  " << endl;
+  out << "  " << "+---+---+---+" << endl;
+  for (int row = 0; row < 3; row++) {
+    out << row << " ";
+    for (int col = 0; col < 3; col++) {
+      switch (board[row][col]) {
+        case USER:     out << "| " << 'x' << " "; break;
+        case COMPUTER: out << "| " << 'o' << " "; break;
+        default:       out << "| " << ' ' << " "; break;
+      }
+    }
+    out << "|" << endl;
+    out << " " << " " << "+---+---+---+" << endl;
+  }
+}
+
+/**
+ * AI strategy based on randomly picking available cells
+ *
+ * @param  int[3][3]  board  The current state of the board
+ * @return void
+ **/
+void ai_random(int board[][3]) {
+  int row, col;
+  do {
+    row = rand() % 3;  // Choose a random row
+    col = rand() % 3;  // Choose a random column
+  } while (board[row][col] != EMPTY); // If taken, try again
+  trace(TRACE_DECISION, DECISION_RANDOM);
+
+  // Update the board state
+  board[row][col] = COMPUTER;
+}
+
+/**
+ * The cell the SMART strategy prefers: B1, otherwise the first free
+ * corner. Returns (-1,-1) when none of these are available, in which
+ * case the strategy picks a random cell.
+ *
+ * @param  int[3][3] board  The current state of the board
+ * @return cell             The preferred cell, or (-1,-1)
+ */
+Cell smartPreference(int board[][3]) {
+  // Prefer B1 if it is available
+  if (board[1][1] == EMPTY) { return Cell(1,1); }
+
+  // Prefer corners if they are available
+  if (board[0][0] == EMPTY) { return Cell(0,0); }
+  if (board[0][2] == EMPTY) { return Cell(0,2); }
+  if (board[2][0] == EMPTY) { return Cell(2,0); }
+  if (board[2][2] == EMPTY) { return Cell(2,2); }
+  return Cell(-1,-1);
+}
+
+namespace {
+
+/** Trace why `strategy` is about to claim `c`, a cell it preferred, on `board`. */
+void traceChoice(int board[][3], int strategy, Cell c) {
+  if constexpr (TRACE_ENABLED) {
+    unsigned user = 0, computer = 0;
+    for (int i = 0; i < 9; i++) {
+      if (board[i / 3][i % 3] == USER)     { user |= 1u << i; }
+      if (board[i / 3][i % 3] == COMPUTER) { computer |= 1u << i; }
+    }
+    traceDecision(strategy, computer, user, c.row * 3 + c.col);
+  }
+}
+
+}
+
+/**
+ * AI strategy based on preferring strategic cells if they
+ * are available. Defaults to randomly picking a cell if they
+ * are not.
+ *
+ * @param  int[3][3] board  The current state of the board
+ * @return void
+ */
+void ai_smart(int board[][3]) {
+  Cell c = smartPreference(board);
+  if (c.row >= 0 && c.col >= 0) {
+    traceChoice(board, SMART, c);
+    board[c.row][c.col] = COMPUTER;
+  } else {
+    // Resort to random available location
+    ai_random(board);
+  }
+}
+
+/**
+ * Determine whether a user could win by claiming
+ * one more cell along any of the possible winning
+ * axes.
+ * There are 8 possible winning axes. The user can
+ * win if the sum of the cells on that axis is currently
+ * 2 and if one of the cells is empty (=0).
+ *
+ * @param  int[3][3] board  The current state of the board
+ * @param  int       which  Which player (USER or COMPUTER)
+ * @return cell  The location of the cell the user could win with
+ */
+Cell playerCanWin(int board[][3], int which) {
+  // Target sum depends on which player we're calculating for
+  int target = which * 2;
+  // Iterate through the 8 possible winning axes:
+  // Rows:
+  for (int r = 0; r < 3; r++) {
+    int sum  = board[r][0] + board[r][1] + board[r][2];
+    if (sum == target ) {
+      for (int c = 0; c < 3; c++) {
+        if (board[r][c] == EMPTY) { return Cell(r,c); }
+      }
+    }
+  }
+
+  // Columns:
+  for (int c = 0; c < 3; c++) {
+    int sum  = board[0][c] + board[1][c] + board[2][c];
+    if (sum == target) {
+      for (int r = 0; r < 3; r++) {
+        if (board[r][c] == EMPTY) { return Cell(r,c); }
+      }
+    }
+  }
+
+  // Diagonals:
+  int sum_ltr = board[0][0] + board[1][1] + board[2][2];
+  if (sum_ltr == target) {
+    if (board[0][0] == EMPTY) { return Cell(0,0); }
+    if (board[1][1] == EMPTY) { return Cell(1,1); }
+    if (board[2][2] == EMPTY) { return Cell(2,2); }
+  }
+  int sum_rtl = board[0][2] + board[1][1] + board[2][0];
+  if (sum_rtl == target) {
+    if (board[0][2] == EMPTY) { return Cell(0,2); }
+    if (board[1][1] == EMPTY) { return Cell(1,1); }
+    if (board[2][0] == EMPTY) { return Cell(2,0); }
+  }
+  // No possible win
+  return Cell(-1,-1);
+}
+
+Cell userCanWin(int board[][3]) {
+  return playerCanWin(board, USER);
+}
+
+Cell computerCanWin(int board[][3]) {
+  return playerCanWin(board, COMPUTER);
+}
+
+/**
+ * The cell the GENIOUS strategy prefers: B1, otherwise a winning cell,
+ * otherwise a cell that blocks the user from winning, otherwise SMART's
+ * preference. Returns (-1,-1) when it would pick a random cell.
+ *
+ * @param  int[3][3] board  The current state of the board
+ * @return cell             The preferred cell, or (-1,-1)
+ */
+Cell geniousPreference(int board[][3]) {
+  // Prefer B1 if it is available
+  if (board[1][1] == EMPTY) { return Cell(1,1); }
+
+  // Determine if there's any way for the computer
+  // to win on this turn
+  Cell c = computerCanWin(board);
+  if (c.row >= 0 && c.col >= 0) { return c; }
+
+  // Otherwise, determine whether there's any way for
+  // the user to win on their next turn, and block it
+  c = userCanWin(board);
+  if (c.row >= 0 && c.col >= 0) { return c; }
+
+  // Otherwise, try to pick a strategic location
+  return smartPreference(board);
+}
+
+void ai_genious(int board[][3]) {
+  Cell c = geniousPreference(board);
+  if (c.row >= 0 && c.col >= 0) {
+    traceChoice(board, GENIOUS, c);
+    board[c.row][c.col] = COMPUTER; // computer is always 'o'
+  } else {
+    ai_random(board);
+  }
+}
+
+
+/**
+ * Determine the next move the computer should make. For now
+ * the strategy will be simple: randomly pick an available
+ * cell.
+ * Once a cell has been picked, update the board
+ *
+ * @param  int[3][3] board   The current state of the board
+ * @param  int    strategy   The strategy to use
+ * @return void
+ */
+void nextComputerMove(int board[][3], int strategy) {
+  LatencyTimer timer((strategy == SMART) ? LATENCY_SMART_MOVE : (strategy == GENIOUS) ? LATENCY_GENIOUS_MOVE
+                                                                                     : LATENCY_RANDOM_MOVE);
+  switch (strategy) {
+    case SMART:
+      ai_smart(board);
+      break;
+    case GENIOUS:
+      ai_genious(board);
+      break;
+    case RANDOM:
+    default:
+      ai_random(board);
+      break;
+  }
+}
+
+/**
+ * Determine the status of the game given the current state
+ * of the board. The status can be one of 4 values:
+ *   0 - valid: no one has won yet, and there are valid moves remaining
+ *   1 - invalid, user has won
+ *   2 - invalid, computer has won
+ *   3 - invalid, draw - no one has won but there are no valid moves remaining
+ *
+ * @param  int[3][3] board   The current state of the board
+ * @return int               The status of the board in its current state
+ */
+int isGameOver (int board[][3]) {
+  LatencyTimer timer(LATENCY_GAME_OVER);
+
+  // Strategy: examine the "middle" square for each axis. There are only a
+  //           limited number of these squares on the board. Specifically:
+  //     A   B   C
+  //   +---+---+---+
+  // 0 |   | x |   |
+  //   +---+---+---+
+  // 1 | x | x | x |
+  //   +---+---+---+
+  // 2 |   | x |   |
+  //   +---+---+---+
+  // If a given user owns one of these middle squares, and also owns two
+  // neighbors along the same axis, then that user has won. Each "middle
+  // square" has only one axis to check, except B1, which has four axes.
+  // In other words you have won if you own:
+  //   B0  (and A0 and C0)
+  //   A1  (and A0 and A2)
+  //   B2  (and A2 and C2)
+  //   C1  (and C0 and C2)
+  //   B1  (and B0 and B2), (and A1 and C1), (and A0 and C2), (and A2 and C0)
+
+  // Check each player sequentially:
+  for (int player = USER; player <= COMPUTER; player += (COMPUTER - USER)) {
+
+    // Determine if the current player won
+    if ((board[0][1] == player && board[0][0] == player && board[0][2] == player)
+    	||(board[1][0] == player && board[0][0] == player && board[2][0] == player)
+    	||(board[2][1] == player && board[2][0] == player && board[2][2] == player)
+    	||(board[1][2] == player && board[0][2] == player && board[2][2] == player)
+    	||(board[1][1] == player && (
+  	   (board[0][1] == player && board[2][1] == player)
+  	   ||(board[1][0] == player && board[1][2] == player)
+  	   ||(board[0][0] == player && board[2][2] == player)
+  	   ||(board[2][0] == player && board[0][2] == player))
+	    )
+	  ){
+      return player;
+    }
+  }
+
+  // Determine if there are no further moves available
+  bool moreMoves = false;
+  for (int col = 0; col < 3; col++) {
+    for (int row = 0; row < 3; row++) {
+      if (board[row][col] == EMPTY) { moreMoves = true; }
+    }
+  }
+
+  if (moreMoves) {
+    return IN_PROGRESS;// game still valid;
+  } else {
+    return DRAW;       // game over without a winner
+  }
+}
+
+/**
+ * Determine the cell the given strategy would claim for `player`
+ * without modifying the caller's board. The strategies always play
+ * as COMPUTER, so when asked to move for the USER the colors are
+ * swapped on a scratch copy first.
+ *
+ * @param  int[3][3] board     The current state of the board
+ * @param  int       player    Which player is to move (USER or COMPUTER)
+ * @param  int       strategy  The strategy to use
+ * @return cell  The chosen cell, or (-1,-1) if the board is full
+ */
+Cell chooseMove(int board[][3], int player, int strategy) {
+  int scratch[3][3];
+  bool empty = false;
+  for (int row = 0; row < 3; row++) {
+    for (int col = 0; col < 3; col++) {
+      int v = board[row][col];
+      if (player == USER && v != EMPTY) { v = (v == USER) ? COMPUTER : USER; }
+      scratch[row][col] = v;
+      if (v == EMPTY) { empty = true; }
+    }
+  }
+  // The strategies never return on a full board (see `ai_random`)
+  if (!empty) { return Cell(-1,-1); }
+
+  nextComputerMove(scratch, strategy);
+
+  // Find the one cell the strategy claimed
+  for (int row = 0; row < 3; row++) {
+    for (int col = 0; col < 3; col++) {
+      if (board[row][col] == EMPTY && scratch[row][col] != EMPTY) { return Cell(row,col); }
+    }
+  }
+  return Cell(-1,-1);
+}
+
+/**
+ * Pack a board into its position code, see `POSITION_CODES`.
+ *
+ * @param  int[3][3] board  The board to encode
+ * @return int              Code in [0, POSITION_CODES)
+ */
+int encodeBoard(int board[][3]) {
+  int code = 0;
+  for (int i = 8; i >= 0; i--) {
+    int v = board[i / 3][i % 3];
+    code = code * 3 + ((v == USER) ? 1 : (v == COMPUTER) ? 2 : 0);
+  }
+  return code;
+}
+
+/**
+ * Unpack a position code produced by `encodeBoard`.
+ *
+ * @param  int       code   The position code
+ * @param  int[3][3] board  Receives the board
+ * @return void
+ */
+void decodeBoard(int code, int board[][3]) {
+  static const int values[3] = {EMPTY, USER, COMPUTER};
+  for (int i = 0; i < 9; i++) {
+    board[i / 3][i % 3] = values[code % 3];
+    code /= 3;
+  }
+}
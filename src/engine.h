@@ -0,0 +1,78 @@
+#ifndef TICTACTOE_ENGINE_H
+#define TICTACTOE_ENGINE_H
+
+#include <iostream>
+
+/**
+ * Enumerate the possible players in the game. Each is given
+ * a unique prime integer so that the math involved with determining
+ * available winning moves on the board is made easier.
+ *
+ * See the `ai_*` functions and the `drawBoard` for relevant logic
+ */
+enum {EMPTY=0, USER=7, COMPUTER=11};
+
+/**
+ * Enumerate possible states the game can be in. The game is either
+ *  IN_PROGRESS  - neither player has won, and there are still valid moves
+ *  USER_WON     - user won by matching three in a row
+ *  COMPUTER_WON - computer won by matching three in a row
+ *  DRAW         - neither player has won, but there are no valid moves left
+ *
+ * See the function `isGameOver` for related logic
+ */
+enum {IN_PROGRESS=0, USER_WON=USER, COMPUTER_WON=COMPUTER, DRAW};
+
+/**
+ * Enumerate possible strategies the computer might employ to try to
+ * win the game. Available strategies are:
+ *   0 RANDOM       - Randomly pick one of the available cells
+ *   1 SMART        - Prefer strategic locations if available
+ *   2 GENIOUS      - Defend and attack in all situations
+ *
+ * GENIOUS is the default strategy used if no other is requested. See the
+ * function `nextComputerMove` for relevant logic
+ */
+enum {RANDOM, SMART, GENIOUS};
+
+/**
+ * Container to represent a single cell on the board. This makes
+ * it possible to use a board location as the return value of a
+ * function ex: `playerCanWin`.
+ */
+struct Cell {
+  Cell(int r, int c): row(r), col(c) {};
+  int row;
+  int col;
+};
+
+// Rendering
+void drawBoard(int board[][3], std::ostream& out = std::cout);
+
+// Strategies: each one claims a single empty cell for COMPUTER
+void ai_random(int board[][3]);
+void ai_smart(int board[][3]);
+void ai_genious(int board[][3]);
+void nextComputerMove(int board[][3], int strategy);
+
+// The deterministic part of a strategy: the cell it would claim, or
+// (-1,-1) when it falls back to a random cell
+Cell smartPreference(int board[][3]);
+Cell geniousPreference(int board[][3]);
+
+// Rules
+Cell playerCanWin(int board[][3], int which);
+Cell userCanWin(int board[][3]);
+Cell computerCanWin(int board[][3]);
+int  isGameOver(int board[][3]);
+
+// Move selection without touching the caller's board
+Cell chooseMove(int board[][3], int player, int strategy);
+
+// Compact position codes: base-3 number, one digit per cell (0 = empty,
+// 1 = USER, 2 = COMPUTER), cell 0 (A0) least significant
+enum {POSITION_CODES = 19683};  // 3^9
+int  encodeBoard(int board[][3]);
+void decodeBoard(int code, int board[][3]);
+
+#endif
@@ -0,0 +1,281 @@
+#include "game_codec.h"
+#include "bitboard.h"
+#include "move_table.h"
+#include <cmath>
+#include <cstring>
+
+namespace {
+
+// rANS with 32-bit state and byte-wise output; probabilities are
+// integer weights out of TOTAL
+const uint32_t SCALE_BITS = 12;
+const uint32_t TOTAL      = 1u << SCALE_BITS;
+const uint32_t RANS_L     = 1u << 23;
+
+enum {STOP = 9, SYMBOLS = 10};
+
+// Seeds: one more than the previous game's, or anything else
+const uint32_t NEXT_SEED_WEIGHT = TOTAL - 64;
+
+struct Symbol {
+  uint16_t start;
+  uint16_t freq;
+};
+
+/** Minimax over every position, for the HUMAN model. */
+struct PerfectPlay {
+  int8_t   value[POSITION_CODES];   // for the side to move: 1 win, 0 draw, -1 loss
+  uint16_t best[POSITION_CODES];    // cells that keep that value
+  bool     known[POSITION_CODES];
+
+  PerfectPlay(): value(), best(), known() { solve(0, 0); }
+
+  /** Value for `me`, to move against `opp`. Positions are coded with the mover as COMPUTER. */
+  int solve(unsigned me, unsigned opp) {
+    int code = bitboardCode(opp, me);
+    if (known[code]) { return value[code]; }
+    int v;
+    if (MASKS.hasLine[opp]) {
+      v = -1;
+    } else if ((me | opp) == FULL_BOARD) {
+      v = 0;
+    } else {
+      v = -2;
+      for (unsigned empty = FULL_BOARD & ~(me | opp); empty; empty &= empty - 1) {
+        unsigned bit = empty & -empty;
+        int r = -solve(opp, me | bit);
+        if (r > v) {
+          v = r;
+          best[code] = bit;
+        } else if (r == v) {
+          best[code] |= bit;
+        }
+      }
+    }
+    known[code] = true;
+    value[code] = v;
+    return v;
+  }
+};
+
+const PerfectPlay& perfectPlay() {
+  static const PerfectPlay* perfect = new PerfectPlay();
+  return *perfect;
+}
+
+/** Share `weight` as evenly as possible between the cells of `mask`. */
+void spread(unsigned mask, uint32_t weight, uint16_t* freq) {
+  int n = __builtin_popcount(mask);
+  if (n == 0) { return; }
+  uint32_t base = weight / n, extra = weight % n;
+  for (int i = 0; mask; mask &= mask - 1, i++) { freq[__builtin_ctz(mask)] = base + (i < (int)extra); }
+}
+
+/**
+ * Cumulative weights (`start[s]` to `start[s + 1]`) of the next move:
+ * the cells and STOP, for `mover` to play against `other` with
+ * `strategy`.
+ */
+void moveModel(unsigned mover, unsigned other, int strategy, const MoveTables& tables, uint16_t* start) {
+  unsigned empty = FULL_BOARD & ~(mover | other);
+  int code = bitboardCode(other, mover);
+  uint16_t freq[SYMBOLS] = {};
+  freq[STOP] = 1;
+  const uint32_t MOVES = TOTAL - 1;
+  unsigned favored = 0;
+  uint32_t favoredWeight = 0;
+  if (strategy == HUMAN) {
+    favored = perfectPlay().best[code] & empty;
+    favoredWeight = (favored == empty) ? MOVES : MOVES * 3 / 4;
+  } else if (strategy <= GENIOUS) {
+    int cell = tables[strategy][code];
+    if (cell >= 0) {
+      favored = 1u << cell;
+      favoredWeight = MOVES - (__builtin_popcount(empty) - 1);
+    }
+  }
+  if (!favored) {
+    favored = empty;
+    favoredWeight = MOVES;
+  }
+  spread(favored, favoredWeight, freq);
+  spread(empty & ~favored, MOVES - favoredWeight, freq);
+  start[0] = 0;
+  for (int s = 0; s < SYMBOLS; s++) { start[s + 1] = start[s] + freq[s]; }
+}
+
+/** Strategy as a 2-bit symbol, or -1 if it cannot be coded. */
+int strategySymbol(int strategy) {
+  return (strategy >= RANDOM && strategy <= GENIOUS) ? strategy : (strategy == HUMAN) ? 3 : -1;
+}
+
+int symbolStrategy(int symbol) { return (symbol == 3) ? HUMAN : symbol; }
+
+/** The symbol for `value`, `bits` (at most SCALE_BITS) plain bits. */
+Symbol uniform(uint32_t value, int bits) {
+  uint16_t freq = 1u << (SCALE_BITS - bits);
+  return Symbol{(uint16_t)(value * freq), freq};
+}
+
+class Decoder {
+ public:
+  Decoder(const uint8_t* data, size_t bytes): p_(data + 4), end_(data + bytes), damaged_(bytes < 4), x_(0) {
+    if (!damaged_) { memcpy(&x_, data, 4); }
+  }
+
+  uint32_t bits(int bits) {
+    uint32_t slot = x_ & (TOTAL - 1);
+    uint32_t value = slot >> (SCALE_BITS - bits);
+    advance(uniform(value, bits), slot);
+    return value;
+  }
+
+  /** Decode a symbol with cumulative weights `start` (of `count` symbols). */
+  int symbol(const uint16_t* start, int count) {
+    uint32_t slot = x_ & (TOTAL - 1);
+    int s = 0;
+    while (s + 1 < count && start[s + 1] <= slot) { s++; }
+    advance(Symbol{start[s], (uint16_t)(start[s + 1] - start[s])}, slot);
+    return s;
+  }
+
+  /** All data used up, back at the initial state, and nothing read past the end. */
+  bool finished() const { return !damaged_ && p_ == end_ && x_ == RANS_L; }
+
+  bool damaged() const { return damaged_; }
+
+ private:
+  void advance(Symbol sym, uint32_t slot) {
+    x_ = sym.freq * (x_ >> SCALE_BITS) + slot - sym.start;
+    while (x_ < RANS_L) {
+      if (p_ == end_) {
+        damaged_ = true;
+        return;
+      }
+      x_ = (x_ << 8) | *p_++;
+    }
+  }
+
+  const uint8_t* p_;
+  const uint8_t* end_;
+  bool           damaged_;
+  uint32_t       x_;
+};
+
+}
+
+uint32_t modelHash(const MoveTables& tables) {
+  // FNV-1a
+  uint32_t hash = 2166136261u;
+  const uint8_t* p = reinterpret_cast<const uint8_t*>(tables.cells);
+  for (size_t i = 0; i < sizeof(tables.cells); i++) { hash = (hash ^ p[i]) * 16777619u; }
+  return hash | 1;
+}
+
+bool compressGames(const GameRecord* games, size_t count, const MoveTables& tables, std::vector<uint8_t>& out,
+                   CodecStats* stats) {
+  // Symbols are worked out front to back, as the decoder will see them,
+  // and coded back to front, as rANS needs
+  std::vector<Symbol> symbols;
+  symbols.reserve(count * 12);
+  double moveBits = 0;
+  uint32_t previousSeed = UINT32_MAX;
+  for (size_t g = 0; g < count; g++) {
+    const GameRecord& game = games[g];
+    int user = strategySymbol(game.userStrategy), computer = strategySymbol(game.computerStrategy);
+    if (user < 0 || computer < 0 || game.moveCount > 9) { return false; }
+    symbols.push_back(uniform(user, 2));
+    symbols.push_back(uniform(computer, 2));
+    symbols.push_back(uniform(game.first == COMPUTER, 1));
+    if (game.seed == previousSeed + 1) {
+      symbols.push_back(Symbol{0, (uint16_t)NEXT_SEED_WEIGHT});
+    } else {
+      symbols.push_back(Symbol{(uint16_t)NEXT_SEED_WEIGHT, (uint16_t)(TOTAL - NEXT_SEED_WEIGHT)});
+      symbols.push_back(uniform(game.seed & 0xFFF, 12));
+      symbols.push_back(uniform((game.seed >> 12) & 0xFFF, 12));
+      symbols.push_back(uniform(game.seed >> 24, 8));
+    }
+    previousSeed = game.seed;
+
+    unsigned boards[2] = {0, 0};   // user, computer
+    int mover = (game.first == USER) ? 0 : 1;
+    int status = IN_PROGRESS;
+    for (int i = 0; status == IN_PROGRESS; i++) {
+      uint16_t start[SYMBOLS + 1];
+      int strategy = mover ? game.computerStrategy : game.userStrategy;
+      moveModel(boards[mover], boards[1 - mover], strategy, tables, start);
+      int s = (i == game.moveCount) ? (int)STOP : game.moves[i];
+      if ((s == STOP) != (i == game.moveCount) || s >= SYMBOLS || start[s + 1] == start[s]) { return false; }
+      uint16_t freq = start[s + 1] - start[s];
+      symbols.push_back(Symbol{start[s], freq});
+      moveBits += std::log2((double)TOTAL / freq);
+      if (s == STOP) { break; }
+      boards[mover] |= 1u << s;
+      status = bitboardStatus(boards[0], boards[1]);
+      mover = 1 - mover;
+      if (status != IN_PROGRESS && i + 1 != game.moveCount) { return false; }
+    }
+    if (status != game.status) { return false; }
+  }
+
+  // At most two bytes out per symbol, plus the final state
+  std::vector<uint8_t> buffer(symbols.size() * 2 + 4);
+  uint8_t* end = buffer.data() + buffer.size();
+  uint8_t* p = end;
+  uint32_t x = RANS_L;
+  for (size_t i = symbols.size(); i-- > 0;) {
+    const Symbol& sym = symbols[i];
+    uint32_t limit = ((RANS_L >> SCALE_BITS) << 8) * sym.freq;
+    while (x >= limit) {
+      *--p = x & 0xFF;
+      x >>= 8;
+    }
+    x = ((x / sym.freq) << SCALE_BITS) + (x % sym.freq) + sym.start;
+  }
+  p -= 4;
+  memcpy(p, &x, 4);
+  out.insert(out.end(), p, end);
+  if (stats) {
+    stats->games += count;
+    stats->moveBits += moveBits;
+  }
+  return true;
+}
+
+bool decompressGames(const uint8_t* data, size_t bytes, size_t count, const MoveTables& tables, GameRecord* out) {
+  Decoder in(data, bytes);
+  uint32_t previousSeed = UINT32_MAX;
+  for (size_t g = 0; g < count; g++) {
+    GameRecord& game = out[g];
+    game.userStrategy     = symbolStrategy(in.bits(2));
+    game.computerStrategy = symbolStrategy(in.bits(2));
+    game.first            = in.bits(1) ? COMPUTER : USER;
+    static const uint16_t SEED_START[3] = {0, (uint16_t)NEXT_SEED_WEIGHT, (uint16_t)TOTAL};
+    if (in.symbol(SEED_START, 2) == 0) {
+      game.seed = previousSeed + 1;
+    } else {
+      uint32_t low = in.bits(12), middle = in.bits(12), high = in.bits(8);
+      game.seed = low | (middle << 12) | (high << 24);
+    }
+    previousSeed = game.seed;
+
+    unsigned boards[2] = {0, 0};
+    int mover = (game.first == USER) ? 0 : 1;
+    int status = IN_PROGRESS;
+    game.moveCount = 0;
+    while (status == IN_PROGRESS) {
+      uint16_t start[SYMBOLS + 1];
+      int strategy = mover ? game.computerStrategy : game.userStrategy;
+      moveModel(boards[mover], boards[1 - mover], strategy, tables, start);
+      int s = in.symbol(start, SYMBOLS);
+      if (s == STOP || in.damaged()) { break; }
+      boards[mover] |= 1u << s;
+      game.moves[game.moveCount++] = s;
+      status = bitboardStatus(boards[0], boards[1]);
+      mover = 1 - mover;
+    }
+    game.status = status;
+    if (in.damaged()) { return false; }
+  }
+  return in.finished();
+}
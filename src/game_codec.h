@@ -0,0 +1,60 @@
+#ifndef TICTACTOE_GAME_CODEC_H
+#define TICTACTOE_GAME_CODEC_H
+
+#include "game_record.h"
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+struct MoveTables;
+
+/**
+ * Entropy coding of games (rANS) with the engine as the model: every
+ * move is coded with the probability the mover's strategy gives it in
+ * that position, so moves a strategy is certain about cost next to
+ * nothing, and only random choices cost their log2(empty cells) bits.
+ *
+ *   table strategies  the table's cell gets almost all of the weight;
+ *                     where the table has no entry, every empty cell
+ *                     gets the same
+ *   RANDOM            every empty cell the same
+ *   HUMAN             the cells that are best under perfect play share
+ *                     3/4 of the weight, the other empty cells 1/4
+ *
+ * A game ends when its result is decided, or with a STOP symbol that an
+ * unfinished game is coded with, so neither the move count nor the
+ * result is stored. The strategies and first mover are coded as plain
+ * bits; a seed one more than the previous game's costs a fraction of a
+ * bit, any other 32 bits.
+ *
+ * Coding and decoding must use the same move tables; `modelHash`
+ * identifies them.
+ */
+
+/** What the moves alone cost, summed over calls to `compressGames`. */
+struct CodecStats {
+  uint64_t games;
+  double   moveBits;     // ideal cost of the move and STOP symbols
+};
+
+/** Nonzero hash of the move tables, to check they are the coding model. */
+uint32_t modelHash(const MoveTables& tables);
+
+/**
+ * Append the coded form of `games` to `out`, adding to `stats` if given.
+ *
+ * @return bool  false if a game's result does not follow from its moves,
+ *               or its moves are not legal, which the coding relies on
+ */
+bool compressGames(const GameRecord* games, size_t count, const MoveTables& tables, std::vector<uint8_t>& out,
+                   CodecStats* stats = nullptr);
+
+/**
+ * Decode `count` games coded by `compressGames` from `bytes` at `data`
+ * into `out`.
+ *
+ * @return bool  false if the data is damaged
+ */
+bool decompressGames(const uint8_t* data, size_t bytes, size_t count, const MoveTables& tables, GameRecord* out);
+
+#endif
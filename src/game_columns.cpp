@@ -0,0 +1,210 @@
+#include "game_columns.h"
+#include "game_record.h"
+#include <algorithm>
+#include <atomic>
+#include <cerrno>
+#include <cstring>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <thread>
+#include <unistd.h>
+
+namespace {
+
+const char COLUMNS_MAGIC[8] = {'T', 'T', 'T', 'C', 'O', 'L', 'M', 'N'};
+
+// Rows filtered and counted at a time: the chunk of each column used and
+// the scratch arrays below stay in L1
+const size_t CHUNK = 2048;
+
+// Counting slots: first group value << 6 | second << 2 | result, and one
+// more for the games filtered out
+const unsigned SLOTS = 1025;
+const unsigned DROPPED = 1024;
+
+alignas(64) const uint8_t ZEROS[CHUNK] = {};
+
+uint64_t roundUp(uint64_t n, uint64_t to) { return (n + to - 1) / to * to; }
+
+/**
+ * Count rows [from, to) into `counts`, 4 copies of SLOTS slots. The
+ * filter and slot loops are plain byte loops the compiler vectorises.
+ */
+void scanRows(const uint8_t* const* columns, const GroupQuery& query, uint64_t from, uint64_t to,
+              uint64_t* counts) {
+  alignas(64) uint8_t  keep[CHUNK];
+  alignas(64) uint16_t slot[CHUNK];
+  for (uint64_t begin = from; begin < to; begin += CHUNK) {
+    size_t n = std::min<uint64_t>(CHUNK, to - begin);
+    memset(keep, 1, n);
+    for (const ColumnRange& range : query.where) {
+      const uint8_t* __restrict values = columns[range.column] + begin;
+      uint8_t low = range.low, span = range.high - range.low;
+      for (size_t i = 0; i < n; i++) { keep[i] &= (uint8_t)(values[i] - low) <= span; }
+    }
+    const uint8_t* __restrict a = (query.groupBy[0] >= 0) ? columns[query.groupBy[0]] + begin : ZEROS;
+    const uint8_t* __restrict b = (query.groupBy[1] >= 0) ? columns[query.groupBy[1]] + begin : ZEROS;
+    const uint8_t* __restrict r = columns[COLUMN_RESULT] + begin;
+    for (size_t i = 0; i < n; i++) {
+      uint16_t s = ((a[i] & 0xF) << 6) | ((b[i] & 0xF) << 2) | (r[i] & 3);
+      slot[i] = keep[i] ? s : DROPPED;
+    }
+    // Successive rows go to different copies, so that a run of rows in
+    // one slot does not wait on its own increments
+    size_t i = 0;
+    for (; i + 4 <= n; i += 4) {
+      counts[slot[i]]++;
+      counts[SLOTS + slot[i + 1]]++;
+      counts[2 * SLOTS + slot[i + 2]]++;
+      counts[3 * SLOTS + slot[i + 3]]++;
+    }
+    for (; i < n; i++) { counts[slot[i]]++; }
+  }
+}
+
+}
+
+bool writeGameColumns(const GameReader& games, const char* path, int threads) {
+  if (threads < 1) { threads = 1; }
+  GameColumnsHeader header = {};
+  memcpy(header.magic, COLUMNS_MAGIC, sizeof(header.magic));
+  header.version = GAME_COLUMNS_VERSION;
+  header.columns = COLUMN_COUNT;
+  header.games   = games.games();
+  uint64_t size = roundUp(sizeof(header), 64);
+  for (int c = 0; c < COLUMN_COUNT; c++) {
+    header.offsets[c] = size;
+    size += roundUp(header.games, 64);
+  }
+
+  // Sized up front and filled in place, so the columns never have to
+  // fit in memory at once, and threads can fill their blocks' rows
+  int fd = ::open(path, O_RDWR | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+  if (fd < 0) { return false; }
+  void* mem = (ftruncate(fd, size) == 0) ? mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0) : MAP_FAILED;
+  if (mem == MAP_FAILED) {
+    int saved = errno;
+    ::close(fd);
+    errno = saved;
+    return false;
+  }
+  uint8_t* data = static_cast<uint8_t*>(mem);
+  memcpy(data, &header, sizeof(header));
+
+  std::atomic<bool> damaged(false);
+  std::vector<std::thread> workers;
+  for (int t = 0; t < threads; t++) {
+    workers.emplace_back([&, t] {
+      uint64_t from = games.blocks() * t / threads, to = games.blocks() * (t + 1) / threads;
+      uint8_t* columns[COLUMN_COUNT];
+      for (int c = 0; c < COLUMN_COUNT; c++) { columns[c] = data + header.offsets[c]; }
+      for (uint64_t block = from; block < to; block++) {
+        uint64_t id = games.firstGame(block);
+        bool ok = games.forEachInBlock(block, [&](const GameRecord& game) {
+          if (id >= header.games) { return; }
+          columns[COLUMN_RESULT][id]   = resultCode(game.status);
+          columns[COLUMN_LENGTH][id]   = game.moveCount;
+          columns[COLUMN_USER][id]     = game.userStrategy & 0xF;
+          columns[COLUMN_COMPUTER][id] = game.computerStrategy & 0xF;
+          columns[COLUMN_FIRST][id]    = (game.first == COMPUTER);
+          for (int m = 0; m < COLUMN_MOVES; m++) {
+            bool played = (m < game.moveCount && game.moves[m] < 9);
+            columns[COLUMN_MOVE0 + m][id] = played ? game.moves[m] : (uint8_t)NO_MOVE;
+          }
+          id++;
+        });
+        if (!ok) { damaged.store(true); }
+      }
+    });
+  }
+  for (std::thread& worker : workers) { worker.join(); }
+
+  bool ok = !damaged.load();
+  if (!ok) { errno = EINVAL; }
+  int saved = errno;
+  munmap(mem, size);
+  if (::close(fd) != 0) { ok = false; } else { errno = saved; }
+  return ok;
+}
+
+GameColumns::~GameColumns() {
+  if (data_) { munmap(const_cast<uint8_t*>(data_), size_); }
+}
+
+bool GameColumns::open(const char* path) {
+  int fd = ::open(path, O_RDONLY | O_CLOEXEC);
+  if (fd < 0) { return false; }
+  struct stat st;
+  if (fstat(fd, &st) < 0) {
+    int saved = errno;
+    ::close(fd);
+    errno = saved;
+    return false;
+  }
+  size_t size = st.st_size;
+  if (size < sizeof(GameColumnsHeader)) {
+    ::close(fd);
+    errno = EINVAL;
+    return false;
+  }
+  void* mem = mmap(nullptr, size, PROT_READ, MAP_SHARED, fd, 0);
+  ::close(fd);
+  if (mem == MAP_FAILED) { return false; }
+  // Queries read whole columns front to back
+  madvise(mem, size, MADV_SEQUENTIAL);
+  data_ = static_cast<const uint8_t*>(mem);
+  size_ = size;
+
+  GameColumnsHeader header;
+  memcpy(&header, data_, sizeof(header));
+  bool ok = memcmp(header.magic, COLUMNS_MAGIC, sizeof(header.magic)) == 0 &&
+            header.version == GAME_COLUMNS_VERSION && header.columns == COLUMN_COUNT;
+  for (int c = 0; ok && c < COLUMN_COUNT; c++) {
+    ok = header.offsets[c] <= size && header.games <= size - header.offsets[c];
+    columns_[c] = data_ + header.offsets[c];
+  }
+  if (!ok) {
+    errno = EINVAL;
+    return false;
+  }
+  games_ = header.games;
+  return true;
+}
+
+bool GameColumns::query(const GroupQuery& query, GroupCounts& counts, int threads) const {
+  for (const ColumnRange& range : query.where) {
+    if (range.column < 0 || range.column >= COLUMN_COUNT || range.high < range.low) {
+      errno = EINVAL;
+      return false;
+    }
+  }
+  for (int column : query.groupBy) {
+    if (column < -1 || column >= COLUMN_COUNT) {
+      errno = EINVAL;
+      return false;
+    }
+  }
+  if (threads < 1) { threads = 1; }
+
+  // Threads take ranges of whole chunks, and counts of their own
+  uint64_t chunks = (games_ + CHUNK - 1) / CHUNK;
+  std::vector<std::vector<uint64_t>> partial(threads, std::vector<uint64_t>(4 * SLOTS));
+  std::vector<std::thread> workers;
+  for (int t = 0; t < threads; t++) {
+    workers.emplace_back([&, t] {
+      uint64_t from = std::min(games_, chunks * t / threads * CHUNK);
+      uint64_t to   = std::min(games_, chunks * (t + 1) / threads * CHUNK);
+      scanRows(columns_, query, from, to, partial[t].data());
+    });
+  }
+  for (std::thread& worker : workers) { worker.join(); }
+
+  memset(&counts, 0, sizeof(counts));
+  for (int t = 0; t < threads; t++) {
+    for (int copy = 0; copy < 4; copy++) {
+      for (unsigned s = 0; s < DROPPED; s++) { counts.games[s >> 2][s & 3] += partial[t][copy * SLOTS + s]; }
+    }
+  }
+  return true;
+}
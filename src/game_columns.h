@@ -0,0 +1,113 @@
+#ifndef TICTACTOE_GAME_COLUMNS_H
+#define TICTACTOE_GAME_COLUMNS_H
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+class GameReader;
+
+/**
+ * Column layout of a game archive, for aggregate queries over every game
+ * ("win rate by opening move") that only need a few fields of each. A
+ * column holds one byte per game, so a query reads only the columns it
+ * uses, straight through, in chunks small enough to stay in cache while
+ * they are filtered and counted:
+ *
+ *   COLUMN_RESULT    `resultCode` of the status
+ *   COLUMN_LENGTH    number of moves
+ *   COLUMN_USER      user's strategy (HUMAN if a person played)
+ *   COLUMN_COMPUTER  computer's strategy
+ *   COLUMN_FIRST     0 if the user moved first, 1 if the computer did
+ *   COLUMN_MOVE0...  the first COLUMN_MOVES moves' cells, NO_MOVE past
+ *                    the end of the game
+ *
+ * Every value fits in 4 bits. The file is a GameColumnsHeader followed
+ * by the columns, each at a multiple of 64 bytes, and is read through a
+ * read-only mapping. Integers are little endian.
+ */
+
+enum {
+  COLUMN_RESULT,
+  COLUMN_LENGTH,
+  COLUMN_USER,
+  COLUMN_COMPUTER,
+  COLUMN_FIRST,
+  COLUMN_MOVE0,
+  COLUMN_MOVES = 4,
+  COLUMN_COUNT = COLUMN_MOVE0 + COLUMN_MOVES,
+  NO_MOVE      = 0xF
+};
+
+struct GameColumnsHeader {
+  char     magic[8];                // "TTTCOLMN"
+  uint32_t version;
+  uint32_t columns;                 // COLUMN_COUNT
+  uint64_t games;
+  uint64_t offsets[COLUMN_COUNT];   // of each column, from the start of the file
+};
+
+static const uint32_t GAME_COLUMNS_VERSION = 1;
+
+/** Keep games whose `column` is within [low, high]. */
+struct ColumnRange {
+  int     column;
+  uint8_t low;
+  uint8_t high;
+};
+
+/**
+ * Count the games that pass every filter of `where`, by result and by
+ * the values of up to two columns (-1 for none).
+ */
+struct GroupQuery {
+  std::vector<ColumnRange> where;
+  int                      groupBy[2] = {-1, -1};
+};
+
+/** Games counted by a GroupQuery: `games[first * 16 + second][resultCode]`. */
+struct GroupCounts {
+  uint64_t games[256][4];
+};
+
+/**
+ * Write the columns of every game of `games` to a new file at `path`,
+ * using `threads` threads that each take a range of blocks.
+ *
+ * @return bool  false (errno set) if the file cannot be written, or
+ *               (EINVAL) a block of `games` is damaged
+ */
+bool writeGameColumns(const GameReader& games, const char* path, int threads = 1);
+
+/** Reads a file written by `writeGameColumns`. Safe to query from several threads at once. */
+class GameColumns {
+ public:
+  GameColumns(): data_(nullptr), size_(0), games_(0), columns_() {}
+  ~GameColumns();
+  GameColumns(const GameColumns&) = delete;
+  GameColumns& operator=(const GameColumns&) = delete;
+
+  /** @return bool  false (errno set) if `path` is not a valid column file */
+  bool open(const char* path);
+
+  uint64_t games() const { return games_; }
+
+  /** Values of `column` for every game, in file order. */
+  const uint8_t* column(int column) const { return columns_[column]; }
+
+  /**
+   * Run `query` over every game, split between `threads` threads.
+   *
+   * @return bool  false (EINVAL) if the query names a column that does
+   *               not exist
+   */
+  bool query(const GroupQuery& query, GroupCounts& counts, int threads = 1) const;
+
+ private:
+  const uint8_t* data_;
+  size_t         size_;
+  uint64_t       games_;
+  const uint8_t* columns_[COLUMN_COUNT];
+};
+
+#endif
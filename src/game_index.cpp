@@ -0,0 +1,221 @@
+#include "game_index.h"
+#include "game_record.h"
+#include <atomic>
+#include <cerrno>
+#include <cstring>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <thread>
+#include <unistd.h>
+#include <vector>
+
+namespace {
+
+const char INDEX_FILE_MAGIC[8] = {'T', 'T', 'T', 'P', 'O', 'S', 'I', 'X'};
+
+/** A thread's postings for one position, over its range of games. */
+struct Postings {
+  std::vector<uint8_t> bytes;   // the first id, then gaps, as varints
+  uint64_t             first;
+  uint64_t             last;
+  uint64_t             games;
+  uint64_t             results[4];
+
+  void add(uint64_t id, unsigned result) {
+    putVarint(games ? id - last : id);
+    if (!games) { first = id; }
+    last = id;
+    games++;
+    results[result]++;
+  }
+
+  void putVarint(uint64_t value) {
+    for (; value >= 0x80; value >>= 7) { bytes.push_back(uint8_t(value) | 0x80); }
+    bytes.push_back(uint8_t(value));
+  }
+};
+
+size_t varintBytes(uint64_t value) {
+  size_t bytes = 1;
+  for (; value >= 0x80; value >>= 7) { bytes++; }
+  return bytes;
+}
+
+/** Index the games of blocks [from, to) into `postings`, one per position code. */
+bool indexBlocks(const GameReader& games, uint64_t from, uint64_t to, std::vector<Postings>& postings) {
+  for (uint64_t block = from; block < to; block++) {
+    uint64_t id = games.firstGame(block);
+    bool ok = games.forEachInBlock(block, [&](const GameRecord& game) {
+      int status = replayGame(game);
+      if (status >= 0) {
+        unsigned result = resultCode(game.status);
+        unsigned boards[2] = {0, 0};   // of the player moving first, and second
+        unsigned& user = boards[game.first == USER ? 0 : 1];
+        unsigned& computer = boards[game.first == USER ? 1 : 0];
+        postings[canonicalCode(0, 0)].add(id, result);
+        for (int i = 0; i < game.moveCount; i++) {
+          boards[i & 1] |= 1u << game.moves[i];
+          postings[canonicalCode(user, computer)].add(id, result);
+        }
+      }
+      id++;
+    });
+    if (!ok) { return false; }
+  }
+  return true;
+}
+
+/** Buffered writes to a file descriptor. */
+class Output {
+ public:
+  explicit Output(int fd): fd_(fd) { buffer_.reserve(1 << 20); }
+
+  bool put(const void* data, size_t len) {
+    const uint8_t* p = static_cast<const uint8_t*>(data);
+    if (buffer_.size() + len > buffer_.capacity() && !flush()) { return false; }
+    if (len > buffer_.capacity()) { return writeAll(p, len); }
+    buffer_.insert(buffer_.end(), p, p + len);
+    return true;
+  }
+
+  bool flush() {
+    bool ok = writeAll(buffer_.data(), buffer_.size());
+    buffer_.clear();
+    return ok;
+  }
+
+ private:
+  bool writeAll(const uint8_t* p, size_t len) {
+    while (len > 0) {
+      ssize_t n = ::write(fd_, p, len);
+      if (n < 0 && errno == EINTR) { continue; }
+      if (n < 0) { return false; }
+      p += n;
+      len -= n;
+    }
+    return true;
+  }
+
+  int                  fd_;
+  std::vector<uint8_t> buffer_;
+};
+
+}
+
+bool buildGameIndex(const GameReader& games, const char* path, int threads) {
+  if (threads < 1) { threads = 1; }
+  if ((uint64_t)threads > games.blocks()) { threads = games.blocks() ? games.blocks() : 1; }
+
+  // Each thread indexes a range of blocks; since ranges follow each
+  // other, the postings of a position are the threads' in turn, with only
+  // the first id of each range to turn into a gap
+  std::vector<std::vector<Postings>> parts(threads, std::vector<Postings>(POSITION_CODES));
+  std::vector<std::thread> workers;
+  std::atomic<bool> damaged(false);
+  for (int t = 0; t < threads; t++) {
+    workers.emplace_back([&, t] {
+      uint64_t from = games.blocks() * t / threads, to = games.blocks() * (t + 1) / threads;
+      if (!indexBlocks(games, from, to, parts[t])) { damaged.store(true); }
+    });
+  }
+  for (std::thread& worker : workers) { worker.join(); }
+  if (damaged.load()) {
+    errno = EINVAL;
+    return false;
+  }
+
+  GameIndexHeader header = {};
+  memcpy(header.magic, INDEX_FILE_MAGIC, sizeof(header.magic));
+  header.version = GAME_INDEX_VERSION;
+  header.games   = games.games();
+  std::vector<PositionEntry> entries(POSITION_CODES);
+  for (int code = 0; code < POSITION_CODES; code++) {
+    PositionEntry& entry = entries[code];
+    entry.offset = header.postingBytes;
+    bool any = false;
+    uint64_t last = 0;
+    for (int t = 0; t < threads; t++) {
+      const Postings& part = parts[t][code];
+      if (!part.games) { continue; }
+      entry.bytes += part.bytes.size();
+      if (any) { entry.bytes += varintBytes(part.first - last) - varintBytes(part.first); }
+      entry.games += part.games;
+      for (int r = 0; r < 4; r++) { entry.results[r] += part.results[r]; }
+      any = true;
+      last = part.last;
+    }
+    header.postingBytes += entry.bytes;
+  }
+
+  int fd = ::open(path, O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+  if (fd < 0) { return false; }
+  Output out(fd);
+  bool ok = out.put(&header, sizeof(header)) && out.put(entries.data(), entries.size() * sizeof(PositionEntry));
+  for (int code = 0; ok && code < POSITION_CODES; code++) {
+    bool any = false;
+    uint64_t last = 0;
+    for (int t = 0; ok && t < threads; t++) {
+      Postings& part = parts[t][code];
+      if (!part.games) { continue; }
+      size_t skip = 0;
+      if (any) {
+        Postings gap = {};
+        gap.putVarint(part.first - last);
+        skip = varintBytes(part.first);
+        ok = out.put(gap.bytes.data(), gap.bytes.size());
+      }
+      ok = ok && out.put(part.bytes.data() + skip, part.bytes.size() - skip);
+      any = true;
+      last = part.last;
+      std::vector<uint8_t>().swap(part.bytes);
+    }
+  }
+  ok = ok && out.flush();
+  int saved = errno;
+  if (::close(fd) != 0) { ok = false; } else { errno = saved; }
+  return ok;
+}
+
+GameIndex::~GameIndex() {
+  if (data_) { munmap(const_cast<uint8_t*>(data_), size_); }
+}
+
+bool GameIndex::open(const char* path) {
+  int fd = ::open(path, O_RDONLY | O_CLOEXEC);
+  if (fd < 0) { return false; }
+  struct stat st;
+  if (fstat(fd, &st) < 0) {
+    int saved = errno;
+    ::close(fd);
+    errno = saved;
+    return false;
+  }
+  size_t size = st.st_size;
+  size_t postingsAt = sizeof(GameIndexHeader) + POSITION_CODES * sizeof(PositionEntry);
+  if (size < postingsAt) {
+    ::close(fd);
+    errno = EINVAL;
+    return false;
+  }
+  void* mem = mmap(nullptr, size, PROT_READ, MAP_SHARED, fd, 0);
+  ::close(fd);
+  if (mem == MAP_FAILED) { return false; }
+  // Queries jump around the file; reading ahead would be wasted
+  madvise(mem, size, MADV_RANDOM);
+  data_ = static_cast<const uint8_t*>(mem);
+  size_ = size;
+
+  GameIndexHeader header;
+  memcpy(&header, data_, sizeof(header));
+  if (memcmp(header.magic, INDEX_FILE_MAGIC, sizeof(header.magic)) != 0 || header.version != GAME_INDEX_VERSION ||
+      header.postingBytes != size - postingsAt) {
+    errno = EINVAL;
+    return false;
+  }
+  entries_      = reinterpret_cast<const PositionEntry*>(data_ + sizeof(GameIndexHeader));
+  postings_     = data_ + postingsAt;
+  postingBytes_ = header.postingBytes;
+  games_        = header.games;
+  return true;
+}
@@ -0,0 +1,119 @@
+#ifndef TICTACTOE_GAME_INDEX_H
+#define TICTACTOE_GAME_INDEX_H
+
+#include "bitboard.h"
+#include <cstddef>
+#include <cstdint>
+
+class GameReader;
+
+/**
+ * Inverted index of a game record file (see game_record.h): for every
+ * position, the games that reached it and how they ended. Positions
+ * are taken up to rotation and reflection (`canonicalCode`), so a query
+ * finds every game that reached a position playing the same, whichever
+ * way round the board was.
+ *
+ * The file is used where it lies, through a read-only mapping, so there
+ * is nothing to load before the first query. All integers are little
+ * endian:
+ *
+ *   GameIndexHeader
+ *   PositionEntry per position code (POSITION_CODES of them; only
+ *                 canonical codes have games)
+ *   postings:     per position, the ids of its games (their number in
+ *                 the record file) in increasing order, as LEB128
+ *                 varints: the first id, then the gap to each next one
+ *
+ * The start position is in every game, so its postings cost about one
+ * byte per game; most positions cost far less. Games whose moves break
+ * the rules are left out.
+ */
+
+struct GameIndexHeader {
+  char     magic[8];          // "TTTPOSIX"
+  uint32_t version;
+  uint32_t reserved;
+  uint64_t games;             // in the record file indexed
+  uint64_t postingBytes;
+};
+
+struct PositionEntry {
+  uint64_t offset;            // of the postings, from the start of the postings
+  uint64_t bytes;
+  uint64_t games;             // that reached the position
+  uint64_t results[4];        // of those games, by `resultCode`
+};
+
+static const uint32_t GAME_INDEX_VERSION = 1;
+
+/**
+ * Index every game of `games` into a new file at `path`, using
+ * `threads` threads that each take a range of blocks.
+ *
+ * @return bool  false (errno set) if the file cannot be written, or
+ *               (EINVAL) a block of `games` is damaged
+ */
+bool buildGameIndex(const GameReader& games, const char* path, int threads = 1);
+
+/** Reads a file written by `buildGameIndex`. Safe to query from several threads at once. */
+class GameIndex {
+ public:
+  GameIndex(): data_(nullptr), size_(0), entries_(nullptr), postings_(nullptr), postingBytes_(0), games_(0) {}
+  ~GameIndex();
+  GameIndex(const GameIndex&) = delete;
+  GameIndex& operator=(const GameIndex&) = delete;
+
+  /**
+   * Map `path`. Only the header is read; entries are checked as they are
+   * queried.
+   *
+   * @return bool  false (errno set) if `path` is not a valid index
+   */
+  bool open(const char* path);
+
+  /** Number of games indexed. */
+  uint64_t games() const { return games_; }
+
+  /** The games through a position, given as each player's cell mask. */
+  const PositionEntry& position(unsigned user, unsigned computer) const {
+    return entries_[canonicalCode(user, computer)];
+  }
+
+  /**
+   * Call `f(uint64_t id)` on the id of every game through a position, in
+   * increasing order.
+   *
+   * @return bool  false if the postings are damaged
+   */
+  template <typename F>
+  bool forEachGame(unsigned user, unsigned computer, F f) const {
+    const PositionEntry& entry = position(user, computer);
+    if (entry.offset > postingBytes_ || entry.bytes > postingBytes_ - entry.offset) { return false; }
+    const uint8_t* p = postings_ + entry.offset;
+    const uint8_t* end = p + entry.bytes;
+    uint64_t id = 0;
+    for (uint64_t i = 0; i < entry.games; i++) {
+      uint64_t gap = 0;
+      for (int shift = 0;; shift += 7) {
+        if (p == end || shift > 63) { return false; }
+        uint8_t byte = *p++;
+        gap |= uint64_t(byte & 0x7F) << shift;
+        if (!(byte & 0x80)) { break; }
+      }
+      id += gap;
+      f(id);
+    }
+    return p == end;
+  }
+
+ private:
+  const uint8_t*       data_;
+  size_t               size_;
+  const PositionEntry* entries_;
+  const uint8_t*       postings_;
+  uint64_t             postingBytes_;
+  uint64_t             games_;
+};
+
+#endif
@@ -0,0 +1,184 @@
+#include "game_record.h"
+#include "game_codec.h"
+#include "move_table.h"
+#include <cerrno>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace {
+
+const char FILE_MAGIC[8]  = {'T', 'T', 'T', 'G', 'A', 'M', 'E', 'S'};
+const char INDEX_MAGIC[8] = {'T', 'T', 'T', 'I', 'N', 'D', 'E', 'X'};
+
+}
+
+void simulateGame(GameRecord& game, const MoveTables& tables) {
+  SeededRandom random(game.seed);
+  unsigned user = 0, computer = 0;
+  int toMove = game.first;
+  game.status    = IN_PROGRESS;
+  game.moveCount = 0;
+  while (game.status == IN_PROGRESS) {
+    // The tables are written for the computer; the user's side looks
+    // them up with the roles swapped
+    bool isUser = (toMove == USER);
+    int strategy = isUser ? game.userStrategy : game.computerStrategy;
+    int code = isUser ? bitboardCode(computer, user) : bitboardCode(user, computer);
+    int cell = (strategy == HUMAN) ? -1 : tables[strategy][code];
+    if (cell < 0) { cell = bitboardEmptyCell(user | computer, random.next()); }
+    (isUser ? user : computer) |= 1u << cell;
+    game.moves[game.moveCount++] = cell;
+    game.status = bitboardStatus(user, computer);
+    toMove = isUser ? COMPUTER : USER;
+  }
+}
+
+bool GameWriter::open(const char* path, const MoveTables* model) {
+  fd_ = ::open(path, O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+  if (fd_ < 0) { return false; }
+  model_ = model;
+  GameFileHeader header = {};
+  memcpy(header.magic, FILE_MAGIC, sizeof(header.magic));
+  header.version = GAME_FILE_VERSION;
+  header.model   = model ? modelHash(*model) : 0;
+  block_.reserve(BLOCK_BYTES);
+  if (model) { records_.reserve(CODED_BLOCK_GAMES); }
+  return writeAll(&header, sizeof(header));
+}
+
+bool GameWriter::writeAll(const void* data, size_t len) {
+  const char* p = static_cast<const char*>(data);
+  while (len > 0) {
+    ssize_t n = ::write(fd_, p, len);
+    if (n < 0 && errno == EINTR) { continue; }
+    if (n < 0) { return false; }
+    p += n;
+    len -= n;
+    offset_ += n;
+  }
+  return true;
+}
+
+bool GameWriter::flush() {
+  if (blockGames_ == 0) { return true; }
+  if (model_) {
+    block_.clear();
+    if (!compressGames(records_.data(), records_.size(), *model_, block_)) {
+      errno = EINVAL;
+      return false;
+    }
+    records_.clear();
+  }
+  index_.push_back(GameBlockIndex{offset_, games_});
+  uint32_t head[2] = {blockGames_, (uint32_t)block_.size()};
+  if (!writeAll(head, sizeof(head)) || !writeAll(block_.data(), block_.size())) { return false; }
+  games_ += blockGames_;
+  blockGames_ = 0;
+  block_.clear();
+  return true;
+}
+
+bool GameWriter::close() {
+  if (fd_ < 0) { return true; }
+  GameFileTrailer trailer = {};
+  bool ok = flush();
+  // Align the index, so that readers can use it in place
+  static const char padding[alignof(GameBlockIndex)] = {};
+  ok = ok && writeAll(padding, (alignof(GameBlockIndex) - offset_ % alignof(GameBlockIndex)) % alignof(GameBlockIndex));
+  trailer.indexOffset = offset_;
+  trailer.blocks      = index_.size();
+  trailer.games       = games_;
+  memcpy(trailer.magic, INDEX_MAGIC, sizeof(trailer.magic));
+  ok = ok && writeAll(index_.data(), index_.size() * sizeof(GameBlockIndex)) && writeAll(&trailer, sizeof(trailer));
+  int saved = errno;
+  if (::close(fd_) != 0) { ok = false; } else { errno = saved; }
+  fd_ = -1;
+  index_.clear();
+  return ok;
+}
+
+GameReader::~GameReader() {
+  if (data_) { munmap(const_cast<uint8_t*>(data_), size_); }
+}
+
+bool GameReader::open(const char* path, const MoveTables* model) {
+  int fd = ::open(path, O_RDONLY | O_CLOEXEC);
+  if (fd < 0) { return false; }
+  struct stat st;
+  if (fstat(fd, &st) < 0) {
+    int saved = errno;
+    ::close(fd);
+    errno = saved;
+    return false;
+  }
+  size_t size = st.st_size;
+  if (size < sizeof(GameFileHeader) + sizeof(GameFileTrailer)) {
+    ::close(fd);
+    errno = EINVAL;
+    return false;
+  }
+  void* mem = mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+  ::close(fd);
+  if (mem == MAP_FAILED) { return false; }
+  // Read front to back, so let the kernel read ahead
+  madvise(mem, size, MADV_SEQUENTIAL);
+  data_ = static_cast<const uint8_t*>(mem);
+  size_ = size;
+
+  GameFileHeader header;
+  GameFileTrailer trailer;
+  memcpy(&header, data_, sizeof(header));
+  memcpy(&trailer, data_ + size - sizeof(trailer), sizeof(trailer));
+  bool ok = memcmp(header.magic, FILE_MAGIC, sizeof(header.magic)) == 0 && header.version == GAME_FILE_VERSION &&
+            memcmp(trailer.magic, INDEX_MAGIC, sizeof(trailer.magic)) == 0 &&
+            trailer.indexOffset <= size - sizeof(trailer) &&
+            trailer.blocks == (size - sizeof(trailer) - trailer.indexOffset) / sizeof(GameBlockIndex) &&
+            trailer.indexOffset % alignof(GameBlockIndex) == 0 &&
+            (header.model == 0 || (model && modelHash(*model) == header.model));
+  if (!ok) {
+    errno = EINVAL;
+    return false;
+  }
+  index_  = reinterpret_cast<const GameBlockIndex*>(data_ + trailer.indexOffset);
+  blocks_ = trailer.blocks;
+  games_  = trailer.games;
+  model_  = header.model ? model : nullptr;
+  for (uint64_t block = 0; block < blocks_; block++) {
+    if (index_[block].offset + 8 > trailer.indexOffset) {
+      errno = EINVAL;
+      return false;
+    }
+  }
+  return true;
+}
+
+bool GameReader::game(uint64_t id, GameRecord& out) const {
+  if (id >= games_) { return false; }
+  // Last block starting at or before `id`
+  uint64_t low = 0, high = blocks_;
+  while (high - low > 1) {
+    uint64_t middle = (low + high) / 2;
+    if (index_[middle].firstGame <= id) { low = middle; } else { high = middle; }
+  }
+  uint64_t at = index_[low].firstGame;
+  bool found = false;
+  bool ok = forEachInBlock(low, [&](const GameRecord& game) {
+    if (at++ == id) {
+      out = game;
+      found = true;
+    }
+  });
+  return ok && found;
+}
+
+const GameRecord* GameReader::decodeBlock(const uint8_t* data, size_t bytes, uint32_t games) const {
+  // The count comes from the file: no writer fills a block past
+  // CODED_BLOCK_GAMES, and every game costs at least the five plain bits
+  // of its strategies and first mover
+  if (games > GameWriter::CODED_BLOCK_GAMES || uint64_t(games) * 5 > uint64_t(bytes) * 8) { return nullptr; }
+  thread_local std::vector<GameRecord> decoded;
+  decoded.resize(games);
+  return decompressGames(data, bytes, games, *model_, decoded.data()) ? decoded.data() : nullptr;
+}
@@ -0,0 +1,312 @@
+#ifndef TICTACTOE_GAME_RECORD_H
+#define TICTACTOE_GAME_RECORD_H
+
+#include "bitboard.h"
+#include "engine.h"
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <vector>
+
+struct MoveTables;
+
+/**
+ * Archive format for finished (or abandoned) games. A game is stored as
+ * a 6 byte header followed by its moves, two per byte:
+ *
+ *   byte 0     bits 0-3  number of moves (0..9)
+ *              bit  4    1 if the computer moved first
+ *              bits 5-6  result: 0 in progress, 1 user won,
+ *                        2 computer won, 3 draw
+ *   byte 1     bits 0-3  user's strategy (HUMAN if a person played)
+ *              bits 4-7  computer's strategy
+ *   bytes 2-5  seed of the game's random choices
+ *   then       moves, cell indices (row * 3 + col), move i in the low
+ *              nibble of byte i / 2 when i is even
+ *
+ * so a full game takes 11 bytes. Files hold games back to back in
+ * blocks of about BLOCK_BYTES, followed by an index of the blocks so
+ * that readers can skip to, or split the work by, block. All integers
+ * are little endian:
+ *
+ *   GameFileHeader
+ *   block:   uint32 games, uint32 bytes, then `bytes` of games
+ *   ...
+ *   padding to 8 bytes
+ *   index:   GameBlockIndex per block
+ *   GameFileTrailer
+ *
+ * A file can instead be written with the engine's move tables as the
+ * model (see game_codec.h): each block is then one compressed stream of
+ * CODED_BLOCK_GAMES games, and the header names the tables, which the
+ * reader must be given.
+ */
+
+enum {HUMAN = 0xF};
+
+/** One game, unpacked. */
+struct GameRecord {
+  uint32_t seed;
+  uint8_t  userStrategy;      // RANDOM, SMART, GENIOUS or HUMAN
+  uint8_t  computerStrategy;
+  uint8_t  first;             // USER or COMPUTER
+  uint8_t  status;            // IN_PROGRESS, USER_WON, COMPUTER_WON or DRAW
+  uint8_t  moveCount;
+  uint8_t  moves[9];          // cells, in the order they were claimed
+};
+
+struct GameFileHeader {
+  char     magic[8];          // "TTTGAMES"
+  uint32_t version;
+  uint32_t model;             // modelHash of the coding tables, 0 if plain
+};
+
+struct GameBlockIndex {
+  uint64_t offset;            // of the block in the file
+  uint64_t firstGame;         // number of games before it
+};
+
+struct GameFileTrailer {
+  uint64_t indexOffset;
+  uint64_t blocks;
+  uint64_t games;
+  char     magic[8];          // "TTTINDEX"
+};
+
+static const uint32_t GAME_FILE_VERSION = 1;
+static const size_t   GAME_HEADER_BYTES = 6;
+static const size_t   MAX_GAME_BYTES    = GAME_HEADER_BYTES + 5;
+
+/** Status from its 2-bit code in byte 0, and back. */
+inline int resultStatus(unsigned code) {
+  static const uint8_t STATUS[4] = {IN_PROGRESS, USER_WON, COMPUTER_WON, DRAW};
+  return STATUS[code & 3];
+}
+
+inline unsigned resultCode(int status) {
+  return (status == USER_WON) ? 1 : (status == COMPUTER_WON) ? 2 : (status == DRAW) ? 3 : 0;
+}
+
+/**
+ * Pack `game` at `out`, which must have MAX_GAME_BYTES of room.
+ *
+ * @return size_t  Bytes written
+ */
+inline size_t encodeGame(const GameRecord& game, uint8_t* out) {
+  out[0] = game.moveCount | ((game.first == COMPUTER) << 4) | (resultCode(game.status) << 5);
+  out[1] = game.userStrategy | (game.computerStrategy << 4);
+  out[2] = game.seed;
+  out[3] = game.seed >> 8;
+  out[4] = game.seed >> 16;
+  out[5] = game.seed >> 24;
+  size_t bytes = (game.moveCount + 1) / 2;
+  for (size_t i = 0; i < bytes; i++) {
+    unsigned high = (2 * i + 1 < game.moveCount) ? game.moves[2 * i + 1] : 0;
+    out[GAME_HEADER_BYTES + i] = game.moves[2 * i] | (high << 4);
+  }
+  return GAME_HEADER_BYTES + bytes;
+}
+
+/**
+ * Unpack the game at `in`, which must have MAX_GAME_BYTES readable. In a
+ * file that always holds, since the index and trailer follow the last
+ * block. A damaged header can give a move count of up to 15, in which
+ * case the size returned overstates the game; check `moveCount` before
+ * moving on to the next one.
+ *
+ * @return size_t  Bytes read
+ */
+inline size_t decodeGame(const uint8_t* in, GameRecord& game) {
+  game.moveCount        = in[0] & 0xF;
+  game.first            = (in[0] & 0x10) ? COMPUTER : USER;
+  game.status           = resultStatus(in[0] >> 5);
+  game.userStrategy     = in[1] & 0xF;
+  game.computerStrategy = in[1] >> 4;
+  game.seed             = in[2] | (in[3] << 8) | (in[4] << 16) | ((uint32_t)in[5] << 24);
+  // Unpack all five move bytes at once; nibbles past the last move are
+  // ignored
+  uint64_t packed = 0;
+  memcpy(&packed, in + GAME_HEADER_BYTES, 5);
+  for (int i = 0; i < 9; i++) { game.moves[i] = (packed >> (4 * i)) & 0xF; }
+  return GAME_HEADER_BYTES + (game.moveCount + 1) / 2;
+}
+
+/**
+ * Play `game`'s moves through the bitboard rules.
+ *
+ * @return int  The status after the last move, or -1 if there are more
+ *              than 9 moves, or a move is out of range, claims an owned
+ *              cell, or comes after the game ended
+ */
+inline int replayGame(const GameRecord& game) {
+  if (game.moveCount > 9) { return -1; }
+  unsigned boards[2] = {0, 0};   // of the player moving first, and second
+  int status = IN_PROGRESS;
+  for (int i = 0; i < game.moveCount; i++) {
+    unsigned cell = game.moves[i];
+    unsigned bit = 1u << cell;
+    if (cell > 8 || status != IN_PROGRESS || ((boards[0] | boards[1]) & bit)) { return -1; }
+    boards[i & 1] |= bit;
+    bool userFirst = (game.first == USER);
+    status = bitboardStatus(boards[userFirst ? 0 : 1], boards[userFirst ? 1 : 0]);
+  }
+  return status;
+}
+
+/**
+ * Play a whole game between two strategies, both drawn from `tables`,
+ * with random choices made from `game.seed`. Fills in `game.status`,
+ * `moveCount` and `moves` from the strategies and `first` already set.
+ */
+void simulateGame(GameRecord& game, const MoveTables& tables);
+
+/**
+ * Writes games to a file, a block at a time. Games must be written from
+ * one thread.
+ */
+class GameWriter {
+ public:
+  static const size_t BLOCK_BYTES       = 64 * 1024;
+  static const size_t CODED_BLOCK_GAMES = 16384;
+
+  GameWriter(): fd_(-1), model_(nullptr), blockGames_(0), games_(0), offset_(0) {}
+  ~GameWriter() { close(); }
+  GameWriter(const GameWriter&) = delete;
+  GameWriter& operator=(const GameWriter&) = delete;
+
+  /**
+   * Create `path`, compressed with `model` as the coding model if given,
+   * which must outlive the writer.
+   *
+   * @return bool  false (errno set) if `path` cannot be created
+   */
+  bool open(const char* path, const MoveTables* model = nullptr);
+
+  /**
+   * @return bool  false (errno set) if a full block could not be written,
+   *               or (EINVAL) a coded block holds a game whose result
+   *               does not follow from its moves
+   */
+  bool write(const GameRecord& game) {
+    if (model_) {
+      records_.push_back(game);
+      blockGames_++;
+      return records_.size() < CODED_BLOCK_GAMES || flush();
+    }
+    if (block_.size() + MAX_GAME_BYTES > BLOCK_BYTES && !flush()) { return false; }
+    size_t at = block_.size();
+    block_.resize(at + MAX_GAME_BYTES);
+    block_.resize(at + encodeGame(game, block_.data() + at));
+    blockGames_++;
+    return true;
+  }
+
+  /**
+   * Write the last block and the index, and close the file.
+   *
+   * @return bool  false (errno set) on failure
+   */
+  bool close();
+
+  uint64_t games() const { return games_ + blockGames_; }
+
+ private:
+  bool flush();
+  bool writeAll(const void* data, size_t len);
+
+  int                         fd_;
+  const MoveTables*           model_;
+  std::vector<GameRecord>     records_; // of the block being filled, when coded
+  std::vector<uint8_t>        block_;   // games of the block being filled
+  uint32_t                    blockGames_;
+  uint64_t                    games_;   // in blocks already written
+  uint64_t                    offset_;  // bytes written so far
+  std::vector<GameBlockIndex> index_;
+};
+
+/**
+ * Reads a file written by GameWriter through a read-only mapping,
+ * decoding straight from it. Safe to use from several threads at once,
+ * ex: one per range of blocks.
+ */
+class GameReader {
+ public:
+  GameReader(): data_(nullptr), size_(0), index_(nullptr), blocks_(0), games_(0), model_(nullptr) {}
+  ~GameReader();
+  GameReader(const GameReader&) = delete;
+  GameReader& operator=(const GameReader&) = delete;
+
+  /**
+   * Map `path`. A compressed file needs the tables it was written with as
+   * `model`, which must outlive the reader.
+   *
+   * @return bool  false (errno set) if `path` is not a valid game file, or
+   *               (EINVAL) is compressed with other tables than `model`
+   */
+  bool open(const char* path, const MoveTables* model = nullptr);
+
+  uint64_t games() const { return games_; }
+  uint64_t blocks() const { return blocks_; }
+
+  /** Number of games in blocks before `block`. */
+  uint64_t firstGame(uint64_t block) const { return index_[block].firstGame; }
+
+  /**
+   * Fetch game `id` (its number in the file), decoding its block up to it.
+   *
+   * @return bool  false if there is no such game, or its block is damaged
+   */
+  bool game(uint64_t id, GameRecord& out) const;
+
+  /**
+   * Call `f(const GameRecord&)` on every game of `block`, in order.
+   *
+   * @return bool  false if the block is damaged
+   */
+  template <typename F>
+  bool forEachInBlock(uint64_t block, F f) const {
+    const uint8_t* p = data_ + index_[block].offset;
+    uint32_t games, bytes;
+    memcpy(&games, p, 4);
+    memcpy(&bytes, p + 4, 4);
+    p += 8;
+    const uint8_t* end = p + bytes;
+    if (end > data_ + size_) { return false; }
+    if (model_) {
+      const GameRecord* decoded = decodeBlock(p, bytes, games);
+      if (!decoded) { return false; }
+      for (uint32_t i = 0; i < games; i++) { f(decoded[i]); }
+      return true;
+    }
+    GameRecord game;
+    for (uint32_t i = 0; i < games; i++) {
+      if (p >= end) { return false; }
+      p += decodeGame(p, game);
+      if (game.moveCount > 9) { return false; }
+      f(game);
+    }
+    return p == end;
+  }
+
+  /** Call `f(const GameRecord&)` on every game of the file, in order. */
+  template <typename F>
+  bool forEach(F f) const {
+    for (uint64_t block = 0; block < blocks_; block++) {
+      if (!forEachInBlock(block, f)) { return false; }
+    }
+    return true;
+  }
+
+ private:
+  /** Decompress a coded block into a per-thread buffer, nullptr if damaged. */
+  const GameRecord* decodeBlock(const uint8_t* data, size_t bytes, uint32_t games) const;
+
+  const uint8_t*        data_;
+  size_t                size_;
+  const GameBlockIndex* index_;
+  uint64_t              blocks_;
+  uint64_t              games_;
+  const MoveTables*     model_;
+};
+
+#endif
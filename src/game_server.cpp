@@ -0,0 +1,578 @@
+#include "game_server.h"
+#include "bitboard.h"
+#include "engine.h"
+#include "move_table.h"
+#include "opening_stats.h"
+#include "server.h"
+#include "session.h"
+#include "trace.h"
+#include <algorithm>
+#include <cerrno>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <deque>
+#include <mutex>
+#include <unordered_map>
+#include <vector>
+
+namespace {
+
+/**
+ * Serves the binary game protocol for one reactor, using that reactor's
+ * shard of the sessions.
+ *
+ * A request that needs a computer move gets its reply queued right away
+ * with the cell and status left blank, and its session added to a batch.
+ * The batch is computed when it is full and at the end of every event
+ * loop iteration, before the reactor writes any output. Computing the
+ * moves together lets the session loads and table lookups of one move
+ * overlap those of the next, instead of each request paying for its own
+ * cache misses. The strategy tables are read through `tableReader_`,
+ * one read-side section per batch, so they can be replaced while the
+ * server runs (see move_table.h).
+ *
+ * Handlers of the same server exchange `Note`s to run spectating: a
+ * handler with watchers of a session subscribes to the session's owner,
+ * and the owner sends it one event per move. Notes are collected during
+ * an iteration and handed over under a lock at its end, with one wakeup
+ * per destination reactor.
+ */
+class GameHandler : public Handler {
+ public:
+  GameHandler(int index, const GameServerOptions& options)
+    : sessions_(index), maxBatch_(options.maxBatch > 0 ? options.maxBatch : 1),
+      maxQueue_(options.maxQueue > 0 ? options.maxQueue : SIZE_MAX),
+      maxBulk_(options.maxBulk > 0 ? options.maxBulk : SIZE_MAX), taken_(0), bulkTaken_(0), random_(index),
+      server_(nullptr), index_(index), watcherCount_(0), droppedEvents_(0), tick_(0), openings_(openingStats()) {
+    batch_.reserve(maxBatch_);
+  }
+
+  ~GameHandler() {
+    for (Note& note : inbox_) { discard(note); }
+    for (std::vector<Note>& notes : outbox_) {
+      for (Note& note : notes) { discard(note); }
+    }
+  }
+
+  void onStart(Server& server, int index) {
+    server_ = &server;
+    index_  = index;
+    outbox_.resize(server.threads());
+  }
+
+  size_t onData(Connection& conn, const char* data, size_t len) {
+    size_t used = 0;
+    while (len - used >= sizeof(WireRequest) && conn.outSpace() >= sizeof(WireReply)) {
+      WireRequest req;
+      memcpy(&req, data + used, sizeof(req));
+      // Closing frees resources, so it is always let through
+      bool admitted = (req.op == OP_CLOSE);
+      bool bulk = (req.flags & REQUEST_BULK) && !admitted;
+      if (!admitted && taken_ >= maxQueue_) {
+        conn.paused = true;   // the iteration is full: leave the rest for the next one
+        break;
+      }
+      used += sizeof(req);
+
+      WireReply rep = {};
+      rep.op      = req.op;
+      rep.cell    = NO_CELL;
+      rep.session = req.session;
+      if (bulk && bulkTaken_ >= maxBulk_) {
+        rep.result = RESULT_BUSY;
+        conn.reply(&rep, sizeof(rep));
+        continue;
+      }
+      if (!admitted) { taken_++; }
+      if (bulk) { bulkTaken_++; }
+      bool pending = execute(conn, req, rep);
+      if (pending) { batch_.push_back(Pending{&conn, conn.outLen, rep.session, 0, 0, 0}); }
+      conn.reply(&rep, sizeof(rep));
+      if (batch_.size() >= maxBatch_) { runBatch(); }
+    }
+    return used;
+  }
+
+  void onTick() {
+    tick_++;
+    drainHeld();
+    receiveNotes();
+    runBatch();
+    sessions_.checkpoint();
+    openings_.merge();
+    taken_ = bulkTaken_ = 0;
+    sendNotes();
+  }
+
+  void onClose(Connection& conn) {
+    Watching* watching = static_cast<Watching*>(conn.user);
+    if (!watching) { return; }
+    if (!watching->held.empty()) {
+      for (SharedBuffer* event : watching->held) { event->release(); }
+      behind_.erase(std::find(behind_.begin(), behind_.end(), &conn));
+    }
+    for (uint32_t session : watching->sessions) {
+      Watched& watched = watchers_[session];
+      watched.conns.erase(std::find(watched.conns.begin(), watched.conns.end(), &conn));
+      watcherCount_--;
+      if (watched.conns.empty()) {
+        if (watched.latest) { watched.latest->release(); }
+        watchers_.erase(session);
+        post(SessionShard::shardOf(session), Note{NOTE_UNSUBSCRIBE, index_, session, nullptr});
+      }
+    }
+    delete watching;
+    conn.user = nullptr;
+  }
+
+  PoolStats sessionStats() const { return sessions_.stats(); }
+
+  /** Keep the sessions in `<path>.<index>`; see GameServerOptions::stateFile. */
+  bool open(const char* path) { return sessions_.open(path); }
+
+ private:
+  /** A computer move to make, and where its reply sits in `conn->out`. */
+  struct Pending {
+    Connection* conn;
+    size_t      offset;
+    uint32_t    session;
+    // Filled in by `runBatch`
+    uint16_t    user;       // bitboards of the position
+    uint16_t    computer;
+    int         code;       // its position code
+  };
+
+  enum {NOTE_SUBSCRIBE, NOTE_UNSUBSCRIBE, NOTE_EVENT};
+
+  /** Message between the handlers of a server. */
+  struct Note {
+    int           kind;
+    int           from;      // index of the sending handler
+    uint32_t      session;
+    SharedBuffer* event;     // NOTE_EVENT: a WireEvent, referenced by the note
+  };
+
+  /** Iterations a watcher may go without taking an event before it is cut off. */
+  static const uint64_t STALE_TICKS = 64;
+
+  /** `conn.user` of a connection watching sessions. */
+  struct Watching {
+    std::vector<uint32_t>     sessions;
+    std::deque<SharedBuffer*> held;        // events waiting for room in the shared queue
+    uint64_t                  heldSince = 0;   // last tick an event left `held`, while it is not empty
+  };
+
+  /** Our connections watching a session. */
+  struct Watched {
+    std::vector<Connection*> conns;
+    SharedBuffer*            latest = nullptr;   // newest event, the snapshot for watchers that join
+  };
+
+  /**
+   * Carry out `req`, filling in `rep`.
+   *
+   * @return bool  true if the reply still needs the computer's move
+   */
+  bool execute(Connection& conn, const WireRequest& req, WireReply& rep) {
+    switch (req.op) {
+      case OP_NEW: {
+        if (req.arg > GENIOUS) { rep.result = RESULT_BAD_REQUEST; return false; }
+        int first = (req.flags & NEW_COMPUTER_FIRST) ? COMPUTER : USER;
+        rep.session = sessions_.create(req.arg, first);
+        if (rep.session == SessionShard::NO_SESSION) { rep.result = RESULT_BUSY; return false; }
+        rep.status  = IN_PROGRESS;
+        return first == COMPUTER;
+      }
+      case OP_MOVE: {
+        Session* s = lookup(req.session);
+        if (!s) { rep.result = RESULT_NO_SESSION; return false; }
+        bool pending = false;
+        if (s->toMove != USER || !sessionLegal(*s, req.arg)) {
+          rep.result = RESULT_ILLEGAL_MOVE;
+        } else {
+          sessions_.logMove(req.session, *s, req.arg);
+          sessionClaim(*s, req.arg);
+          pending = (s->status == IN_PROGRESS);
+          if (!pending) { recordOpening(*s); }
+          if (watched(req.session)) { publish(req.session, *s, req.arg, 0); }
+        }
+        rep.status = s->status;
+        return pending;
+      }
+      case OP_CLOSE: {
+        Session* s = lookup(req.session);
+        if (!s) { rep.result = RESULT_NO_SESSION; return false; }
+        if (watched(req.session)) { publish(req.session, *s, NO_CELL, EVENT_CLOSED); }
+        sessions_.destroy(req.session);
+        return false;
+      }
+      case OP_STATS: {
+        PoolStats stats = sessions_.stats();
+        size_t value = (req.arg == STAT_LIVE_SESSIONS)    ? stats.live
+                     : (req.arg == STAT_SESSION_CAPACITY) ? stats.capacity
+                     : (req.arg == STAT_SESSION_BYTES)    ? stats.bytes
+                     : (req.arg == STAT_WATCHERS)         ? watcherCount_
+                     : (req.arg == STAT_DROPPED_EVENTS)   ? droppedEvents_
+                     :                                      0;
+        if (req.arg > STAT_DROPPED_EVENTS) { rep.result = RESULT_BAD_REQUEST; return false; }
+        rep.session = value > UINT32_MAX ? UINT32_MAX : value;
+        return false;
+      }
+      case OP_WATCH:
+        rep.result = watch(conn, req.session);
+        return false;
+      case OP_OPENING: {
+        unsigned user = 0, computer = 0;
+        for (int i = 0; i < 9; i++) {
+          unsigned owner = (req.session >> (2 * i)) & 3;
+          user |= (owner == 1) << i;
+          computer |= (owner == 2) << i;
+        }
+        // 2 bits a cell, and 3 is no owner
+        if (req.arg > OPENING_DRAW || (req.session >> 18) || (req.session & (req.session >> 1) & 0x15555)) {
+          rep.result = RESULT_BAD_REQUEST;
+          return false;
+        }
+        OpeningStats::Counts counts = openingStats().position(user, computer);
+        // OPENING_USER_WON... are the `resultCode`s of the statuses
+        uint64_t value = (req.arg == OPENING_GAMES) ? counts.games : counts.results[req.arg];
+        rep.session = value > UINT32_MAX ? UINT32_MAX : value;
+        return false;
+      }
+      default:
+        rep.result = RESULT_BAD_REQUEST;
+        return false;
+    }
+  }
+
+  /**
+   * `find`, but first completes the batch if the session is in it, so a
+   * request always sees the computer's pending reply already played.
+   */
+  Session* lookup(uint32_t id) {
+    Session* s = sessions_.find(id);
+    if (s && s->status == IN_PROGRESS && s->toMove == COMPUTER) { runBatch(); }
+    return s;
+  }
+
+  /**
+   * Make every pending computer move and patch the replies. Three passes
+   * over the batch, so that each pass issues its memory loads before
+   * the next one needs them:
+   *   1. prefetch the sessions
+   *   2. turn each board into bitboards and a position code, and prefetch
+   *      the strategy's table entry
+   *   3. play the move and fill in the reply
+   */
+  void runBatch() {
+    size_t n = batch_.size();
+    if (n == 0) { return; }
+
+    for (size_t i = 0; i < n; i++) {
+      __builtin_prefetch(sessions_.slot(batch_[i].session), 1);
+    }
+
+    MoveTableReader::Section section(tableReader_);
+    const MoveTables& tables = *moveTables();
+    for (size_t i = 0; i < n; i++) {
+      Pending& p = batch_[i];
+      const Session& s = *sessions_.slot(p.session);
+      p.user     = s.user;
+      p.computer = s.computer;
+      p.code     = bitboardCode(p.user, p.computer);
+      __builtin_prefetch(tables[s.strategy] + p.code);
+    }
+
+    for (size_t i = 0; i < n; i++) {
+      Pending& p = batch_[i];
+      Session& s = *sessions_.slot(p.session);
+      int cell = tables[s.strategy][p.code];
+      traceDecision(s.strategy, p.computer, p.user, cell);
+      // Same as `ai_random`: any empty cell, uniformly
+      if (cell < 0) { cell = bitboardEmptyCell(p.user | p.computer, random_.next()); }
+      sessions_.logMove(p.session, s, cell);
+      sessionClaim(s, cell);
+      if (s.status != IN_PROGRESS) { recordOpening(s); }
+      if (watched(p.session)) { publish(p.session, s, cell, 0); }
+
+      char* out = p.conn->out + p.offset;
+      out[offsetof(WireReply, cell)]   = cell;
+      out[offsetof(WireReply, status)] = s.status;
+    }
+    batch_.clear();
+  }
+
+  /** Count the finished game of `s` into the opening statistics. */
+  void recordOpening(const Session& s) {
+    int ply = sessionPly(s);
+    int plies = std::min(ply, openings_.plies());
+    uint8_t moves[9];
+    for (int i = 0; i < plies; i++) { moves[i] = sessionHistory(s, i); }
+    // The turn has passed to whoever would make move `ply`
+    int first = (ply % 2 == 0) ? (int)s.toMove : (s.toMove == USER) ? COMPUTER : USER;
+    openings_.record(first, moves, plies, s.status);
+  }
+
+  // ---- Spectating, owner side ----
+
+  bool watched(uint32_t id) const {
+    uint32_t slot = SessionShard::slotOf(id);
+    return slot / 64 < watchedSlots_.size() && (watchedSlots_[slot / 64] >> (slot % 64)) & 1;
+  }
+
+  void setWatched(uint32_t id, bool on) {
+    uint32_t slot = SessionShard::slotOf(id);
+    if (slot / 64 >= watchedSlots_.size()) { watchedSlots_.resize(slot / 64 + 1); }
+    uint64_t bit = uint64_t(1) << (slot % 64);
+    watchedSlots_[slot / 64] = on ? (watchedSlots_[slot / 64] | bit) : (watchedSlots_[slot / 64] & ~bit);
+  }
+
+  /** Encode the state of session `id` once and send it to its audience. */
+  void publish(uint32_t id, const Session& s, int cell, int flags) {
+    std::unordered_map<uint32_t, std::vector<int>>::iterator audience = audiences_.find(id);
+    if (audience == audiences_.end()) { return; }
+    SharedBuffer* event = encodeEvent(id, &s, cell, flags);
+    for (int handler : audience->second) {
+      event->retain();
+      post(handler, Note{NOTE_EVENT, index_, id, event});
+    }
+    event->release();
+    if (flags & EVENT_CLOSED) {
+      audiences_.erase(audience);
+      setWatched(id, false);
+    }
+  }
+
+  static SharedBuffer* encodeEvent(uint32_t id, const Session* s, int cell, int flags) {
+    WireEvent ev = {};
+    ev.op      = OP_EVENT;
+    ev.cell    = cell;
+    ev.session = id;
+    ev.flags   = flags;
+    if (s) {
+      ev.status = s->status;
+      ev.ply    = sessionPly(*s);
+      for (int i = 0; i < 9; i++) {
+        unsigned owner = ((s->user >> i) & 1) | (((s->computer >> i) & 1) << 1);
+        ev.board |= owner << (2 * i);
+      }
+    }
+    return SharedBuffer::create(&ev, sizeof(ev));
+  }
+
+  // ---- Spectating, watcher side ----
+
+  int watch(Connection& conn, uint32_t id) {
+    if (!server_) { return RESULT_BAD_REQUEST; }
+    int owner = SessionShard::shardOf(id);
+    if (owner >= server_->threads()) { return RESULT_NO_SESSION; }
+    Watching* watching = static_cast<Watching*>(conn.user);
+    if (!watching) { conn.user = watching = new Watching(); }
+    if (std::find(watching->sessions.begin(), watching->sessions.end(), id) != watching->sessions.end()) {
+      return RESULT_OK;
+    }
+    watching->sessions.push_back(id);
+    Watched& watched = watchers_[id];
+    watched.conns.push_back(&conn);
+    watcherCount_++;
+    // Only the first local watcher subscribes: the owner answers with a
+    // snapshot for all of them, and later ones start from the newest
+    // event, which carries the whole board
+    if (watched.latest) {
+      queueEvent(conn, watched.latest);
+    } else if (watched.conns.size() == 1) {
+      post(owner, Note{NOTE_SUBSCRIBE, index_, id, nullptr});
+    }
+    return RESULT_OK;
+  }
+
+  /**
+   * Queue `event` on `conn`. If its shared queue is full the event is held
+   * back, behind the events already held, until `drainHeld` finds room.
+   */
+  void queueEvent(Connection& conn, SharedBuffer* event) {
+    Watching& watching = *static_cast<Watching*>(conn.user);
+    if (!watching.held.empty() || !conn.share(event)) {
+      if (watching.held.empty()) {
+        watching.heldSince = tick_;
+        behind_.push_back(&conn);
+      }
+      event->retain();
+      watching.held.push_back(event);
+    }
+    server_->reactor(index_)->queueOutput(conn);
+  }
+
+  /** Queue `event` on every local watcher of `id`. */
+  void deliver(uint32_t id, SharedBuffer* event) {
+    std::unordered_map<uint32_t, Watched>::iterator it = watchers_.find(id);
+    if (it == watchers_.end()) { return; }
+    Watched& watched = it->second;
+    for (Connection* conn : watched.conns) {
+      if (!conn->dead) { queueEvent(*conn, event); }
+    }
+    if (watched.latest) { watched.latest->release(); }
+    watched.latest = nullptr;
+    const WireEvent* ev = reinterpret_cast<const WireEvent*>(event->data());
+    if (ev->flags & EVENT_CLOSED) {
+      for (Connection* conn : watched.conns) {
+        std::vector<uint32_t>& sessions = static_cast<Watching*>(conn->user)->sessions;
+        sessions.erase(std::find(sessions.begin(), sessions.end(), id));
+        watcherCount_--;
+      }
+      watchers_.erase(it);
+    } else {
+      event->retain();
+      watched.latest = event;
+    }
+  }
+
+  /**
+   * Move held events into the shared queues the last writes made room in.
+   * A watcher that has taken none for STALE_TICKS iterations is not keeping
+   * up: the events it has not started receiving are dropped, except the
+   * newest, which carries the whole board.
+   */
+  void drainHeld() {
+    size_t kept = 0;
+    for (Connection* conn : behind_) {
+      Watching& watching = *static_cast<Watching*>(conn->user);
+      std::deque<SharedBuffer*>& held = watching.held;
+      size_t before = held.size();
+      while (!held.empty() && conn->share(held.front())) {
+        held.front()->release();
+        held.pop_front();
+      }
+      if (held.size() < before) {
+        watching.heldSince = tick_;
+      } else if (tick_ - watching.heldSince >= STALE_TICKS) {
+        SharedBuffer* newest = held.back();
+        held.pop_back();
+        droppedEvents_ += conn->dropShared() + held.size();
+        for (SharedBuffer* event : held) { event->release(); }
+        held.clear();
+        // Still full if every queued event is already being written
+        if (!conn->share(newest)) { droppedEvents_++; }
+        newest->release();
+      }
+      if (!held.empty()) { behind_[kept++] = conn; }
+      server_->reactor(index_)->queueOutput(*conn);
+    }
+    behind_.resize(kept);
+  }
+
+  // ---- Notes between handlers ----
+
+  void post(int handler, const Note& note) { outbox_[handler].push_back(note); }
+
+  void apply(const Note& note) {
+    switch (note.kind) {
+      case NOTE_SUBSCRIBE: {
+        Session* s = sessions_.find(note.session);
+        if (!s) {
+          post(note.from, Note{NOTE_EVENT, index_, note.session, encodeEvent(note.session, nullptr, NO_CELL, EVENT_CLOSED)});
+          return;
+        }
+        std::vector<int>& audience = audiences_[note.session];
+        if (std::find(audience.begin(), audience.end(), note.from) == audience.end()) { audience.push_back(note.from); }
+        setWatched(note.session, true);
+        post(note.from, Note{NOTE_EVENT, index_, note.session, encodeEvent(note.session, s, NO_CELL, 0)});
+        return;
+      }
+      case NOTE_UNSUBSCRIBE: {
+        std::unordered_map<uint32_t, std::vector<int>>::iterator it = audiences_.find(note.session);
+        if (it == audiences_.end()) { return; }
+        std::vector<int>::iterator from = std::find(it->second.begin(), it->second.end(), note.from);
+        if (from != it->second.end()) { it->second.erase(from); }
+        if (it->second.empty()) {
+          audiences_.erase(it);
+          setWatched(note.session, false);
+        }
+        return;
+      }
+      case NOTE_EVENT:
+        deliver(note.session, note.event);
+        note.event->release();
+        return;
+    }
+  }
+
+  static void discard(Note& note) {
+    if (note.event) { note.event->release(); }
+  }
+
+  void receiveNotes() {
+    {
+      std::lock_guard<std::mutex> guard(inboxLock_);
+      if (inbox_.empty()) { return; }
+      received_.swap(inbox_);
+    }
+    for (const Note& note : received_) { apply(note); }
+    received_.clear();
+  }
+
+  void sendNotes() {
+    if (outbox_.empty()) { return; }
+    // Notes to ourselves can lead to more of them (a subscription is
+    // answered with a snapshot), so drain those first
+    std::vector<Note>& own = outbox_[index_];
+    while (!own.empty()) {
+      received_.swap(own);
+      for (const Note& note : received_) { apply(note); }
+      received_.clear();
+    }
+    for (int handler = 0; handler < (int)outbox_.size(); handler++) {
+      std::vector<Note>& notes = outbox_[handler];
+      if (handler == index_ || notes.empty()) { continue; }
+      GameHandler* peer = static_cast<GameHandler*>(server_->handler(handler));
+      {
+        std::lock_guard<std::mutex> guard(peer->inboxLock_);
+        peer->inbox_.insert(peer->inbox_.end(), notes.begin(), notes.end());
+      }
+      notes.clear();
+      server_->reactor(handler)->wake();
+    }
+  }
+
+  SessionShard         sessions_;
+  size_t               maxBatch_;
+  size_t               maxQueue_;
+  size_t               maxBulk_;
+  size_t               taken_;       // requests admitted this iteration
+  size_t               bulkTaken_;   // of which bulk
+  std::vector<Pending> batch_;
+  SeededRandom         random_;      // for the random moves of the batch
+  MoveTableReader      tableReader_;
+
+  // Spectating
+  Server*                                                server_;
+  int                                                    index_;
+  std::unordered_map<uint32_t, std::vector<int>>         audiences_;     // handlers watching our sessions
+  std::vector<uint64_t>                                  watchedSlots_;  // bit per session slot with an audience
+  std::unordered_map<uint32_t, Watched>                  watchers_;      // our connections watching a session
+  size_t                                                 watcherCount_;
+  size_t                                                 droppedEvents_;
+  uint64_t                                               tick_;          // onTick calls so far
+  std::vector<Connection*>                               behind_;        // watchers with held events
+  std::mutex                                             inboxLock_;
+  std::vector<Note>                                      inbox_;         // from other handlers, under inboxLock_
+  std::vector<Note>                                      received_;
+  std::vector<std::vector<Note>>                         outbox_;        // per destination handler
+  OpeningStats::Recorder                                 openings_;      // games that ended here
+};
+
+}
+
+Handler* makeGameHandler(int index, void* context) {
+  GameServerOptions defaults;
+  const GameServerOptions* options = context ? static_cast<const GameServerOptions*>(context) : &defaults;
+  GameHandler* handler = new GameHandler(index, *options);
+  if (options->stateFile && !handler->open(options->stateFile)) {
+    int saved = errno;
+    delete handler;
+    errno = saved;
+    return nullptr;
+  }
+  return handler;
+}
@@ -0,0 +1,133 @@
+#ifndef TICTACTOE_GAME_SERVER_H
+#define TICTACTOE_GAME_SERVER_H
+
+#include <cstddef>
+#include <cstdint>
+
+class Handler;
+
+/**
+ * Binary protocol spoken by `tictactoe --serve`. Requests and replies are
+ * fixed 8 byte records in host byte order (the server is meant for
+ * loopback and Unix socket clients). Any number of requests may be in
+ * flight; replies come back in request order.
+ *
+ *   OP_NEW    arg = strategy, flags = NEW_COMPUTER_FIRST or 0
+ *             -> session = new id; cell = computer's opening move
+ *   OP_MOVE   session, arg = cell claimed by the user
+ *             -> cell = computer's reply; status = game status
+ *   OP_CLOSE  session
+ *   OP_STATS  arg = STAT_LIVE_SESSIONS, STAT_SESSION_CAPACITY,
+ *             STAT_SESSION_BYTES, STAT_WATCHERS or STAT_DROPPED_EVENTS
+ *             -> session = that figure for this server thread
+ *   OP_WATCH  session
+ *             -> the connection starts receiving the session's events
+ *   OP_OPENING session = a board, as in WireEvent::board; arg =
+ *             OPENING_GAMES, OPENING_USER_WON, OPENING_COMPUTER_WON or
+ *             OPENING_DRAW
+ *             -> session = that count of the games finished on this
+ *             server through the position, if it is an opening (see
+ *             opening_stats.h)
+ *
+ * Any request may carry REQUEST_BULK in `flags` to mark it as part of a
+ * bulk job (simulations, analysis) rather than a game someone is
+ * watching; see "Admission control" below.
+ *
+ * `cell` is NO_CELL whenever the computer did not move. A session can
+ * only be played through the server thread that created it, so clients
+ * keep using the connection they opened it on.
+ *
+ * Spectators: any connection may watch any session with OP_WATCH. It is
+ * then sent a WireEvent (16 bytes, op OP_EVENT) with the current state of
+ * the game, then one for every move, until the session is closed (the
+ * last event has EVENT_CLOSED set). Events may arrive between replies;
+ * the op byte tells the two apart. Each event is encoded once by the
+ * thread that owns the session and handed, by reference, to the threads
+ * with watchers, which queue it on each watcher's connection. Every event
+ * carries the whole board, so a watcher that stops reading for a while
+ * has its queued events dropped and carries on from the newest one,
+ * seeing a jump in `ply` instead of holding up the server. A watcher that
+ * is only briefly behind gets every event.
+ *
+ * Computer moves are not computed as requests arrive: each server thread
+ * collects the sessions waiting for one during an event loop iteration
+ * and computes them together before the replies are written.
+ *
+ * Admission control: each server thread takes at most
+ * GameServerOptions::maxQueue requests per event loop iteration, so an
+ * iteration, and with it the latency of every request in it, stays
+ * bounded however much input is waiting. Interactive requests beyond
+ * that are left in the connection and served, in order, on a later
+ * iteration; TCP pushes back on their senders meanwhile. Bulk requests
+ * only get the first `maxBulk` places of an iteration and beyond that are
+ * answered RESULT_BUSY without being carried out, so that bulk clients
+ * back off instead of crowding out interactive ones.
+ *
+ * Warm restart: with GameServerOptions::stateFile set, each server thread
+ * keeps its sessions in a memory-mapped file (see session_store.h). A
+ * server restarted on the same files, with at least as many threads, has
+ * every game back at the same id and state, and clients reconnect and
+ * carry on. A move whose reply was lost to the restart has still been
+ * made; a computer move that was pending is made when the file is
+ * opened. OP_NEW is answered RESULT_BUSY if the thread's file is full.
+ *
+ * Opening statistics: every game that ends on the server is counted into
+ * `openingStats()` by its thread, which merges its counts at the end of
+ * each event loop iteration, so OP_OPENING answers, from any thread, are
+ * at most one iteration behind.
+ */
+enum {OP_NEW = 1, OP_MOVE = 2, OP_CLOSE = 3, OP_STATS = 4, OP_WATCH = 5, OP_EVENT = 6, OP_OPENING = 7};
+enum {NEW_COMPUTER_FIRST = 1, REQUEST_BULK = 0x80};
+enum {STAT_LIVE_SESSIONS = 0, STAT_SESSION_CAPACITY, STAT_SESSION_BYTES, STAT_WATCHERS, STAT_DROPPED_EVENTS};
+enum {OPENING_GAMES = 0, OPENING_USER_WON, OPENING_COMPUTER_WON, OPENING_DRAW};
+enum {RESULT_OK = 0, RESULT_BAD_REQUEST, RESULT_NO_SESSION, RESULT_ILLEGAL_MOVE, RESULT_BUSY};
+enum {NO_CELL = 0xFF};
+enum {EVENT_CLOSED = 1};
+
+struct WireRequest {
+  uint8_t  op;
+  uint8_t  arg;
+  uint8_t  flags;
+  uint8_t  reserved;
+  uint32_t session;
+};
+
+struct WireReply {
+  uint8_t  op;
+  uint8_t  result;
+  uint8_t  cell;
+  uint8_t  status;
+  uint32_t session;
+};
+
+/** A move (or the state) of a watched session. */
+struct WireEvent {
+  uint8_t  op;           // OP_EVENT
+  uint8_t  ply;          // cells claimed so far
+  uint8_t  cell;         // cell just claimed, or NO_CELL for a snapshot
+  uint8_t  status;       // game status
+  uint32_t session;
+  uint32_t board;        // cell i in bits 2i..2i+1: 0 empty, 1 user, 2 computer
+  uint8_t  flags;        // EVENT_CLOSED
+  uint8_t  reserved[3];
+};
+
+static_assert(sizeof(WireRequest) == 8 && sizeof(WireReply) == 8, "wire records are 8 bytes");
+static_assert(sizeof(WireEvent) == 16, "events are 16 bytes");
+
+/** Tuning of the game handler; pass a pointer as the factory context. */
+struct GameServerOptions {
+  size_t      maxBatch  = 64;      // computer moves collected before they are computed; 1 computes each at once
+  size_t      maxQueue  = 4096;    // requests taken per event loop iteration; 0 for no limit
+  size_t      maxBulk   = 1024;    // REQUEST_BULK requests taken per iteration, the rest are busy; 0 for no limit
+  const char* stateFile = nullptr; // keep sessions in <stateFile>.<thread> across restarts; nullptr for memory only
+};
+
+/**
+ * `HandlerFactory` creating the game protocol handler for one reactor.
+ * `context` points to GameServerOptions, or is nullptr for the defaults.
+ * Returns nullptr (errno set) if the state file cannot be used.
+ */
+Handler* makeGameHandler(int index, void* context);
+
+#endif
@@ -0,0 +1,71 @@
+#include "game_task.h"
+#include <new>
+
+namespace {
+
+const size_t FRAMES_PER_BLOCK = 64;
+
+struct FreeFrame { FreeFrame* next; };
+
+/**
+ * Per-thread free lists, one per size class. Frames are carved out of
+ * blocks of FRAMES_PER_BLOCK so they carry no allocator header; blocks
+ * are only returned to the system when the thread exits.
+ */
+struct PoolState {
+  FreeFrame*         free[FramePool::CLASSES] = {};
+  std::vector<void*> blocks;
+  size_t             bytes  = 0;
+  size_t             frames = 0;
+
+  ~PoolState() {
+    for (void* block : blocks) { ::operator delete(block); }
+  }
+
+  FreeFrame* refill(size_t c) {
+    size_t frameSize = c * FramePool::GRANULE;
+    char* block = static_cast<char*>(::operator new(frameSize * FRAMES_PER_BLOCK));
+    blocks.push_back(block);
+    for (size_t i = FRAMES_PER_BLOCK; i-- > 0; ) {
+      FreeFrame* f = reinterpret_cast<FreeFrame*>(block + i * frameSize);
+      f->next = free[c];
+      free[c] = f;
+    }
+    return free[c];
+  }
+};
+
+thread_local PoolState pool;
+
+size_t sizeClass(size_t size) { return (size + FramePool::GRANULE - 1) / FramePool::GRANULE; }
+
+}
+
+void* FramePool::allocate(size_t size) {
+  size_t c = sizeClass(size);
+  pool.bytes += size;
+  pool.frames++;
+  if (c >= CLASSES) { return ::operator new(size); }
+  FreeFrame* frame = pool.free[c] ? pool.free[c] : pool.refill(c);
+  pool.free[c] = frame->next;
+  return frame;
+}
+
+void FramePool::release(void* frame, size_t size) {
+  size_t c = sizeClass(size);
+  pool.bytes -= size;
+  pool.frames--;
+  if (c >= CLASSES) { ::operator delete(frame); return; }
+  FreeFrame* f = static_cast<FreeFrame*>(frame);
+  f->next = pool.free[c];
+  pool.free[c] = f;
+}
+
+size_t FramePool::bytesInUse()  { return pool.bytes; }
+size_t FramePool::framesInUse() { return pool.frames; }
+
+void Scheduler::run() {
+  // Resuming may post more handles, so walk by index
+  for (size_t i = 0; i < ready_.size(); i++) { ready_[i].resume(); }
+  ready_.clear();
+}
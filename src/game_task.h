@@ -0,0 +1,227 @@
+#ifndef TICTACTOE_GAME_TASK_H
+#define TICTACTOE_GAME_TASK_H
+
+#include "engine.h"
+#include "trace.h"
+#include <coroutine>
+#include <cstddef>
+#include <cstdint>
+#include <exception>
+#include <utility>
+#include <vector>
+
+/**
+ * Coroutine version of the game flow. A game is a `task<Outcome>` that
+ * suspends whenever it waits on a player, so one thread can keep any
+ * number of games going: the games that are waiting on remote input cost
+ * only their coroutine frame, and the `Scheduler` resumes each game when
+ * its move arrives.
+ */
+
+/**
+ * Free-list allocator for coroutine frames. Frames of a given coroutine
+ * always have the same size, so freed frames are kept per size class and
+ * handed straight back out. One pool per thread; a frame must be freed
+ * on the thread that allocated it.
+ */
+class FramePool {
+ public:
+  static const size_t GRANULE = 64;
+  static const size_t CLASSES = 32;   // frames up to 2 KiB are pooled
+
+  static void* allocate(size_t size);
+  static void  release(void* frame, size_t size);
+
+  /** Bytes currently handed out to live frames on this thread. */
+  static size_t bytesInUse();
+  /** Frames currently live on this thread. */
+  static size_t framesInUse();
+};
+
+/** How a game ended. */
+struct Outcome {
+  int status;       // USER_WON, COMPUTER_WON or DRAW
+  int moves;
+  int board[3][3];  // final position
+};
+
+/**
+ * Lazily started coroutine returning T. The owner starts it with
+ * `start()` (or by co_awaiting it from another coroutine) and reads
+ * `result()` once `done()`.
+ */
+template <typename T>
+class task {
+ public:
+  struct promise_type {
+    T                       value;
+    std::coroutine_handle<> continuation;
+
+    task get_return_object() { return task(std::coroutine_handle<promise_type>::from_promise(*this)); }
+    std::suspend_always initial_suspend() noexcept { return {}; }
+
+    struct FinalAwaiter {
+      bool await_ready() noexcept { return false; }
+      std::coroutine_handle<> await_suspend(std::coroutine_handle<promise_type> h) noexcept {
+        std::coroutine_handle<> next = h.promise().continuation;
+        return next ? next : std::noop_coroutine();
+      }
+      void await_resume() noexcept {}
+    };
+    FinalAwaiter final_suspend() noexcept { return {}; }
+
+    void return_value(T v) { value = std::move(v); }
+    void unhandled_exception() { std::terminate(); }
+
+    static void* operator new(size_t size) { return FramePool::allocate(size); }
+    static void  operator delete(void* frame, size_t size) { FramePool::release(frame, size); }
+  };
+
+  task(): handle_(nullptr) {}
+  task(task&& other) noexcept: handle_(std::exchange(other.handle_, nullptr)) {}
+  task& operator=(task&& other) noexcept {
+    if (this != &other) {
+      if (handle_) { handle_.destroy(); }
+      handle_ = std::exchange(other.handle_, nullptr);
+    }
+    return *this;
+  }
+  ~task() { if (handle_) { handle_.destroy(); } }
+
+  /** Run until the first suspension point. */
+  void start() { handle_.resume(); }
+  bool done() const { return handle_.done(); }
+  const T& result() const { return handle_.promise().value; }
+
+  // Awaiting a task starts it and resumes the awaiter when it finishes
+  bool await_ready() const { return false; }
+  std::coroutine_handle<> await_suspend(std::coroutine_handle<> awaiter) {
+    handle_.promise().continuation = awaiter;
+    return handle_;
+  }
+  const T& await_resume() const { return handle_.promise().value; }
+
+ private:
+  explicit task(std::coroutine_handle<promise_type> h): handle_(h) {}
+  std::coroutine_handle<promise_type> handle_;
+};
+
+/**
+ * Single-threaded run queue of suspended coroutines that are ready to
+ * continue. Resuming through the queue rather than directly keeps the
+ * stack flat when one game's progress unblocks another's.
+ */
+class Scheduler {
+ public:
+  void post(std::coroutine_handle<> h) { ready_.push_back(h); }
+
+  /** Resume ready coroutines until none are left. */
+  void run();
+
+ private:
+  std::vector<std::coroutine_handle<>> ready_;
+};
+
+/**
+ * A player whose moves are computed by one of the engine's strategies.
+ * The move is available immediately, so awaiting it never suspends.
+ */
+class ComputerPlayer {
+ public:
+  explicit ComputerPlayer(int strategy): strategy_(strategy) {}
+
+  struct Move {
+    int (*board)[3];
+    int player;
+    int strategy;
+    bool await_ready() const { return true; }
+    void await_suspend(std::coroutine_handle<>) {}
+    int await_resume() const {
+      Cell c = chooseMove(board, player, strategy);
+      return c.row * 3 + c.col;
+    }
+  };
+
+  Move nextMove(int board[][3], int player) { return Move{board, player, strategy_}; }
+
+ private:
+  int strategy_;
+};
+
+/**
+ * A player whose moves arrive from outside the game, e.g. from a network
+ * connection. Awaiting its move suspends the game until `deliver` is
+ * called; the game is then posted to the scheduler.
+ */
+class RemotePlayer {
+ public:
+  explicit RemotePlayer(Scheduler& scheduler)
+    : scheduler_(scheduler), waiting_(nullptr), board_(nullptr), cell_(-1) {}
+
+  struct Move {
+    RemotePlayer* p;
+    bool await_ready() const { return p->cell_ >= 0; }
+    void await_suspend(std::coroutine_handle<> h) { p->waiting_ = h; }
+    int await_resume() const { return std::exchange(p->cell_, -1); }
+  };
+
+  Move nextMove(int board[][3], int player) {
+    (void)player;
+    board_ = board;
+    return Move{this};
+  }
+
+  /** Whether the game is suspended waiting on this player. */
+  bool waiting() const { return bool(waiting_); }
+  /** The position the player is asked to move in (valid while waiting). */
+  int (*board() const)[3] { return board_; }
+
+  /** Hand over the next move, resuming the game if it is waiting on it. */
+  void deliver(int cell) {
+    cell_ = cell;
+    if (waiting_) { scheduler_.post(std::exchange(waiting_, nullptr)); }
+  }
+
+ private:
+  Scheduler&              scheduler_;
+  std::coroutine_handle<> waiting_;
+  int                   (*board_)[3];
+  int                     cell_;
+};
+
+/** Called before every move; the default does nothing. */
+struct NoTurnHook {
+  void operator()(int board[][3], int player) const { (void)board; (void)player; }
+};
+
+/**
+ * Play a complete game: the same flow as the interactive game in main(),
+ * with each player's move awaited instead of blocked on. Moves returned
+ * by the players are trusted to be legal.
+ *
+ * @param  UserPlayer     user      Plays as USER ('x')
+ * @param  ComputerPlayer computer  Plays as COMPUTER ('o')
+ * @param  int            first     Player to move first
+ * @param  TurnHook       onTurn    Called with the board and the player to move
+ * @return Outcome                  How the game ended
+ */
+template <typename UserPlayer, typename OpponentPlayer, typename TurnHook = NoTurnHook>
+task<Outcome> playGame(UserPlayer& user, OpponentPlayer& computer, int first, TurnHook onTurn = TurnHook()) {
+  Outcome outcome = {IN_PROGRESS, 0, {}};
+  int player = first;
+  uint32_t traced = traceGame(first);
+  while (outcome.status == IN_PROGRESS) {
+    onTurn(outcome.board, player);
+    int cell = (player == USER) ? co_await user.nextMove(outcome.board, USER)
+                                : co_await computer.nextMove(outcome.board, COMPUTER);
+    outcome.board[cell / 3][cell % 3] = player;
+    trace(TRACE_MOVE, player << 8 | cell);
+    outcome.moves++;
+    outcome.status = isGameOver(outcome.board);
+    player = (player == USER) ? COMPUTER : USER;
+  }
+  traceGameEnd(traced, outcome.status);
+  co_return outcome;
+}
+
+#endif
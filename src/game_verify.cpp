@@ -0,0 +1,81 @@
+#include "game_verify.h"
+#include <algorithm>
+#include <atomic>
+#include <thread>
+
+VerifyResult diagnoseGame(const GameRecord& game) {
+  unsigned boards[2] = {0, 0};
+  bool userFirst = (game.first == USER);
+  int status = IN_PROGRESS;
+  for (int i = 0; i < game.moveCount && i < 9; i++) {
+    unsigned cell = game.moves[i];
+    if (status != IN_PROGRESS) { return VerifyResult{i, VERIFY_MOVE_AFTER_END}; }
+    if (cell > 8) { return VerifyResult{i, VERIFY_BAD_CELL}; }
+    if ((boards[0] | boards[1]) & (1u << cell)) { return VerifyResult{i, VERIFY_CELL_TAKEN}; }
+    boards[i & 1] |= 1u << cell;
+    status = bitboardStatus(boards[userFirst ? 0 : 1], boards[userFirst ? 1 : 0]);
+  }
+  if (game.moveCount > 9) { return VerifyResult{9, VERIFY_TOO_MANY_MOVES}; }
+  if (game.first != USER && game.first != COMPUTER) { return VerifyResult{0, VERIFY_BAD_HEADER}; }
+  if (status != game.status) { return VerifyResult{game.moveCount, VERIFY_WRONG_RESULT}; }
+  return VerifyResult{-1, VERIFY_OK};
+}
+
+const char* verifyErrorName(int error) {
+  switch (error) {
+    case VERIFY_OK:             return "ok";
+    case VERIFY_BAD_CELL:       return "move outside the board";
+    case VERIFY_CELL_TAKEN:     return "cell already claimed";
+    case VERIFY_MOVE_AFTER_END: return "move after the game was decided";
+    case VERIFY_TOO_MANY_MOVES: return "more than 9 moves";
+    case VERIFY_BAD_HEADER:     return "no valid first mover";
+    case VERIFY_WRONG_RESULT:   return "result does not follow from the moves";
+    default:                    return "unknown error";
+  }
+}
+
+VerifyReport verifyGames(const GameReader& reader, int threads, size_t keep) {
+  if (threads < 1) { threads = 1; }
+  struct Partial {
+    uint64_t             games = 0;
+    uint64_t             bad = 0;
+    bool                 damaged = false;
+    std::vector<BadGame> first;
+  };
+  // Blocks are handed out one at a time, so threads that get quick
+  // blocks take more of them; a thread sees its blocks in file order, so
+  // its first `keep` bad games are the lowest ids it will find
+  std::atomic<uint64_t> nextBlock(0);
+  std::vector<Partial> partial(threads);
+  std::vector<std::thread> workers;
+  for (int t = 0; t < threads; t++) {
+    workers.emplace_back([&, t] {
+      Partial& mine = partial[t];
+      for (uint64_t block; (block = nextBlock.fetch_add(1, std::memory_order_relaxed)) < reader.blocks();) {
+        uint64_t id = reader.firstGame(block);
+        bool ok = reader.forEachInBlock(block, [&](const GameRecord& game) {
+          VerifyResult result = verifyGame(game);
+          if (result.error != VERIFY_OK) {
+            mine.bad++;
+            if (mine.first.size() < keep) { mine.first.push_back(BadGame{id, result}); }
+          }
+          id++;
+        });
+        mine.games += id - reader.firstGame(block);
+        mine.damaged |= !ok;
+      }
+    });
+  }
+  for (std::thread& worker : workers) { worker.join(); }
+
+  VerifyReport report = {0, 0, false, {}};
+  for (Partial& p : partial) {
+    report.games += p.games;
+    report.bad += p.bad;
+    report.damaged |= p.damaged;
+    report.first.insert(report.first.end(), p.first.begin(), p.first.end());
+  }
+  std::sort(report.first.begin(), report.first.end(), [](const BadGame& a, const BadGame& b) { return a.id < b.id; });
+  if (report.first.size() > keep) { report.first.resize(keep); }
+  return report;
+}
@@ -0,0 +1,82 @@
+#ifndef TICTACTOE_GAME_VERIFY_H
+#define TICTACTOE_GAME_VERIFY_H
+
+#include "bitboard.h"
+#include "game_record.h"
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+/**
+ * Checking games someone else recorded: every move legal, and the
+ * result the one the moves lead to. The common case, a good game, is
+ * settled in one pass over all 9 move slots with masks instead of
+ * branches, so that neither its length nor its moves cost
+ * mispredictions. A cell claimed twice leaves fewer cells than moves,
+ * and lines never go away, so a game went on past its end exactly when
+ * the position before its last move is already decided: only that
+ * position and the last one need the rules, not every ply.
+ * Only a game that fails is replayed move by move to find where.
+ */
+
+enum {
+  VERIFY_OK,
+  VERIFY_BAD_CELL,         // a move outside the board
+  VERIFY_CELL_TAKEN,       // a move onto a claimed cell
+  VERIFY_MOVE_AFTER_END,   // a move after the game was decided
+  VERIFY_TOO_MANY_MOVES,   // more than 9 moves
+  VERIFY_BAD_HEADER,       // first mover is neither USER nor COMPUTER
+  VERIFY_WRONG_RESULT      // moves fine, recorded status not what they lead to
+};
+
+struct VerifyResult {
+  int ply;      // first bad ply (move index), the move count for a wrong result; -1 if valid
+  int error;    // VERIFY_...
+};
+
+/** Find what is wrong with a game `verifyGame` rejected, move by move. */
+VerifyResult diagnoseGame(const GameRecord& game);
+
+/** Check `game`; see above. */
+inline VerifyResult verifyGame(const GameRecord& game) {
+  unsigned count = game.moveCount;
+  unsigned live = (1u << (count & 0xF)) - 1;   // more than 9 moves fails anyway
+  unsigned boards[2] = {0, 0};   // of the player moving first, and second
+  for (unsigned i = 0; i < 9; i++) { boards[i & 1] |= (1u << (game.moves[i] & 0xF)) & -((live >> i) & 1); }
+  unsigned cells = boards[0] | boards[1];
+  unsigned lastBit = (1u << (game.moves[(count + 8) % 9] & 0xF)) & -(unsigned)(count - 1 < 9);
+  boards[0] &= FULL_BOARD & ~lastBit;
+  boards[1] &= FULL_BOARD & ~lastBit;
+  unsigned decidedBefore = MASKS.hasLine[boards[0]] | MASKS.hasLine[boards[1]];
+  boards[(count + 1) & 1] |= lastBit & FULL_BOARD;
+  bool userFirst = (game.first == USER);
+  int status = bitboardStatus(boards[userFirst ? 0 : 1], boards[userFirst ? 1 : 0]);
+  bool bad = (cells & ~FULL_BOARD) | ((unsigned)__builtin_popcount(cells) != count) | decidedBefore | (count > 9)
+           | (game.first != USER && game.first != COMPUTER) | (status != game.status);
+  if (__builtin_expect(bad, 0)) { return diagnoseGame(game); }
+  return VerifyResult{-1, VERIFY_OK};
+}
+
+/** Text for a VERIFY_ error. */
+const char* verifyErrorName(int error);
+
+/** A game that failed verification. */
+struct BadGame {
+  uint64_t     id;       // number in the file
+  VerifyResult result;
+};
+
+struct VerifyReport {
+  uint64_t             games;
+  uint64_t             bad;
+  bool                 damaged;   // some blocks could not be read
+  std::vector<BadGame> first;     // the bad games with the lowest ids, in order
+};
+
+/**
+ * Verify every game of `reader`, with `threads` threads taking blocks in
+ * turn. Keeps the first `keep` bad games in the report.
+ */
+VerifyReport verifyGames(const GameReader& reader, int threads, size_t keep);
+
+#endif
@@ -0,0 +1,183 @@
+#include "http_server.h"
+#include "engine.h"
+#include "server.h"
+#include <cstdio>
+#include <cstring>
+#include <strings.h>
+
+namespace {
+
+// Longest reply we ever produce; requests wait until this much output space is free
+const size_t MAX_REPLY = 256;
+
+/**
+ * Find `needle` in [begin, end).
+ *
+ * @return const char*  Start of the match, or nullptr
+ */
+const char* find(const char* begin, const char* end, const char* needle) {
+  size_t n = strlen(needle);
+  for (const char* p = begin; p + n <= end; p++) {
+    p = static_cast<const char*>(memchr(p, needle[0], end - p));
+    if (!p || p + n > end) { return nullptr; }
+    if (memcmp(p, needle, n) == 0) { return p; }
+  }
+  return nullptr;
+}
+
+/**
+ * Value of query parameter `name` in [query, end), written as name=value.
+ *
+ * @return size_t  Length of the value, with `value` pointing at it; 0 if absent
+ */
+size_t queryParam(const char* query, const char* end, const char* name, const char*& value) {
+  size_t n = strlen(name);
+  const char* p = query;
+  while (p < end) {
+    const char* amp = static_cast<const char*>(memchr(p, '&', end - p));
+    const char* stop = amp ? amp : end;
+    if ((size_t)(stop - p) > n && memcmp(p, name, n) == 0 && p[n] == '=') {
+      value = p + n + 1;
+      return stop - value;
+    }
+    p = stop + 1;
+  }
+  return 0;
+}
+
+class HttpHandler : public Handler {
+ public:
+  size_t onData(Connection& conn, const char* data, size_t len) {
+    size_t used = 0;
+    while (!conn.closing && conn.outSpace() >= MAX_REPLY) {
+      const char* begin = data + used;
+      const char* end   = data + len;
+      const char* headEnd = find(begin, end, "\r\n\r\n");
+      if (!headEnd) {
+        if (len - used == Connection::BUFFER_SIZE) {
+          // The header block can never fit in the input buffer
+          respond(conn, "431 Request Header Fields Too Large", "too large\n", true);
+        }
+        break;
+      }
+      headEnd += 4;
+      used = headEnd - data;
+      request(conn, begin, headEnd);
+    }
+    return used;
+  }
+
+ private:
+  /** Answer the request whose header block is [begin, end). */
+  void request(Connection& conn, const char* begin, const char* end) {
+    const char* lineEnd = find(begin, end, "\r\n");
+    const char* sp1 = static_cast<const char*>(memchr(begin, ' ', lineEnd - begin));
+    const char* sp2 = sp1 ? static_cast<const char*>(memchr(sp1 + 1, ' ', lineEnd - sp1 - 1)) : nullptr;
+    if (!sp2) { respond(conn, "400 Bad Request", "bad request line\n", true); return; }
+
+    // HTTP/1.0 closes after each reply unless asked otherwise; 1.1 keeps the connection
+    bool http10 = (lineEnd - sp2 - 1 == 8) && memcmp(sp2 + 1, "HTTP/1.0", 8) == 0;
+    bool close  = http10 ? !hasHeader(lineEnd, end, "connection", "keep-alive")
+                         : hasHeader(lineEnd, end, "connection", "close");
+
+    if (sp1 - begin != 3 || memcmp(begin, "GET", 3) != 0) {
+      // We cannot skip over a request body, so the connection ends here
+      respond(conn, "405 Method Not Allowed", "only GET is supported\n", true, http10);
+      return;
+    }
+    const char* target = sp1 + 1;
+    const char* query  = static_cast<const char*>(memchr(target, '?', sp2 - target));
+    const char* path   = query ? query : sp2;
+    if (path - target != 5 || memcmp(target, "/move", 5) != 0) {
+      respond(conn, "404 Not Found", "not found\n", close, http10);
+      return;
+    }
+    if (!query) { respond(conn, "400 Bad Request", "missing board\n", close, http10); return; }
+    query++;
+
+    int board[3][3];
+    int player, strategy;
+    const char* error = parseQuery(query, sp2, board, player, strategy);
+    if (error) { respond(conn, "400 Bad Request", error, close, http10); return; }
+
+    char body[] = "none\n";
+    if (isGameOver(board) == IN_PROGRESS) {
+      Cell c = chooseMove(board, player, strategy);
+      body[0] = 'A' + c.col;
+      body[1] = '0' + c.row;
+      body[2] = '\n';
+      body[3] = '\0';
+    }
+    respond(conn, "200 OK", body, close, http10);
+  }
+
+  /**
+   * Decode the query string of a /move request.
+   *
+   * @return const char*  nullptr on success, otherwise the error message
+   */
+  const char* parseQuery(const char* query, const char* end, int board[][3], int& player, int& strategy) {
+    const char* value;
+    size_t n = queryParam(query, end, "board", value);
+    if (n != 9) { return "board must have 9 cells\n"; }
+    int xs = 0, os = 0;
+    for (int i = 0; i < 9; i++) {
+      switch (value[i]) {
+        case 'x': case 'X': board[i / 3][i % 3] = USER;     xs++; break;
+        case 'o': case 'O': board[i / 3][i % 3] = COMPUTER; os++; break;
+        case '.': case '-': case '_': board[i / 3][i % 3] = EMPTY; break;
+        default: return "board cells must be x, o or .\n";
+      }
+    }
+
+    strategy = GENIOUS;
+    n = queryParam(query, end, "strategy", value);
+    if (n) {
+      if (n != 1 || value[0] < '0' + RANDOM || value[0] > '0' + GENIOUS) { return "unknown strategy\n"; }
+      strategy = value[0] - '0';
+    }
+
+    player = (os < xs) ? COMPUTER : USER;
+    n = queryParam(query, end, "player", value);
+    if (n) {
+      if      (n == 1 && (value[0] | 0x20) == 'x') { player = USER; }
+      else if (n == 1 && (value[0] | 0x20) == 'o') { player = COMPUTER; }
+      else { return "player must be x or o\n"; }
+    }
+    return nullptr;
+  }
+
+  /** Whether header `name` is present with a value containing `token`. */
+  bool hasHeader(const char* begin, const char* end, const char* name, const char* token) {
+    size_t n = strlen(name), t = strlen(token);
+    for (const char* line = begin; line < end; ) {
+      const char* next = find(line, end, "\r\n");
+      if (!next) { break; }
+      if ((size_t)(next - line) > n && strncasecmp(line, name, n) == 0 && line[n] == ':') {
+        for (const char* p = line + n + 1; p + t <= next; p++) {
+          if (strncasecmp(p, token, t) == 0) { return true; }
+        }
+      }
+      line = next + 2;
+    }
+    return false;
+  }
+
+  void respond(Connection& conn, const char* status, const char* body, bool close, bool http10 = false) {
+    char reply[MAX_REPLY];
+    int n = snprintf(reply, sizeof(reply),
+                     "HTTP/1.%c %s\r\nContent-Type: text/plain\r\nContent-Length: %zu\r\n%s\r\n%s",
+                     http10 ? '0' : '1', status, strlen(body),
+                     close ? "Connection: close\r\n" : (http10 ? "Connection: keep-alive\r\n" : ""), body);
+    conn.reply(reply, n);
+    if (close) { conn.closing = true; }
+  }
+};
+
+}
+
+Handler* makeHttpHandler(int index, void* context) {
+  (void)index;
+  (void)context;
+  return new HttpHandler();
+}
@@ -0,0 +1,25 @@
+#ifndef TICTACTOE_HTTP_SERVER_H
+#define TICTACTOE_HTTP_SERVER_H
+
+class Handler;
+
+/**
+ * Stateless HTTP/1.1 move oracle served by `tictactoe --http`:
+ *
+ *   GET /move?board=<9 cells>[&strategy=<0|1|2>][&player=<x|o>]
+ *
+ * The board is given row by row, one character per cell: 'x' (USER),
+ * 'o' (COMPUTER) or '.' (empty). Without `player` the side with fewer
+ * marks moves, 'x' on a tie. The reply body is the chosen move followed
+ * by a newline, ex: "B1\n", or "none\n" if the game is already over.
+ *
+ * Connections are kept alive unless the client asks otherwise, and
+ * pipelined requests are answered in order. Requests are parsed in place
+ * in the connection's input buffer and replies are formatted straight
+ * into its output buffer, so serving a request allocates nothing.
+ */
+
+/** `HandlerFactory` creating the HTTP handler for one reactor. */
+Handler* makeHttpHandler(int index, void* context);
+
+#endif
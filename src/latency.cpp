@@ -0,0 +1,159 @@
+#include "latency.h"
+#include <cerrno>
+#include <csignal>
+#include <cstdio>
+#include <cstdlib>
+#include <pthread.h>
+#include <thread>
+#include <unistd.h>
+
+namespace latency_detail {
+std::atomic<bool> enabled(false);
+}
+
+namespace {
+
+// Exact up to 2^SUB_BITS ns, then 2^(SUB_BITS - 1) buckets per power of two
+const int SUB_BITS = 7;
+const int HALF = 1 << (SUB_BITS - 1);
+const int MAX_BIT = 47;   // about 39 hours; longer samples count as that
+const int BUCKETS = (1 << SUB_BITS) + (MAX_BIT - SUB_BITS + 1) * HALF;
+
+unsigned bucketOf(uint64_t nanos) {
+  int top = 63 - __builtin_clzll(nanos | 1);
+  if (top < SUB_BITS) { return nanos; }
+  if (top > MAX_BIT) {
+    top = MAX_BIT;
+    nanos = ~0ull >> (63 - MAX_BIT);
+  }
+  int shift = top - SUB_BITS + 1;
+  return (1 << SUB_BITS) + (top - SUB_BITS) * HALF + ((nanos >> shift) - HALF);
+}
+
+/** Largest value counted in `bucket`. */
+uint64_t bucketTop(unsigned bucket) {
+  if (bucket < (1u << SUB_BITS)) { return bucket; }
+  unsigned octave = (bucket - (1 << SUB_BITS)) / HALF, sub = (bucket - (1 << SUB_BITS)) % HALF;
+  int shift = octave + 1;
+  return ((uint64_t)(HALF + sub + 1) << shift) - 1;
+}
+
+/** One thread's counts; only that thread writes them. */
+struct ThreadBuckets {
+  std::atomic<uint64_t> counts[LATENCY_METRICS][BUCKETS];
+  std::atomic<uint64_t> sums[LATENCY_METRICS];
+  std::atomic<uint64_t> maxes[LATENCY_METRICS];
+  ThreadBuckets*        next;
+};
+
+std::atomic<ThreadBuckets*> allBuckets(nullptr);
+thread_local ThreadBuckets* myBuckets = nullptr;
+
+ThreadBuckets& buckets() {
+  if (!myBuckets) {
+    myBuckets = new ThreadBuckets();
+    myBuckets->next = allBuckets.load(std::memory_order_relaxed);
+    while (!allBuckets.compare_exchange_weak(myBuckets->next, myBuckets, std::memory_order_release)) {}
+  }
+  return *myBuckets;
+}
+
+// The single writer's increment: no read-modify-write needed
+inline void bump(std::atomic<uint64_t>& counter, uint64_t by) {
+  counter.store(counter.load(std::memory_order_relaxed) + by, std::memory_order_relaxed);
+}
+
+const char* const NAMES[LATENCY_METRICS] = {
+  "random_move", "smart_move", "genious_move", "user_move", "game_over", "render"
+};
+
+int dumpFd = -1;
+
+void dumpAtExit() { writeLatency(dumpFd); }
+
+}
+
+void enableLatency(bool on) { latency_detail::enabled.store(on, std::memory_order_relaxed); }
+
+void recordLatency(int metric, uint64_t nanos) {
+  if (metric < 0 || metric >= LATENCY_METRICS) { return; }
+  ThreadBuckets& mine = buckets();
+  bump(mine.counts[metric][bucketOf(nanos)], 1);
+  bump(mine.sums[metric], nanos);
+  if (nanos > mine.maxes[metric].load(std::memory_order_relaxed)) {
+    mine.maxes[metric].store(nanos, std::memory_order_relaxed);
+  }
+}
+
+LatencySummary latencySummary(int metric) {
+  LatencySummary summary = {};
+  if (metric < 0 || metric >= LATENCY_METRICS) { return summary; }
+  static thread_local uint64_t counts[BUCKETS];
+  uint64_t sum = 0;
+  for (unsigned b = 0; b < BUCKETS; b++) { counts[b] = 0; }
+  for (ThreadBuckets* t = allBuckets.load(std::memory_order_acquire); t; t = t->next) {
+    for (unsigned b = 0; b < BUCKETS; b++) {
+      uint64_t n = t->counts[metric][b].load(std::memory_order_relaxed);
+      counts[b] += n;
+      summary.count += n;
+    }
+    sum += t->sums[metric].load(std::memory_order_relaxed);
+    uint64_t max = t->maxes[metric].load(std::memory_order_relaxed);
+    summary.max = (max > summary.max) ? max : summary.max;
+  }
+  if (!summary.count) { return summary; }
+  summary.mean = double(sum) / summary.count;
+  // The smallest bucket top with at least the given share of samples at or below it
+  const double SHARES[5] = {0.5, 0.9, 0.99, 0.999, 0.9999};
+  uint64_t* targets[5] = {&summary.p50, &summary.p90, &summary.p99, &summary.p999, &summary.p9999};
+  uint64_t seen = 0;
+  int next = 0;
+  for (unsigned b = 0; b < BUCKETS && next < 5; b++) {
+    seen += counts[b];
+    while (next < 5 && seen >= SHARES[next] * summary.count) {
+      *targets[next++] = (bucketTop(b) < summary.max) ? bucketTop(b) : summary.max;
+    }
+  }
+  return summary;
+}
+
+const char* latencyName(int metric) {
+  return (metric >= 0 && metric < LATENCY_METRICS) ? NAMES[metric] : "unknown";
+}
+
+bool writeLatency(int fd) {
+  char text[LATENCY_METRICS * 256];
+  size_t used = 0;
+  for (int m = 0; m < LATENCY_METRICS; m++) {
+    LatencySummary s = latencySummary(m);
+    if (!s.count) { continue; }
+    used += snprintf(text + used, sizeof(text) - used,
+                     "latency %s count %llu mean %.0f p50 %llu p90 %llu p99 %llu p99.9 %llu p99.99 %llu max %llu\n",
+                     NAMES[m], (unsigned long long)s.count, s.mean, (unsigned long long)s.p50,
+                     (unsigned long long)s.p90, (unsigned long long)s.p99, (unsigned long long)s.p999,
+                     (unsigned long long)s.p9999, (unsigned long long)s.max);
+  }
+  for (size_t off = 0; off < used;) {
+    ssize_t n = write(fd, text + off, used - off);
+    if (n < 0 && errno == EINTR) { continue; }
+    if (n < 0) { return false; }
+    off += n;
+  }
+  return true;
+}
+
+void startLatencyDumps(int fd) {
+  enableLatency(true);
+  dumpFd = fd;
+  atexit(dumpAtExit);
+  sigset_t signals;
+  sigemptyset(&signals);
+  sigaddset(&signals, SIGUSR1);
+  pthread_sigmask(SIG_BLOCK, &signals, nullptr);
+  std::thread([signals] {
+    for (;;) {
+      int signal;
+      if (sigwait(&signals, &signal) == 0) { writeLatency(dumpFd); }
+    }
+  }).detach();
+}
@@ -0,0 +1,95 @@
+#ifndef TICTACTOE_LATENCY_H
+#define TICTACTOE_LATENCY_H
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+
+/**
+ * Latency histograms of the engine's per-move work: the computer's move
+ * by strategy (`nextComputerMove`), a person's move, `isGameOver` and
+ * `drawBoard`. Off until enabled, when a timed call costs one relaxed
+ * load more than before.
+ *
+ * Histograms are log-linear in the manner of HDR histograms: exact below
+ * 128 ns, then 64 buckets per power of two, so any value is reported
+ * within 1.6% whatever its size, from nanoseconds to hours, and the tail
+ * (p99.9 and beyond) is as sharp as the median. Each thread counts into
+ * buckets of its own, which only it writes, with plain relaxed stores
+ * and no locks; readers add the threads' buckets up, so a dump may miss
+ * the last few samples of a thread but never blocks one. A thread's
+ * buckets outlive it, with their counts.
+ */
+
+enum {
+  LATENCY_RANDOM_MOVE,    // nextComputerMove, by strategy
+  LATENCY_SMART_MOVE,
+  LATENCY_GENIOUS_MOVE,
+  LATENCY_USER_MOVE,      // a person choosing a move
+  LATENCY_GAME_OVER,      // isGameOver
+  LATENCY_RENDER,         // drawBoard
+  LATENCY_METRICS
+};
+
+namespace latency_detail {
+extern std::atomic<bool> enabled;
+}
+
+inline bool latencyEnabled() { return latency_detail::enabled.load(std::memory_order_relaxed); }
+
+/** Start or stop recording; samples recorded so far are kept. */
+void enableLatency(bool on);
+
+/** Count a sample of `metric`. */
+void recordLatency(int metric, uint64_t nanos);
+
+/** Times its own lifetime into `metric`, if recording is on. */
+class LatencyTimer {
+ public:
+  explicit LatencyTimer(int metric)
+    : metric_(latencyEnabled() ? metric : -1),
+      start_(metric_ >= 0 ? std::chrono::steady_clock::now() : std::chrono::steady_clock::time_point()) {}
+  ~LatencyTimer() {
+    if (metric_ < 0) { return; }
+    recordLatency(metric_, std::chrono::duration_cast<std::chrono::nanoseconds>(
+                             std::chrono::steady_clock::now() - start_).count());
+  }
+  LatencyTimer(const LatencyTimer&) = delete;
+  LatencyTimer& operator=(const LatencyTimer&) = delete;
+
+ private:
+  int                                   metric_;
+  std::chrono::steady_clock::time_point start_;
+};
+
+/** Samples of one metric over every thread. Values in nanoseconds. */
+struct LatencySummary {
+  uint64_t count;
+  double   mean;
+  uint64_t p50, p90, p99, p999, p9999;
+  uint64_t max;
+};
+
+LatencySummary latencySummary(int metric);
+
+/** Name of `metric` in dumps, ex: "genious_move". */
+const char* latencyName(int metric);
+
+/**
+ * Write a line per metric with samples, ex:
+ *
+ *   latency genious_move count 9 mean 812 p50 767 p90 1055 p99 1791 p99.9 1791 p99.99 1791 max 1786
+ *
+ * @return bool  false (errno set) if the write failed
+ */
+bool writeLatency(int fd);
+
+/**
+ * Enable recording and dump to `fd` at exit and whenever the process
+ * gets SIGUSR1. The signal is waited for by a thread of its own, so it
+ * must be blocked in every other thread: call this before any thread is
+ * started, as they inherit the mask.
+ */
+void startLatencyDumps(int fd);
+
+#endif
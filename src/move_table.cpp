@@ -0,0 +1,194 @@
+#include "move_table.h"
+#include <algorithm>
+#include <cerrno>
+#include <cstdio>
+#include <cstring>
+#include <mutex>
+#include <sched.h>
+#include <vector>
+
+/**
+ * Readers, and the versions retired while they might still use them.
+ * Sections record the epoch they start in; publishing a version bumps
+ * the epoch, so the version it replaced can be freed once no reader is
+ * in a section that started before the bump.
+ */
+class MoveTableRegistry {
+ public:
+  static MoveTableRegistry& get() {
+    static MoveTableRegistry registry;
+    return registry;
+  }
+
+  std::atomic<const MoveTables*> current;
+  std::atomic<uint64_t>          epoch;
+
+  void add(MoveTableReader* reader) {
+    std::lock_guard<std::mutex> guard(lock_);
+    readers_.push_back(reader);
+  }
+
+  void remove(MoveTableReader* reader) {
+    std::lock_guard<std::mutex> guard(lock_);
+    readers_.erase(std::find(readers_.begin(), readers_.end(), reader));
+  }
+
+  void retire(const MoveTables* tables, uint64_t epoch) {
+    std::lock_guard<std::mutex> guard(lock_);
+    retired_.push_back(Retired{tables, epoch});
+  }
+
+  size_t reclaim() {
+    std::lock_guard<std::mutex> guard(lock_);
+    // Oldest section still open: it may use any version retired when the
+    // epoch went past the one it started in, or later
+    uint64_t oldest = UINT64_MAX;
+    for (MoveTableReader* reader : readers_) {
+      uint64_t e = reader->epoch_.load(std::memory_order_seq_cst);
+      if (e != 0 && e < oldest) { oldest = e; }
+    }
+    size_t kept = 0;
+    for (Retired& r : retired_) {
+      if (r.epoch < oldest) {
+        if (r.tables != builtIn()) { delete r.tables; }
+      } else {
+        retired_[kept++] = r;
+      }
+    }
+    retired_.resize(kept);
+    return kept;
+  }
+
+  /** The version in use until the first publish. */
+  static const MoveTables* builtIn() {
+    static const MoveTables* tables = buildMoveTables();
+    return tables;
+  }
+
+ private:
+  /** A version replaced when the epoch went up from `epoch`. */
+  struct Retired {
+    const MoveTables* tables;
+    uint64_t          epoch;
+  };
+
+  MoveTableRegistry(): current(builtIn()), epoch(1) {}
+
+  std::mutex                    lock_;
+  std::vector<MoveTableReader*> readers_;
+  std::vector<Retired>          retired_;
+};
+
+MoveTableReader::MoveTableReader(): epoch_(0) {
+  MoveTableRegistry::get().add(this);
+}
+
+MoveTableReader::~MoveTableReader() {
+  MoveTableRegistry::get().remove(this);
+}
+
+MoveTableReader::Section::Section(MoveTableReader& reader): reader_(reader) {
+  // The store must be visible before the tables are loaded, or a
+  // publisher could miss this section and free what it is about to read
+  reader_.epoch_.store(MoveTableRegistry::get().epoch.load(std::memory_order_seq_cst), std::memory_order_seq_cst);
+}
+
+const MoveTables* moveTables() {
+  return MoveTableRegistry::get().current.load(std::memory_order_seq_cst);
+}
+
+MoveTables* buildMoveTables() {
+  MoveTables* tables = new MoveTables();
+  tables->version = 0;
+  for (int code = 0; code < POSITION_CODES; code++) {
+    int board[3][3];
+    decodeBoard(code, board);
+    Cell smart   = smartPreference(board);
+    Cell genious = geniousPreference(board);
+    tables->cells[RANDOM][code]  = -1;
+    tables->cells[SMART][code]   = (smart.row >= 0)   ? smart.row * 3 + smart.col     : -1;
+    tables->cells[GENIOUS][code] = (genious.row >= 0) ? genious.row * 3 + genious.col : -1;
+  }
+  return tables;
+}
+
+void publishMoveTables(MoveTables* tables) {
+  static std::atomic<uint64_t> versions(0);
+  MoveTableRegistry& registry = MoveTableRegistry::get();
+  tables->version = ++versions;
+  const MoveTables* old = registry.current.exchange(tables, std::memory_order_seq_cst);
+  // Sections starting from here on get the new version
+  uint64_t epoch = registry.epoch.fetch_add(1, std::memory_order_seq_cst);
+  registry.retire(old, epoch);
+}
+
+size_t reclaimMoveTables() {
+  return MoveTableRegistry::get().reclaim();
+}
+
+namespace {
+
+struct TableFileHeader {
+  char     magic[8];     // "TTTMOVES"
+  uint32_t strategies;   // GENIOUS + 1
+  uint32_t codes;        // POSITION_CODES
+};
+
+const char TABLE_MAGIC[8] = {'T', 'T', 'T', 'M', 'O', 'V', 'E', 'S'};
+
+const int LOAD_CHUNK = 2048;   // entries read and checked between yields
+
+/** Whether `cell` is -1 or an empty cell of position `code`. */
+bool legalEntry(int code, int cell) {
+  if (cell == -1) { return true; }
+  static const int POWERS[9] = {1, 3, 9, 27, 81, 243, 729, 2187, 6561};
+  return cell >= 0 && cell <= 8 && (code / POWERS[cell]) % 3 == 0;
+}
+
+}
+
+bool saveMoveTables(const char* path, const MoveTables& tables) {
+  FILE* file = fopen(path, "wb");
+  if (!file) { return false; }
+  TableFileHeader header;
+  memcpy(header.magic, TABLE_MAGIC, sizeof(header.magic));
+  header.strategies = GENIOUS + 1;
+  header.codes      = POSITION_CODES;
+  bool ok = fwrite(&header, sizeof(header), 1, file) == 1 &&
+            fwrite(tables.cells, sizeof(tables.cells), 1, file) == 1;
+  int saved = errno;
+  if (fclose(file) != 0) { ok = false; }
+  errno = saved;
+  return ok;
+}
+
+bool loadMoveTables(const char* path) {
+  FILE* file = fopen(path, "rb");
+  if (!file) { return false; }
+  MoveTables* tables = new MoveTables();
+  TableFileHeader header;
+  bool ok = fread(&header, sizeof(header), 1, file) == 1 &&
+            memcmp(header.magic, TABLE_MAGIC, sizeof(header.magic)) == 0 &&
+            header.strategies == GENIOUS + 1 && header.codes == POSITION_CODES;
+  // In chunks, giving the CPU up after each one: a reload runs next to
+  // the reactors and must not hold up the requests they are serving
+  for (int strategy = RANDOM; ok && strategy <= GENIOUS; strategy++) {
+    for (int start = 0; ok && start < POSITION_CODES; start += LOAD_CHUNK) {
+      int end = std::min(start + LOAD_CHUNK, (int)POSITION_CODES);
+      ok = fread(tables->cells[strategy] + start, end - start, 1, file) == 1;
+      for (int code = start; ok && code < end; code++) {
+        ok = legalEntry(code, tables->cells[strategy][code]);
+      }
+      sched_yield();
+    }
+  }
+  fclose(file);
+  if (!ok) {
+    delete tables;
+    errno = EINVAL;
+    return false;
+  }
+  publishMoveTables(tables);
+  reclaimMoveTables();
+  return true;
+}
@@ -0,0 +1,96 @@
+#ifndef TICTACTOE_MOVE_TABLE_H
+#define TICTACTOE_MOVE_TABLE_H
+
+#include "engine.h"
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+
+/**
+ * The deterministic part of each strategy (see `smartPreference` and
+ * `geniousPreference`) for every position code, precomputed so a move
+ * becomes one byte-sized lookup. Entries hold the cell the strategy
+ * claims, or -1 where it would pick a random cell (RANDOM has -1 for
+ * every position).
+ *
+ * The tables in use can be replaced at runtime, ex: with ones loaded
+ * from a file after they were regenerated, without stopping the threads
+ * that read them. Readers never lock: they load the current version
+ * inside a `MoveTableReader::Section` and must not keep it past the end
+ * of that section. A replaced version is freed once every section that
+ * could have seen it has ended (its grace period), by whoever calls
+ * `reclaimMoveTables`, normally the thread that replaced it.
+ */
+struct MoveTables {
+  uint64_t version;   // 0 for the built-in tables, then counts up
+  int8_t   cells[GENIOUS + 1][POSITION_CODES];
+
+  /** The entries of `strategy`, indexed by position code. */
+  const int8_t* operator[](int strategy) const {
+    return cells[(strategy >= RANDOM && strategy <= GENIOUS) ? strategy : RANDOM];
+  }
+};
+
+/** A thread that reads the move tables. Create one per thread. */
+class MoveTableReader {
+ public:
+  MoveTableReader();
+  ~MoveTableReader();
+  MoveTableReader(const MoveTableReader&) = delete;
+  MoveTableReader& operator=(const MoveTableReader&) = delete;
+
+  /** While one exists, `moveTables()` may be called and its result used. */
+  class Section {
+   public:
+    explicit Section(MoveTableReader& reader);
+    ~Section() { reader_.epoch_.store(0, std::memory_order_release); }
+
+   private:
+    MoveTableReader& reader_;
+  };
+
+ private:
+  friend class MoveTableRegistry;
+  // Epoch the open section started in, 0 when there is none
+  alignas(64) std::atomic<uint64_t> epoch_;
+};
+
+/** The tables in use; only within a `MoveTableReader::Section`. */
+const MoveTables* moveTables();
+
+/** Tables computed from the built-in strategies, in a new allocation. */
+MoveTables* buildMoveTables();
+
+/**
+ * Make `tables` the ones in use, taking ownership of them, and retire
+ * the previous version. Returns at once; readers see the new tables in
+ * their next section.
+ */
+void publishMoveTables(MoveTables* tables);
+
+/**
+ * Free the retired versions whose grace period is over.
+ *
+ * @return size_t  Versions still waiting for readers to move on
+ */
+size_t reclaimMoveTables();
+
+/**
+ * Write `tables` to `path`: a small header, then the entries of each
+ * strategy by position code.
+ *
+ * @return bool  false (errno set) on failure
+ */
+bool saveMoveTables(const char* path, const MoveTables& tables);
+
+/**
+ * Read tables written by `saveMoveTables`, check that every entry is a
+ * legal move (or -1), and publish them. The file is read and checked in
+ * chunks, yielding the CPU after each one.
+ *
+ * @return bool  false (errno set) if the file cannot be read or is
+ *               invalid; the tables in use are then left alone
+ */
+bool loadMoveTables(const char* path);
+
+#endif
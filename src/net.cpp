@@ -0,0 +1,102 @@
+#include "net.h"
+#include <arpa/inet.h>
+#include <cerrno>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <fcntl.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+using namespace std;
+
+namespace {
+
+/**
+ * Translate an address string into a sockaddr.
+ *
+ * @return bool  false (errno = EINVAL) if the address is malformed
+ */
+bool parseAddress(const string& address, sockaddr_storage& ss, socklen_t& len, int& family) {
+  memset(&ss, 0, sizeof(ss));
+  if (address.compare(0, 5, "unix:") == 0) {
+    sockaddr_un* un = reinterpret_cast<sockaddr_un*>(&ss);
+    string path = address.substr(5);
+    if (path.empty() || path.size() >= sizeof(un->sun_path)) { errno = EINVAL; return false; }
+    un->sun_family = AF_UNIX;
+    memcpy(un->sun_path, path.c_str(), path.size() + 1);
+    len = sizeof(sockaddr_un);
+    family = AF_UNIX;
+    return true;
+  }
+  if (address.compare(0, 4, "tcp:") == 0) {
+    size_t colon = address.rfind(':');
+    if (colon <= 4) { errno = EINVAL; return false; }
+    sockaddr_in* in = reinterpret_cast<sockaddr_in*>(&ss);
+    in->sin_family = AF_INET;
+    in->sin_port = htons(static_cast<uint16_t>(atoi(address.c_str() + colon + 1)));
+    if (inet_pton(AF_INET, address.substr(4, colon - 4).c_str(), &in->sin_addr) != 1) {
+      errno = EINVAL;
+      return false;
+    }
+    len = sizeof(sockaddr_in);
+    family = AF_INET;
+    return true;
+  }
+  errno = EINVAL;
+  return false;
+}
+
+}
+
+int setNonBlocking(int fd) {
+  int flags = fcntl(fd, F_GETFL, 0);
+  if (flags < 0) { return -1; }
+  return fcntl(fd, F_SETFL, flags | O_NONBLOCK);
+}
+
+int listenOn(const string& address) {
+  sockaddr_storage ss;
+  socklen_t len;
+  int family;
+  if (!parseAddress(address, ss, len, family)) { return -1; }
+
+  int fd = socket(family, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+  if (fd < 0) { return -1; }
+  if (family == AF_UNIX) {
+    unlink(reinterpret_cast<sockaddr_un*>(&ss)->sun_path);
+  } else {
+    int one = 1;
+    setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one));
+  }
+  if (bind(fd, reinterpret_cast<sockaddr*>(&ss), len) < 0 || listen(fd, SOMAXCONN) < 0) {
+    int saved = errno;
+    close(fd);
+    errno = saved;
+    return -1;
+  }
+  return fd;
+}
+
+int connectTo(const string& address) {
+  sockaddr_storage ss;
+  socklen_t len;
+  int family;
+  if (!parseAddress(address, ss, len, family)) { return -1; }
+
+  int fd = socket(family, SOCK_STREAM | SOCK_CLOEXEC, 0);
+  if (fd < 0) { return -1; }
+  if (connect(fd, reinterpret_cast<sockaddr*>(&ss), len) < 0) {
+    int saved = errno;
+    close(fd);
+    errno = saved;
+    return -1;
+  }
+  if (family == AF_INET) {
+    int one = 1;
+    setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+  }
+  return fd;
+}
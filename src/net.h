@@ -0,0 +1,34 @@
+#ifndef TICTACTOE_NET_H
+#define TICTACTOE_NET_H
+
+#include <string>
+
+/**
+ * Socket helpers shared by the servers and the load generators.
+ *
+ * Addresses are written as `tcp:<host>:<port>` or `unix:<path>`.
+ * All functions return -1 and leave errno set on failure.
+ */
+
+/**
+ * Create a non-blocking listening socket bound to `address`. A stale
+ * Unix socket file left behind by a previous run is removed first.
+ *
+ * @param  string address  Where to listen
+ * @return int             The listening descriptor
+ */
+int listenOn(const std::string& address);
+
+/**
+ * Open a blocking connection to `address`. TCP connections have Nagle's
+ * algorithm disabled since every request is latency sensitive.
+ *
+ * @param  string address  Where to connect
+ * @return int             The connected descriptor
+ */
+int connectTo(const std::string& address);
+
+/** Put `fd` into non-blocking mode. */
+int setNonBlocking(int fd);
+
+#endif
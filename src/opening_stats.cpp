@@ -0,0 +1,58 @@
+#include "opening_stats.h"
+#include <cstring>
+
+namespace {
+
+/** Number every position within `plies` moves of the start, either player first. */
+void numberPositions(unsigned mover, unsigned other, bool moverIsUser, int plies, int16_t* slotOf, size_t& positions) {
+  int code = moverIsUser ? canonicalCode(mover, other) : canonicalCode(other, mover);
+  if (slotOf[code] < 0) { slotOf[code] = positions++; }
+  if (plies == 0 || bitboardStatus(mover, other) != IN_PROGRESS) { return; }
+  for (unsigned empty = FULL_BOARD & ~(mover | other); empty; empty &= empty - 1) {
+    numberPositions(other, mover | (empty & -empty), !moverIsUser, plies - 1, slotOf, positions);
+  }
+}
+
+}
+
+OpeningStats::OpeningStats(int plies)
+  : plies_(plies < 0 ? 0 : plies > 9 ? 9 : plies), positions_(0), slotOf_(new int16_t[POSITION_CODES]) {
+  for (int code = 0; code < POSITION_CODES; code++) { slotOf_[code] = -1; }
+  numberPositions(0, 0, true, plies_, slotOf_.get(), positions_);
+  numberPositions(0, 0, false, plies_, slotOf_.get(), positions_);
+  counts_.reset(new std::atomic<uint64_t>[positions_ * 5]);
+  for (size_t i = 0; i < positions_ * 5; i++) { counts_[i].store(0, std::memory_order_relaxed); }
+}
+
+OpeningStats::Counts OpeningStats::position(unsigned user, unsigned computer) const {
+  Counts counts = {};
+  int slot = slotOf_[canonicalCode(user & FULL_BOARD, computer & FULL_BOARD)];
+  if (slot < 0) { return counts; }
+  const std::atomic<uint64_t>* c = &counts_[slot * 5];
+  counts.games = c[0].load(std::memory_order_relaxed);
+  for (int r = 0; r < 4; r++) { counts.results[r] = c[1 + r].load(std::memory_order_relaxed); }
+  return counts;
+}
+
+OpeningStats::Recorder::Recorder(OpeningStats& stats)
+  : stats_(stats), deltas_(stats.positions_ * 5), pending_(0) {
+  touched_.reserve(stats.positions_);
+}
+
+void OpeningStats::Recorder::merge() {
+  for (int slot : touched_) {
+    uint32_t* delta = &deltas_[slot * 5];
+    std::atomic<uint64_t>* c = &stats_.counts_[slot * 5];
+    for (int i = 0; i < 5; i++) {
+      if (delta[i]) { c[i].fetch_add(delta[i], std::memory_order_relaxed); }
+      delta[i] = 0;
+    }
+  }
+  touched_.clear();
+  pending_ = 0;
+}
+
+OpeningStats& openingStats() {
+  static OpeningStats* stats = new OpeningStats();
+  return *stats;
+}
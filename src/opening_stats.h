@@ -0,0 +1,119 @@
+#ifndef TICTACTOE_OPENING_STATS_H
+#define TICTACTOE_OPENING_STATS_H
+
+#include "bitboard.h"
+#include "game_record.h"
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+/**
+ * Live statistics of the openings: for every position of the first few
+ * plies, up to rotation and reflection (`canonicalCode`), the number of
+ * finished games through it and how they ended. Kept up to date as games
+ * end rather than computed from an archive.
+ *
+ * Positions are numbered once, at construction, so the counts are a
+ * flat array and a query is a table lookup and a few loads, whatever is
+ * being recorded meanwhile. Threads record through a `Recorder` of their
+ * own, which counts into a private delta buffer and adds it to the
+ * shared counts every MERGE_GAMES games, or when told to; so the shared
+ * counts only see one atomic add per position touched per merge. Each
+ * count is exact once the deltas holding it are merged, but a reader can
+ * see a merge half done, ex: a game in `games` but not yet in `results`.
+ */
+class OpeningStats {
+ public:
+  static const int DEFAULT_PLIES = 4;
+
+  /** Finished games through a position. */
+  struct Counts {
+    uint64_t games;
+    uint64_t results[4];    // by `resultCode`
+  };
+
+  /** Count the positions of the first `plies` plies (at most 9). */
+  explicit OpeningStats(int plies = DEFAULT_PLIES);
+  OpeningStats(const OpeningStats&) = delete;
+  OpeningStats& operator=(const OpeningStats&) = delete;
+
+  int plies() const { return plies_; }
+
+  /** Number of positions counted. */
+  size_t positions() const { return positions_; }
+
+  /**
+   * Counts of a position given as each player's cells; all zero if it is
+   * not one of the first `plies()` plies.
+   */
+  Counts position(unsigned user, unsigned computer) const;
+
+  /** One thread's way in. */
+  class Recorder {
+   public:
+    static const uint32_t MERGE_GAMES = 4096;
+
+    explicit Recorder(OpeningStats& stats);
+    ~Recorder() { merge(); }
+    Recorder(const Recorder&) = delete;
+    Recorder& operator=(const Recorder&) = delete;
+
+    /**
+     * Count a finished game.
+     *
+     * @param int            first   Player who moved first (USER or COMPUTER)
+     * @param const uint8_t* moves   Cells of its moves, at least the first `plies()`
+     *                               of them or all if fewer
+     * @param int            count   Number of moves in `moves`
+     * @param int            status  How it ended
+     */
+    void record(int first, const uint8_t* moves, int count, int status) {
+      const int16_t* slotOf = stats_.slotOf_.get();
+      unsigned boards[2] = {0, 0};   // of the player moving first, and second
+      unsigned& user = boards[first == USER ? 0 : 1];
+      unsigned& computer = boards[first == USER ? 1 : 0];
+      unsigned result = resultCode(status);
+      add(slotOf[canonicalCode(0, 0)], result);
+      int plies = (count < stats_.plies_) ? count : stats_.plies_;
+      for (int i = 0; i < plies; i++) {
+        if (moves[i] > 8 || ((boards[0] | boards[1]) >> moves[i]) & 1) { break; }
+        boards[i & 1] |= 1u << moves[i];
+        add(slotOf[canonicalCode(user, computer)], result);
+      }
+      if (++pending_ >= MERGE_GAMES) { merge(); }
+    }
+
+    void record(const GameRecord& game) { record(game.first, game.moves, game.moveCount, game.status); }
+
+    int plies() const { return stats_.plies_; }
+
+    /** Add the games recorded so far to the shared counts. */
+    void merge();
+
+   private:
+    void add(int slot, unsigned result) {
+      if (slot < 0) { return; }   // past the end of a game that broke the rules
+      uint32_t* delta = &deltas_[slot * 5];
+      if (delta[0]++ == 0) { touched_.push_back(slot); }
+      delta[1 + result]++;
+    }
+
+    OpeningStats&         stats_;
+    std::vector<uint32_t> deltas_;    // 5 per position: games, then results
+    std::vector<int>      touched_;   // positions with deltas
+    uint32_t              pending_;   // games since the last merge
+  };
+
+ private:
+  int                                    plies_;
+  size_t                                 positions_;
+  std::unique_ptr<int16_t[]>             slotOf_;   // canonical code -> position, -1 if not counted
+  std::unique_ptr<std::atomic<uint64_t>[]> counts_; // 5 per position, as in Recorder::deltas_
+};
+
+/** The statistics the game server records finished games into. */
+OpeningStats& openingStats();
+
+#endif
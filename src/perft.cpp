@@ -0,0 +1,127 @@
+#include "perft.h"
+#include "bitboard.h"
+#include "game_record.h"
+#include "trace.h"
+#include <atomic>
+#include <memory>
+#include <thread>
+#include <vector>
+
+namespace {
+
+// Depths above 9 count the same as 9
+const int MAX_DEPTH = 9;
+
+// Plies played by the calling thread before the rest is split up
+const int SPLIT_PLIES = 2;
+
+struct Node {
+  unsigned user;
+  unsigned computer;
+  bool     userToMove;
+  int      depth;
+};
+
+void add(PerftCounts& total, const PerftCounts& more) {
+  total.nodes += more.nodes;
+  total.leaves += more.leaves;
+  total.games += more.games;
+  for (int r = 0; r < 4; r++) { total.results[r] += more.results[r]; }
+}
+
+/**
+ * Counts of subtrees by position code. Within one count the depth left
+ * at a position follows from the number of cells taken, so the code is
+ * enough of a key.
+ */
+class SubtreeTable {
+ public:
+  SubtreeTable(): counts_(new PerftCounts[POSITION_CODES]()) {}
+
+  // nodes is never 0 once stored: the root of the subtree counts
+  PerftCounts& at(unsigned user, unsigned computer) { return counts_[bitboardCode(user, computer)]; }
+
+ private:
+  std::unique_ptr<PerftCounts[]> counts_;
+};
+
+/**
+ * Walk the tree below `node`, adding to `counts`. Positions with a
+ * result count as finished games whatever depth is left.
+ */
+void walk(const Node& node, PerftCounts& counts, SubtreeTable* table) {
+  counts.nodes++;
+  int status = bitboardStatus(node.user, node.computer);
+  if (status != IN_PROGRESS || node.depth == 0) {
+    counts.leaves += (node.depth == 0);
+    counts.games += (status != IN_PROGRESS);
+    counts.results[resultCode(status)] += (status != IN_PROGRESS);
+    return;
+  }
+  for (unsigned empty = FULL_BOARD & ~(node.user | node.computer); empty; empty &= empty - 1) {
+    unsigned bit = empty & -empty;
+    Node child = {node.user | (node.userToMove ? bit : 0), node.computer | (node.userToMove ? 0 : bit),
+                  !node.userToMove, node.depth - 1};
+    if (!table) {
+      walk(child, counts, nullptr);
+      continue;
+    }
+    PerftCounts& known = table->at(child.user, child.computer);
+    if (!known.nodes) { walk(child, known, table); }
+    add(counts, known);
+  }
+}
+
+/**
+ * Walk the first `plies` plies of the tree below `node` into `counts`,
+ * leaving the nodes below them in `tasks` instead.
+ */
+void split(const Node& node, int plies, PerftCounts& counts, std::vector<Node>& tasks) {
+  int status = bitboardStatus(node.user, node.computer);
+  if (plies == 0 && status == IN_PROGRESS && node.depth > 0) {
+    tasks.push_back(node);
+    return;
+  }
+  if (status != IN_PROGRESS || node.depth == 0) {
+    walk(node, counts, nullptr);
+    return;
+  }
+  counts.nodes++;
+  for (unsigned empty = FULL_BOARD & ~(node.user | node.computer); empty; empty &= empty - 1) {
+    unsigned bit = empty & -empty;
+    split(Node{node.user | (node.userToMove ? bit : 0), node.computer | (node.userToMove ? 0 : bit),
+               !node.userToMove, node.depth - 1},
+          plies - 1, counts, tasks);
+  }
+}
+
+}
+
+PerftCounts perft(unsigned user, unsigned computer, int toMove, int depth, int threads, bool hashed) {
+  Node root = {user & FULL_BOARD, computer & FULL_BOARD, toMove == USER, (depth < MAX_DEPTH) ? depth : MAX_DEPTH};
+  if (root.depth < 0) { root.depth = 0; }
+  if (threads < 1) { threads = 1; }
+  PerftCounts total = {};
+  std::vector<Node> tasks;
+  split(root, (threads > 1) ? SPLIT_PLIES : 0, total, tasks);
+  if ((size_t)threads > tasks.size()) { threads = tasks.size() ? tasks.size() : 1; }
+
+  // Tasks are taken in turn, so a thread that gets small subtrees takes more
+  std::atomic<size_t> next(0);
+  std::vector<PerftCounts> partial(threads, PerftCounts{});
+  std::vector<std::thread> workers;
+  auto work = [&](int t) {
+    std::unique_ptr<SubtreeTable> table(hashed ? new SubtreeTable() : nullptr);
+    PerftCounts counts = {};
+    for (size_t task; (task = next.fetch_add(1, std::memory_order_relaxed)) < tasks.size();) {
+      TraceSpan span(task);
+      walk(tasks[task], counts, table.get());
+    }
+    partial[t] = counts;
+  };
+  for (int t = 1; t < threads; t++) { workers.emplace_back(work, t); }
+  work(0);
+  for (std::thread& worker : workers) { worker.join(); }
+  for (const PerftCounts& p : partial) { add(total, p); }
+  return total;
+}
@@ -0,0 +1,38 @@
+#ifndef TICTACTOE_PERFT_H
+#define TICTACTOE_PERFT_H
+
+#include <cstdint>
+
+/**
+ * Game-tree counting in the manner of a chess engine's perft: every move
+ * sequence from a position, played with the bitboard rules (see
+ * bitboard.h), counted rather than searched. From the empty board the
+ * totals are known (255168 games, 127872 of them lasting all 9 moves),
+ * so they check move generation and win detection, and the rate at
+ * which nodes are visited is a raw measure of the rules' speed.
+ *
+ * The tree can be split between threads a few plies down, and with
+ * `hashed` each thread keeps the counts of every subtree it finished by
+ * position and remaining depth, so a position reached again by another
+ * move order is added in bulk instead of walked. The counts are the same
+ * either way.
+ */
+
+struct PerftCounts {
+  uint64_t nodes;        // positions visited, the root included
+  uint64_t leaves;       // sequences of exactly `depth` moves
+  uint64_t games;        // sequences that end the game within `depth` moves
+  uint64_t results[4];   // those games by `resultCode`
+};
+
+/**
+ * Count the tree below a position given as each player's cells.
+ *
+ * @param int  toMove   USER or COMPUTER
+ * @param int  depth    Moves to look ahead (at most 9 matter)
+ * @param int  threads  Threads to split the tree between
+ * @param bool hashed   Add up repeated subtrees from a table
+ */
+PerftCounts perft(unsigned user, unsigned computer, int toMove, int depth, int threads = 1, bool hashed = false);
+
+#endif
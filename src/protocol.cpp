@@ -0,0 +1,293 @@
+#include "protocol.h"
+#include "engine.h"
+#include "perft.h"
+#include <cerrno>
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <unistd.h>
+
+namespace {
+
+/**
+ * Output side of the protocol. Responses are collected in a fixed buffer
+ * and only handed to the kernel when it fills up or when the reader is
+ * about to block, which keeps the cost per response to a memcpy.
+ */
+class Writer {
+ public:
+  explicit Writer(int fd): fd_(fd), used_(0), failed_(false) {}
+
+  void put(const char* text, size_t len) {
+    if (used_ + len > sizeof(buf_)) { flush(); }
+    memcpy(buf_ + used_, text, len);
+    used_ += len;
+  }
+  void put(const char* text) { put(text, strlen(text)); }
+
+  void flush() {
+    size_t off = 0;
+    while (off < used_ && !failed_) {
+      ssize_t n = write(fd_, buf_ + off, used_ - off);
+      if (n < 0 && errno == EINTR) { continue; }
+      if (n <= 0) { failed_ = true; break; }
+      off += n;
+    }
+    used_ = 0;
+  }
+
+  bool failed() const { return failed_; }
+
+ private:
+  int    fd_;
+  size_t used_;
+  bool   failed_;
+  char   buf_[64 * 1024];
+};
+
+/**
+ * State of the position being analysed; mirrors the state main() keeps
+ * for the interactive game.
+ */
+struct Position {
+  int board[3][3];
+  int toMove;
+  int status;
+  int strategy;
+};
+
+void resetPosition(Position& pos, int first) {
+  memset(pos.board, 0, sizeof(pos.board));
+  pos.toMove = first;
+  pos.status = IN_PROGRESS;
+}
+
+// Token helpers: `line` is not NUL terminated, so tokens are [begin, end)
+bool nextToken(const char*& cur, const char* end, const char*& tok, size_t& len) {
+  while (cur < end && (*cur == ' ' || *cur == '\t' || *cur == '\r')) { cur++; }
+  tok = cur;
+  while (cur < end && *cur != ' ' && *cur != '\t' && *cur != '\r') { cur++; }
+  len = cur - tok;
+  return len > 0;
+}
+
+bool tokenIs(const char* tok, size_t len, const char* word) {
+  return strlen(word) == len && memcmp(tok, word, len) == 0;
+}
+
+/**
+ * Parse a move such as "B1" (column letter, row digit) into a cell.
+ *
+ * @return bool  false if the token is not a cell on the board
+ */
+bool parseMove(const char* tok, size_t len, int& row, int& col) {
+  if (len != 2) { return false; }
+  char c = tok[0] | 0x20;  // lower-case the column letter
+  if (c < 'a' || c > 'c' || tok[1] < '0' || tok[1] > '2') { return false; }
+  col = c - 'a';
+  row = tok[1] - '0';
+  return true;
+}
+
+/**
+ * Parse a small decimal count.
+ *
+ * @return bool  false if the token is not one, or over 9999
+ */
+bool parseCount(const char* tok, size_t len, int& value) {
+  if (len == 0 || len > 4) { return false; }
+  value = 0;
+  for (size_t i = 0; i < len; i++) {
+    if (tok[i] < '0' || tok[i] > '9') { return false; }
+    value = value * 10 + (tok[i] - '0');
+  }
+  return true;
+}
+
+void putError(Writer& out, const char* what, const char* tok, size_t len) {
+  out.put("error ");
+  out.put(what);
+  if (len) { out.put(" "); out.put(tok, len); }
+  out.put("\n");
+}
+
+/** Set up `pos` as the command says; on an error `pos` is left as it was. */
+void cmdPosition(Position& pos, const char* cur, const char* end, Writer& out) {
+  const char* tok;
+  size_t len;
+  Position next = pos;
+  resetPosition(next, USER);
+  bool anyMoves = false;
+  while (nextToken(cur, end, tok, len)) {
+    int row, col;
+    if (tokenIs(tok, len, "startpos") || tokenIs(tok, len, "moves")) { continue; }
+    if (!anyMoves && tokenIs(tok, len, "user"))     { next.toMove = USER;     continue; }
+    if (!anyMoves && tokenIs(tok, len, "computer")) { next.toMove = COMPUTER; continue; }
+    if (!parseMove(tok, len, row, col)) { putError(out, "bad move", tok, len); return; }
+    if (next.status != IN_PROGRESS || next.board[row][col] != EMPTY) {
+      putError(out, "illegal move", tok, len);
+      return;
+    }
+    anyMoves = true;
+    next.board[row][col] = next.toMove;
+    next.status = isGameOver(next.board);
+    next.toMove = (next.toMove == USER) ? COMPUTER : USER;
+  }
+  pos = next;
+}
+
+void cmdGo(Position& pos, Writer& out) {
+  // All strategies answer in constant time, so `movetime` is accepted
+  // for compatibility but has nothing to limit.
+  if (pos.status != IN_PROGRESS) { out.put("bestmove none\n"); return; }
+  Cell c = chooseMove(pos.board, pos.toMove, pos.strategy);
+  char reply[] = "bestmove A0\n";
+  reply[9]  = 'A' + c.col;
+  reply[10] = '0' + c.row;
+  out.put(reply, sizeof(reply) - 1);
+}
+
+void cmdStatus(const Position& pos, Writer& out) {
+  switch (pos.status) {
+    case USER_WON:     out.put("status user_won\n");     break;
+    case COMPUTER_WON: out.put("status computer_won\n"); break;
+    case DRAW:         out.put("status draw\n");         break;
+    default:           out.put("status in_progress\n");  break;
+  }
+}
+
+void cmdPerft(const Position& pos, const char* cur, const char* end, Writer& out) {
+  const char* tok;
+  size_t len;
+  int depth, threads = 1;
+  if (!nextToken(cur, end, tok, len) || !parseCount(tok, len, depth)) {
+    putError(out, "bad depth", tok, len);
+    return;
+  }
+  bool hashed = false;
+  while (nextToken(cur, end, tok, len)) {
+    const char* arg;
+    size_t argLen;
+    if (tokenIs(tok, len, "hash")) {
+      hashed = true;
+    } else if (!tokenIs(tok, len, "threads") || !nextToken(cur, end, arg, argLen) || !parseCount(arg, argLen, threads)
+               || threads == 0) {
+      putError(out, "bad perft option", tok, len);
+      return;
+    }
+  }
+  unsigned user = 0, computer = 0;
+  for (int cell = 0; cell < 9; cell++) {
+    int v = pos.board[cell / 3][cell % 3];
+    user |= (v == USER) << cell;
+    computer |= (v == COMPUTER) << cell;
+  }
+  std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+  PerftCounts counts = perft(user, computer, pos.toMove, depth, threads, hashed);
+  double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+  char reply[256];
+  int n = snprintf(reply, sizeof(reply),
+                   "perft depth %d nodes %llu leaves %llu games %llu user_won %llu computer_won %llu draw %llu"
+                   " time %.0f nps %.0f\n",
+                   depth, (unsigned long long)counts.nodes, (unsigned long long)counts.leaves,
+                   (unsigned long long)counts.games, (unsigned long long)counts.results[1],
+                   (unsigned long long)counts.results[2], (unsigned long long)counts.results[3], seconds * 1000,
+                   counts.nodes / (seconds > 0 ? seconds : 1e-9));
+  out.put(reply, n);
+}
+
+/**
+ * Execute a single request line.
+ *
+ * @return bool  false once the client asked to quit
+ */
+bool dispatch(Position& pos, const char* cur, const char* end, Writer& out) {
+  const char* tok;
+  size_t len;
+  if (!nextToken(cur, end, tok, len)) { return true; }  // blank line
+
+  if (tokenIs(tok, len, "go")) {
+    cmdGo(pos, out);
+  } else if (tokenIs(tok, len, "position")) {
+    cmdPosition(pos, cur, end, out);
+  } else if (tokenIs(tok, len, "isready")) {
+    out.put("readyok\n");
+  } else if (tokenIs(tok, len, "perft")) {
+    cmdPerft(pos, cur, end, out);
+  } else if (tokenIs(tok, len, "status")) {
+    cmdStatus(pos, out);
+  } else if (tokenIs(tok, len, "strategy")) {
+    const char* arg;
+    size_t argLen;
+    if (nextToken(cur, end, arg, argLen) && argLen == 1 && arg[0] >= '0' + RANDOM && arg[0] <= '0' + GENIOUS) {
+      pos.strategy = arg[0] - '0';
+    } else {
+      putError(out, "bad strategy", arg, argLen);
+    }
+  } else if (tokenIs(tok, len, "quit")) {
+    return false;
+  } else {
+    putError(out, "unknown command", tok, len);
+  }
+  return true;
+}
+
+}
+
+int runEngineProtocol(int inFd, int outFd) {
+  static char in[64 * 1024];
+  Writer out(outFd);
+  Position pos;
+  resetPosition(pos, USER);
+  pos.strategy = GENIOUS;
+
+  size_t have = 0;
+  bool discarding = false;   // skipping the rest of a line that was too long
+  for (;;) {
+    // Nothing complete is buffered, so we are about to block: this is the
+    // only point where pending responses need to reach the client.
+    out.flush();
+    if (out.failed()) { return 1; }
+
+    ssize_t n = read(inFd, in + have, sizeof(in) - have);
+    if (n < 0 && errno == EINTR) { continue; }
+    if (n < 0) { return 1; }
+    if (n == 0) {
+      // Treat a final unterminated line as a request too
+      if (have > 0) { dispatch(pos, in, in + have, out); }
+      out.flush();
+      return out.failed() ? 1 : 0;
+    }
+    have += n;
+
+    char* line = in;
+    char* end  = in + have;
+    char* nl;
+    if (discarding) {
+      nl = static_cast<char*>(memchr(line, '\n', end - line));
+      if (!nl) { have = 0; continue; }
+      line = nl + 1;
+      discarding = false;
+    }
+
+    // Run every complete line in the buffer
+    while ((nl = static_cast<char*>(memchr(line, '\n', end - line))) != nullptr) {
+      if (!dispatch(pos, line, nl, out)) {
+        out.flush();
+        return out.failed() ? 1 : 0;
+      }
+      line = nl + 1;
+    }
+
+    // Keep the partial line for the next read; drop lines too long to
+    // fit, up to their newline
+    have = end - line;
+    if (have == sizeof(in)) {
+      out.put("error line too long\n");
+      have = 0;
+      discarding = true;
+    } else {
+      memmove(in, line, have);
+    }
+  }
+}
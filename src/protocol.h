@@ -0,0 +1,41 @@
+#ifndef TICTACTOE_PROTOCOL_H
+#define TICTACTOE_PROTOCOL_H
+
+/**
+ * Line-oriented engine protocol, meant to be driven by another program
+ * rather than a person. Each request is one line; responses are written
+ * in request order. Commands:
+ *
+ *   isready                        -> readyok
+ *   strategy <0|1|2>               set the strategy used by `go`
+ *   position [user|computer] [moves] <move>...
+ *                                  set up the board from the empty one;
+ *                                  the optional player moves first (USER
+ *                                  by default), moves alternate and are
+ *                                  written column+row, ex: B1
+ *   go [movetime <ms>]             -> bestmove <move>|none
+ *   status                         -> status in_progress|user_won|computer_won|draw
+ *   perft <depth> [threads <n>] [hash]
+ *                                  -> perft depth <d> nodes <n> leaves <n> games <n>
+ *                                     user_won <n> computer_won <n> draw <n> time <ms> nps <n>
+ *                                  count the move sequences from the position
+ *                                  (see perft.h)
+ *   quit
+ *
+ * Malformed requests produce a single `error ...` line and change nothing
+ * (a bad `position` keeps the previous position); a line over 64 KiB gets
+ * `error line too long` and is skipped up to its newline. Output is only
+ * flushed when there is no more input waiting to be read, so a client
+ * may pipeline any number of requests without waiting for replies.
+ */
+
+/**
+ * Serve the protocol until `quit` or end of input.
+ *
+ * @param  int inFd   Descriptor requests are read from
+ * @param  int outFd  Descriptor responses are written to
+ * @return int        0 on a clean exit, 1 on an I/O error
+ */
+int runEngineProtocol(int inFd, int outFd);
+
+#endif
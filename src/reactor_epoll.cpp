@@ -0,0 +1,255 @@
+#include "server.h"
+#include <atomic>
+#include <cerrno>
+#include <cstring>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <sys/socket.h>
+#include <sys/uio.h>
+#include <unistd.h>
+#include <vector>
+using namespace std;
+
+namespace {
+
+const size_t CONNECTIONS_PER_SLAB = 16;   // 512 KiB slabs
+
+/**
+ * Level-triggered epoll event loop. Each iteration:
+ *   1. reads every readable connection and hands the input to the handler,
+ *      along with input held back in the previous iteration for lack of
+ *      output space or because the handler paused
+ *   2. calls `Handler::onTick`
+ *   3. writes the output queued during the iteration, one write per
+ *      connection no matter how many replies were queued
+ *   4. frees the connections that were closed
+ */
+class EpollReactor : public Reactor {
+ public:
+  EpollReactor(int listenFd, Handler* handler)
+    : listenFd_(listenFd), handler_(handler), stopping_(false) {
+    epollFd_ = epoll_create1(EPOLL_CLOEXEC);
+    wakeFd_  = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+
+    epoll_event ev = {};
+    ev.events = EPOLLIN | EPOLLEXCLUSIVE;  // wake a single reactor per connection
+    ev.data.ptr = &listenFd_;
+    epoll_ctl(epollFd_, EPOLL_CTL_ADD, listenFd_, &ev);
+    ev.events = EPOLLIN;
+    ev.data.ptr = &wakeFd_;
+    epoll_ctl(epollFd_, EPOLL_CTL_ADD, wakeFd_, &ev);
+  }
+
+  ~EpollReactor() {
+    connections_.forEach([this](Connection& conn) {
+      handler_->onClose(conn);
+      close(conn.fd);
+    });
+    close(wakeFd_);
+    close(epollFd_);
+  }
+
+  void run() {
+    epoll_event events[256];
+    while (!stopping_.load(memory_order_relaxed)) {
+      // Don't block while held-back input is waiting to be processed
+      int n = epoll_wait(epollFd_, events, 256, backlog_.empty() ? -1 : 0);
+      if (n < 0 && errno != EINTR) { break; }
+
+      for (int i = 0; i < n; i++) {
+        void* tag = events[i].data.ptr;
+        if (tag == &listenFd_) {
+          acceptAll();
+        } else if (tag == &wakeFd_) {
+          uint64_t count;
+          (void)!read(wakeFd_, &count, sizeof(count));
+        } else {
+          Connection* conn = static_cast<Connection*>(tag);
+          if (events[i].events & EPOLLOUT) { queueFlush(*conn); }
+          if (events[i].events & (EPOLLIN | EPOLLHUP | EPOLLERR)) { readable(*conn); }
+        }
+      }
+
+      runBacklog();
+      handler_->onTick();
+      flushAll();
+      reap();
+    }
+  }
+
+  void stop() {
+    stopping_.store(true);
+    wake();
+  }
+
+  void wake() {
+    uint64_t one = 1;
+    (void)!write(wakeFd_, &one, sizeof(one));
+  }
+
+  void queueOutput(Connection& conn) { queueFlush(conn); }
+
+  PoolStats connectionStats() const { return connections_.stats(); }
+
+ private:
+  void acceptAll() {
+    for (;;) {
+      int fd = accept4(listenFd_, nullptr, nullptr, SOCK_NONBLOCK | SOCK_CLOEXEC);
+      if (fd < 0) { return; }  // EAGAIN: another reactor took it, or none left
+      int one = 1;
+      setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));  // fails harmlessly on Unix sockets
+
+      uint32_t slot = connections_.create(fd);
+      Connection& conn = connections_[slot];
+      conn.slot = slot;
+      watch(conn, EPOLLIN, EPOLL_CTL_ADD);
+    }
+  }
+
+  void watch(Connection& conn, unsigned interest, int op) {
+    if (op == EPOLL_CTL_MOD && conn.interest == interest) { return; }
+    epoll_event ev = {};
+    ev.events = interest;
+    ev.data.ptr = &conn;
+    epoll_ctl(epollFd_, op, conn.fd, &ev);
+    conn.interest = interest;
+  }
+
+  void readable(Connection& conn) {
+    if (conn.dead) { return; }
+    if (conn.inLen == Connection::BUFFER_SIZE) { return; }  // waiting for output to drain
+    ssize_t n = read(conn.fd, conn.in + conn.inLen, Connection::BUFFER_SIZE - conn.inLen);
+    if (n > 0) {
+      conn.inLen += n;
+      process(conn);
+    } else if (n == 0 || (errno != EAGAIN && errno != EINTR)) {
+      closeLater(conn);
+    }
+  }
+
+  void process(Connection& conn) {
+    size_t used = handler_->onData(conn, conn.in, conn.inLen);
+    if (used > 0) {
+      conn.inLen -= used;
+      memmove(conn.in, conn.in + used, conn.inLen);
+    }
+    if (conn.hasOutput() || conn.closing) { queueFlush(conn); }
+    if (conn.paused) {
+      conn.paused = false;
+      defer(conn);
+    }
+  }
+
+  /** Process the input of `conn` again next iteration. */
+  void defer(Connection& conn) {
+    if (!conn.backlogged) {
+      conn.backlogged = true;
+      backlog_.push_back(&conn);
+    }
+  }
+
+  void queueFlush(Connection& conn) {
+    if (!conn.flushPending) {
+      conn.flushPending = true;
+      flushList_.push_back(&conn);
+    }
+  }
+
+  void flushAll() {
+    for (size_t i = 0; i < flushList_.size(); i++) {
+      Connection& conn = *flushList_[i];
+      conn.flushPending = false;
+      if (!conn.dead) { flush(conn); }
+    }
+    flushList_.clear();
+  }
+
+  void flush(Connection& conn) {
+    while (conn.hasOutput()) {
+      iovec iov[Connection::SHARED_SLOTS + 1];
+      msghdr msg = {};
+      msg.msg_iov    = iov;
+      msg.msg_iovlen = conn.gather(iov);
+      ssize_t n = sendmsg(conn.fd, &msg, MSG_NOSIGNAL);
+      if (n > 0) { conn.written(n); continue; }
+      conn.written(0);
+      if (n < 0 && errno == EINTR) { continue; }
+      if (n < 0 && errno == EAGAIN) { break; }
+      closeLater(conn);
+      return;
+    }
+
+    if (conn.hasOutput()) {
+      // Socket buffer full: wait for it to drain, and stop reading if the
+      // handler has already stalled on our output buffer
+      unsigned interest = EPOLLOUT;
+      if (conn.inLen < Connection::BUFFER_SIZE) { interest |= EPOLLIN; }
+      watch(conn, interest, EPOLL_CTL_MOD);
+      return;
+    }
+
+    if (conn.closing) { closeLater(conn); return; }
+    watch(conn, EPOLLIN, EPOLL_CTL_MOD);
+    // Requests that were held back for lack of output space; they are
+    // processed next iteration so that `onTick` always runs between
+    // `onData` and the write of its output
+    if (conn.inLen > 0) { defer(conn); }
+  }
+
+  void runBacklog() {
+    if (backlog_.empty()) { return; }
+    ready_.swap(backlog_);
+    for (Connection* conn : ready_) {
+      conn->backlogged = false;
+      if (!conn->dead) { process(*conn); }
+    }
+    ready_.clear();
+  }
+
+  void closeLater(Connection& conn) {
+    if (!conn.dead) {
+      conn.dead = true;
+      closed_.push_back(&conn);
+    }
+  }
+
+  void reap() {
+    if (closed_.empty()) { return; }
+    // A connection can be closed after being deferred; it must not be
+    // touched by `runBacklog` once its slot is freed (and maybe reused by
+    // `acceptAll`). `flushList_` is always empty here.
+    if (!backlog_.empty()) {
+      size_t kept = 0;
+      for (Connection* conn : backlog_) {
+        if (conn->dead) { conn->backlogged = false; } else { backlog_[kept++] = conn; }
+      }
+      backlog_.resize(kept);
+    }
+    for (Connection* conn : closed_) {
+      handler_->onClose(*conn);
+      epoll_ctl(epollFd_, EPOLL_CTL_DEL, conn->fd, nullptr);
+      close(conn->fd);
+      connections_.destroy(conn->slot);
+    }
+    closed_.clear();
+  }
+
+  int                          listenFd_;
+  int                          epollFd_;
+  int                          wakeFd_;
+  Handler*                     handler_;
+  atomic<bool>                 stopping_;
+  SlabPool<Connection, CONNECTIONS_PER_SLAB> connections_;
+  vector<Connection*>          flushList_;
+  vector<Connection*>          backlog_;
+  vector<Connection*>          ready_;    // backlog being processed
+  vector<Connection*>          closed_;
+};
+
+}
+
+Reactor* makeEpollReactor(int listenFd, Handler* handler) {
+  return new EpollReactor(listenFd, handler);
+}
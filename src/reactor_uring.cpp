@@ -0,0 +1,516 @@
+#include "server.h"
+#include <algorithm>
+#include <atomic>
+#include <cerrno>
+#include <cstring>
+#include <linux/io_uring.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/eventfd.h>
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#include <vector>
+using namespace std;
+
+namespace {
+
+const unsigned RING_ENTRIES   = 4096;
+const unsigned RECV_BUFFERS   = 1024;    // provided buffers shared by all connections
+const unsigned RECV_BUF_SIZE  = 4096;
+const unsigned BUFFER_GROUP   = 0;
+const size_t   CONNECTIONS_PER_SLAB = 16;   // 512 KiB slabs
+
+// Completion tags, stored in the low bits of the (8-byte aligned) user_data
+enum {TAG_ACCEPT = 1, TAG_RECV, TAG_SEND, TAG_CANCEL, TAG_WAKE, TAG_MASK = 7};
+
+/**
+ * Connection plus the state of its in-flight operations. Received data
+ * that does not fit in `conn.in` stays in the kernel-provided buffer it
+ * arrived in (`held`) and receiving is paused until the handler catches up.
+ */
+struct UringConnection {
+  struct Held { unsigned bid; unsigned off; unsigned len; };
+
+  Connection   conn;
+  vector<Held> held;
+  bool         recvArmed;
+  bool         cancelPending;
+  bool         sendInFlight;
+  bool         starved;                               // receive ran out of buffers, waiting for one
+  msghdr       msg;                                   // of the send in flight
+  iovec        iov[Connection::SHARED_SLOTS + 1];
+
+  explicit UringConnection(int fd)
+    : conn(fd), recvArmed(false), cancelPending(false), sendInFlight(false), starved(false) {}
+  /** Nothing, in the kernel or in the reactor's backlog, refers to it. */
+  bool idle() const { return !recvArmed && !cancelPending && !sendInFlight && !conn.backlogged; }
+};
+
+/**
+ * io_uring event loop. Steady state costs a single io_uring_enter per
+ * loop iteration, which both submits the queued operations and waits
+ * for completions:
+ *   - connections are accepted by one multishot accept
+ *   - input arrives through one multishot recv per connection, into a
+ *     ring of buffers registered with the kernel up front
+ *   - output queued during an iteration goes out as one sendmsg per
+ *     connection (own output plus shared buffers), submitted at the end
+ *     of the iteration
+ */
+class UringReactor : public Reactor {
+ public:
+  UringReactor(int listenFd, Handler* handler)
+    : listenFd_(listenFd), handler_(handler), stopping_(false), ringFd_(-1),
+      ringMem_(MAP_FAILED), sqesMem_(MAP_FAILED), bufRingMem_(MAP_FAILED), recvMem_(nullptr),
+      publishedTail_(0), toSubmit_(0), wakeValue_(0) {
+    wakeFd_ = eventfd(0, EFD_CLOEXEC);
+  }
+
+  ~UringReactor() {
+    // Tear the ring down first so the kernel lets go of our buffers
+    if (ringFd_ >= 0) { close(ringFd_); }
+    connections_.forEach([this](UringConnection& uc) {
+      if (!uc.conn.dead) { handler_->onClose(uc.conn); }
+      close(uc.conn.fd);
+    });
+    if (ringMem_ != MAP_FAILED)    { munmap(ringMem_, ringSize_); }
+    if (sqesMem_ != MAP_FAILED)    { munmap(sqesMem_, sqesSize_); }
+    if (bufRingMem_ != MAP_FAILED) { munmap(bufRingMem_, RECV_BUFFERS * sizeof(io_uring_buf)); }
+    delete[] recvMem_;
+    close(wakeFd_);
+  }
+
+  /**
+   * Create the ring and register the receive buffers.
+   *
+   * @return bool  false (errno set) if io_uring is unavailable
+   */
+  bool init() {
+    io_uring_params p = {};
+    p.flags = IORING_SETUP_COOP_TASKRUN;
+    ringFd_ = syscall(__NR_io_uring_setup, RING_ENTRIES, &p);
+    if (ringFd_ < 0) { return false; }
+    if (!(p.features & IORING_FEAT_SINGLE_MMAP) || !(p.features & IORING_FEAT_NODROP)) {
+      errno = ENOSYS;
+      return false;
+    }
+
+    ringSize_ = max(p.sq_off.array + p.sq_entries * sizeof(unsigned),
+                    p.cq_off.cqes + p.cq_entries * sizeof(io_uring_cqe));
+    ringMem_ = mmap(nullptr, ringSize_, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ringFd_, IORING_OFF_SQ_RING);
+    sqesSize_ = p.sq_entries * sizeof(io_uring_sqe);
+    sqesMem_ = mmap(nullptr, sqesSize_, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ringFd_, IORING_OFF_SQES);
+    if (ringMem_ == MAP_FAILED || sqesMem_ == MAP_FAILED) { return false; }
+
+    char* ring = static_cast<char*>(ringMem_);
+    sqTail_  = reinterpret_cast<unsigned*>(ring + p.sq_off.tail);
+    sqHead_  = reinterpret_cast<unsigned*>(ring + p.sq_off.head);
+    sqMask_  = *reinterpret_cast<unsigned*>(ring + p.sq_off.ring_mask);
+    sqCount_ = p.sq_entries;
+    cqHead_  = reinterpret_cast<unsigned*>(ring + p.cq_off.head);
+    cqTail_  = reinterpret_cast<unsigned*>(ring + p.cq_off.tail);
+    cqMask_  = *reinterpret_cast<unsigned*>(ring + p.cq_off.ring_mask);
+    cqes_    = reinterpret_cast<io_uring_cqe*>(ring + p.cq_off.cqes);
+    sqes_    = static_cast<io_uring_sqe*>(sqesMem_);
+    // Each SQ slot always submits the SQE with the same index
+    unsigned* array = reinterpret_cast<unsigned*>(ring + p.sq_off.array);
+    for (unsigned i = 0; i < p.sq_entries; i++) { array[i] = i; }
+    localSqTail_ = *sqTail_;
+
+    // Provided buffer ring for multishot recv
+    bufRingMem_ = mmap(nullptr, RECV_BUFFERS * sizeof(io_uring_buf), PROT_READ | PROT_WRITE,
+                       MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (bufRingMem_ == MAP_FAILED) { return false; }
+    bufRing_ = static_cast<io_uring_buf_ring*>(bufRingMem_);
+    io_uring_buf_reg reg = {};
+    reg.ring_addr    = reinterpret_cast<uint64_t>(bufRingMem_);
+    reg.ring_entries = RECV_BUFFERS;
+    reg.bgid         = BUFFER_GROUP;
+    if (syscall(__NR_io_uring_register, ringFd_, IORING_REGISTER_PBUF_RING, &reg, 1) < 0) { return false; }
+    recvMem_ = new char[RECV_BUFFERS * RECV_BUF_SIZE];
+    bufTail_ = 0;
+    for (unsigned bid = 0; bid < RECV_BUFFERS; bid++) { recycle(bid); }
+    publishBuffers();
+
+    armAccept();
+    armWake();
+    return true;
+  }
+
+  void run() {
+    while (!stopping_.load(memory_order_relaxed)) {
+      // Don't block while held-back input is waiting to be processed
+      if (enter(backlog_.empty() ? 1 : 0) < 0 && errno != EINTR) { break; }
+      reapCompletions();
+      runBacklog();
+      handler_->onTick();
+      flushAll();
+      reap();
+      publishBuffers();
+    }
+  }
+
+  void stop() {
+    stopping_.store(true);
+    wake();
+  }
+
+  void wake() {
+    uint64_t one = 1;
+    (void)!write(wakeFd_, &one, sizeof(one));
+  }
+
+  void queueOutput(Connection& conn) { queueFlush(connections_[conn.slot]); }
+
+  PoolStats connectionStats() const { return connections_.stats(); }
+
+ private:
+  // ---- Submission / completion queues ----
+
+  io_uring_sqe* getSqe() {
+    if (localSqTail_ - __atomic_load_n(sqHead_, __ATOMIC_ACQUIRE) >= sqCount_) { enter(0); }
+    io_uring_sqe* sqe = &sqes_[localSqTail_ & sqMask_];
+    memset(sqe, 0, sizeof(*sqe));
+    localSqTail_++;
+    toSubmit_++;
+    return sqe;
+  }
+
+  /** Submit queued SQEs and wait for at least `waitFor` completions. */
+  int enter(unsigned waitFor) {
+    __atomic_store_n(sqTail_, localSqTail_, __ATOMIC_RELEASE);
+    unsigned flags = waitFor ? IORING_ENTER_GETEVENTS : 0;
+    int ret = syscall(__NR_io_uring_enter, ringFd_, toSubmit_, waitFor, flags, nullptr, 0);
+    if (ret >= 0) { toSubmit_ -= ret; }
+    return ret;
+  }
+
+  void reapCompletions() {
+    unsigned head = *cqHead_;
+    unsigned tail = __atomic_load_n(cqTail_, __ATOMIC_ACQUIRE);
+    for (; head != tail; head++) {
+      io_uring_cqe cqe = cqes_[head & cqMask_];
+      // Release the slot early so the kernel can keep posting
+      __atomic_store_n(cqHead_, head + 1, __ATOMIC_RELEASE);
+      complete(cqe);
+    }
+  }
+
+  // ---- Provided receive buffers ----
+
+  void recycle(unsigned bid) {
+    // Index the entries directly: in C++ the header's flexible `bufs`
+    // member is preceded by an empty struct and lands at the wrong offset
+    io_uring_buf& buf = static_cast<io_uring_buf*>(bufRingMem_)[bufTail_ & (RECV_BUFFERS - 1)];
+    buf.addr = reinterpret_cast<uint64_t>(recvMem_ + bid * RECV_BUF_SIZE);
+    buf.len  = RECV_BUF_SIZE;
+    buf.bid  = bid;
+    bufTail_++;
+  }
+
+  /**
+   * Hand the buffers recycled since the last call to the kernel, and
+   * give as many connections that ran out of them another receive.
+   */
+  void publishBuffers() {
+    uint16_t added = bufTail_ - publishedTail_;
+    if (added == 0) { return; }
+    __atomic_store_n(&bufRing_->tail, bufTail_, __ATOMIC_RELEASE);
+    publishedTail_ = bufTail_;
+    size_t n = min<size_t>(added, starved_.size());
+    for (size_t i = 0; i < n; i++) {
+      starved_[i]->starved = false;
+      resumeRecv(*starved_[i]);
+    }
+    starved_.erase(starved_.begin(), starved_.begin() + n);
+  }
+
+  // ---- Operations ----
+
+  void armAccept() {
+    io_uring_sqe* sqe = getSqe();
+    sqe->opcode    = IORING_OP_ACCEPT;
+    sqe->fd        = listenFd_;
+    sqe->ioprio    = IORING_ACCEPT_MULTISHOT;
+    sqe->accept_flags = SOCK_NONBLOCK | SOCK_CLOEXEC;
+    sqe->user_data = TAG_ACCEPT;
+  }
+
+  void armWake() {
+    io_uring_sqe* sqe = getSqe();
+    sqe->opcode    = IORING_OP_READ;
+    sqe->fd        = wakeFd_;
+    sqe->addr      = reinterpret_cast<uint64_t>(&wakeValue_);
+    sqe->len       = sizeof(wakeValue_);
+    sqe->user_data = TAG_WAKE;
+  }
+
+  void armRecv(UringConnection& uc) {
+    io_uring_sqe* sqe = getSqe();
+    sqe->opcode    = IORING_OP_RECV;
+    sqe->fd        = uc.conn.fd;
+    sqe->ioprio    = IORING_RECV_MULTISHOT;
+    sqe->flags     = IOSQE_BUFFER_SELECT;
+    sqe->buf_group = BUFFER_GROUP;
+    sqe->user_data = reinterpret_cast<uint64_t>(&uc) | TAG_RECV;
+    uc.recvArmed = true;
+  }
+
+  void cancelRecv(UringConnection& uc) {
+    if (!uc.recvArmed || uc.cancelPending) { return; }
+    io_uring_sqe* sqe = getSqe();
+    sqe->opcode    = IORING_OP_ASYNC_CANCEL;
+    sqe->addr      = reinterpret_cast<uint64_t>(&uc) | TAG_RECV;
+    sqe->user_data = reinterpret_cast<uint64_t>(&uc) | TAG_CANCEL;
+    uc.cancelPending = true;
+  }
+
+  void send(UringConnection& uc) {
+    Connection& conn = uc.conn;
+    uc.msg = msghdr{};
+    uc.msg.msg_iov    = uc.iov;
+    uc.msg.msg_iovlen = conn.gather(uc.iov);
+    io_uring_sqe* sqe = getSqe();
+    sqe->opcode    = IORING_OP_SENDMSG;
+    sqe->fd        = conn.fd;
+    sqe->addr      = reinterpret_cast<uint64_t>(&uc.msg);
+    sqe->len       = 1;
+    sqe->msg_flags = MSG_NOSIGNAL;
+    sqe->user_data = reinterpret_cast<uint64_t>(&uc) | TAG_SEND;
+    uc.sendInFlight = true;
+  }
+
+  // ---- Completions ----
+
+  void complete(const io_uring_cqe& cqe) {
+    unsigned tag = cqe.user_data & TAG_MASK;
+    UringConnection* uc = reinterpret_cast<UringConnection*>(cqe.user_data & ~uint64_t(TAG_MASK));
+    switch (tag) {
+      case TAG_ACCEPT: accepted(cqe);      break;
+      case TAG_WAKE:   armWake();          break;
+      case TAG_RECV:   received(*uc, cqe); break;
+      case TAG_SEND:   sent(*uc, cqe);     break;
+      case TAG_CANCEL:
+        uc->cancelPending = false;
+        resumeRecv(*uc);
+        break;
+    }
+  }
+
+  void accepted(const io_uring_cqe& cqe) {
+    if (!(cqe.flags & IORING_CQE_F_MORE)) { armAccept(); }
+    if (cqe.res < 0) { return; }
+    int one = 1;
+    setsockopt(cqe.res, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));  // fails harmlessly on Unix sockets
+    uint32_t slot = connections_.create(cqe.res);
+    UringConnection& uc = connections_[slot];
+    uc.conn.slot = slot;
+    armRecv(uc);
+  }
+
+  void received(UringConnection& uc, const io_uring_cqe& cqe) {
+    if (!(cqe.flags & IORING_CQE_F_MORE)) { uc.recvArmed = false; }
+    if (cqe.flags & IORING_CQE_F_BUFFER) {
+      unsigned bid = cqe.flags >> IORING_CQE_BUFFER_SHIFT;
+      if (cqe.res > 0 && !uc.conn.dead) {
+        uc.held.push_back(UringConnection::Held{bid, 0, (unsigned)cqe.res});
+        drainHeld(uc);
+      } else {
+        recycle(bid);
+      }
+    }
+    if (uc.conn.dead) { return; }
+    if (cqe.res == -ENOBUFS) {
+      // Every buffer is taken: re-arming now would fail again at once, so
+      // wait for `publishBuffers` to return some
+      if (!uc.recvArmed && !uc.starved) {
+        uc.starved = true;
+        starved_.push_back(&uc);
+      }
+    } else if (cqe.res == 0 || (cqe.res < 0 && cqe.res != -ECANCELED)) {
+      closeLater(uc);
+    } else if (!uc.recvArmed) {
+      resumeRecv(uc);
+    }
+  }
+
+  void sent(UringConnection& uc, const io_uring_cqe& cqe) {
+    uc.sendInFlight = false;
+    uc.conn.written(cqe.res > 0 ? cqe.res : 0);
+    if (uc.conn.dead) { return; }
+    if (cqe.res < 0) { closeLater(uc); return; }
+    queueFlush(uc);
+  }
+
+  // ---- Input path ----
+
+  /** Move held input into the connection buffer as the handler frees room. */
+  void drainHeld(UringConnection& uc) {
+    Connection& conn = uc.conn;
+    size_t next = 0;
+    while (next < uc.held.size()) {
+      UringConnection::Held& h = uc.held[next];
+      size_t room = Connection::BUFFER_SIZE - conn.inLen;
+      size_t n = min<size_t>(room, h.len - h.off);
+      memcpy(conn.in + conn.inLen, recvMem_ + h.bid * RECV_BUF_SIZE + h.off, n);
+      conn.inLen += n;
+      h.off += n;
+      if (h.off == h.len) {
+        recycle(h.bid);
+        next++;
+      }
+      process(uc);
+      if (n == 0) { break; }  // handler is waiting for output space
+    }
+    uc.held.erase(uc.held.begin(), uc.held.begin() + next);
+    // Stop taking input while any is held back; `resumeRecv` restarts it
+    if (!uc.held.empty()) { cancelRecv(uc); }
+  }
+
+  void resumeRecv(UringConnection& uc) {
+    if (uc.held.empty() && !uc.recvArmed && !uc.cancelPending && !uc.starved && !uc.conn.dead && !stopping_) {
+      armRecv(uc);
+    }
+  }
+
+  void process(UringConnection& uc) {
+    Connection& conn = uc.conn;
+    size_t used = handler_->onData(conn, conn.in, conn.inLen);
+    if (used > 0) {
+      conn.inLen -= used;
+      memmove(conn.in, conn.in + used, conn.inLen);
+    }
+    if (conn.hasOutput() || conn.closing) { queueFlush(uc); }
+    if (conn.paused) {
+      conn.paused = false;
+      defer(uc);
+    }
+  }
+
+  /** Process the input of `uc` again next iteration. */
+  void defer(UringConnection& uc) {
+    if (!uc.conn.backlogged) {
+      uc.conn.backlogged = true;
+      backlog_.push_back(&uc);
+    }
+  }
+
+  // ---- Output path ----
+
+  void queueFlush(UringConnection& uc) {
+    if (!uc.conn.flushPending) {
+      uc.conn.flushPending = true;
+      flushList_.push_back(&uc);
+    }
+  }
+
+  void flushAll() {
+    for (size_t i = 0; i < flushList_.size(); i++) {
+      UringConnection& uc = *flushList_[i];
+      uc.conn.flushPending = false;
+      if (!uc.conn.dead) { flush(uc); }
+    }
+    flushList_.clear();
+  }
+
+  void flush(UringConnection& uc) {
+    Connection& conn = uc.conn;
+    if (uc.sendInFlight) { return; }  // `sent` flushes again
+    if (conn.hasOutput()) { send(uc); return; }
+
+    if (conn.closing) { closeLater(uc); return; }
+    // Input that was held back for lack of output space is processed next
+    // iteration, so that `onTick` always runs between `onData` and the
+    // send of its output
+    if (!uc.held.empty() || conn.inLen > 0) { defer(uc); }
+    else { resumeRecv(uc); }
+  }
+
+  void runBacklog() {
+    if (backlog_.empty()) { return; }
+    ready_.swap(backlog_);
+    for (UringConnection* uc : ready_) {
+      uc->conn.backlogged = false;
+      if (uc->conn.dead) { continue; }
+      if (!uc->held.empty()) { drainHeld(*uc); }
+      else { process(*uc); }
+      resumeRecv(*uc);
+    }
+    ready_.clear();
+  }
+
+  // ---- Teardown ----
+
+  void closeLater(UringConnection& uc) {
+    if (uc.conn.dead) { return; }
+    uc.conn.dead = true;
+    handler_->onClose(uc.conn);
+    for (const UringConnection::Held& h : uc.held) { recycle(h.bid); }
+    uc.held.clear();
+    if (uc.starved) {
+      uc.starved = false;
+      starved_.erase(find(starved_.begin(), starved_.end(), &uc));
+    }
+    cancelRecv(uc);
+    closed_.push_back(&uc);
+  }
+
+  /** Free closed connections once the kernel is done with them. */
+  void reap() {
+    size_t keep = 0;
+    for (UringConnection* uc : closed_) {
+      if (!uc->idle()) { closed_[keep++] = uc; continue; }
+      close(uc->conn.fd);
+      connections_.destroy(uc->conn.slot);
+    }
+    closed_.resize(keep);
+  }
+
+  int                             listenFd_;
+  Handler*                        handler_;
+  atomic<bool>                    stopping_;
+  int                             wakeFd_;
+  int                             ringFd_;
+  void*                           ringMem_;
+  size_t                          ringSize_;
+  void*                           sqesMem_;
+  size_t                          sqesSize_;
+  void*                           bufRingMem_;
+  char*                           recvMem_;
+  io_uring_buf_ring*              bufRing_;
+  uint16_t                        bufTail_;
+  uint16_t                        publishedTail_;
+  unsigned*                       sqHead_;
+  unsigned*                       sqTail_;
+  unsigned                        sqMask_;
+  unsigned                        sqCount_;
+  unsigned                        localSqTail_;
+  unsigned*                       cqHead_;
+  unsigned*                       cqTail_;
+  unsigned                        cqMask_;
+  io_uring_cqe*                   cqes_;
+  io_uring_sqe*                   sqes_;
+  unsigned                        toSubmit_;
+  uint64_t                        wakeValue_;
+  SlabPool<UringConnection, CONNECTIONS_PER_SLAB> connections_;
+  vector<UringConnection*>        flushList_;
+  vector<UringConnection*>        backlog_;
+  vector<UringConnection*>        ready_;    // backlog being processed
+  vector<UringConnection*>        closed_;
+  vector<UringConnection*>        starved_;  // parked on ENOBUFS, oldest first
+};
+
+}
+
+Reactor* makeUringReactor(int listenFd, Handler* handler) {
+  UringReactor* reactor = new UringReactor(listenFd, handler);
+  if (!reactor->init()) {
+    int saved = errno;
+    delete reactor;
+    errno = saved;
+    return nullptr;
+  }
+  return reactor;
+}
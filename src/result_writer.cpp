@@ -0,0 +1,161 @@
+#include "result_writer.h"
+#include <cerrno>
+#include <cstring>
+#include <unistd.h>
+
+namespace {
+
+struct Text {
+  const char* chars;
+  size_t      length;
+};
+
+#define TEXT(s) Text{s, sizeof(s) - 1}
+
+enum {NAMED_STRATEGIES = 5};
+
+const Text STRATEGY_NAMES[NAMED_STRATEGIES] = {
+  TEXT("random"), TEXT("smart"), TEXT("genious"), TEXT("human"), TEXT("unknown")
+};
+
+/** Index of `strategy` in STRATEGY_NAMES. */
+inline int strategyName(int strategy) {
+  return (strategy <= GENIOUS) ? strategy : (strategy == HUMAN) ? 3 : 4;
+}
+
+// By `resultCode`
+const Text RESULT_NAMES[4] = {TEXT("in_progress"), TEXT("user_won"), TEXT("computer_won"), TEXT("draw")};
+
+inline char* put(char* p, Text text) {
+  memcpy(p, text.chars, text.length);
+  return p + text.length;
+}
+
+/** Decimal digits of `value`, two at a time. */
+inline char* putUint(char* p, uint64_t value) {
+  static const char PAIRS[] =
+    "00010203040506070809101112131415161718192021222324252627282930313233343536373839"
+    "40414243444546474849505152535455565758596061626364656667686970717273747576777879"
+    "8081828384858687888990919293949596979899";
+  char digits[20];
+  char* end = digits + sizeof(digits);
+  char* d = end;
+  while (value >= 100) {
+    d -= 2;
+    memcpy(d, PAIRS + 2 * (value % 100), 2);
+    value /= 100;
+  }
+  if (value >= 10) {
+    d -= 2;
+    memcpy(d, PAIRS + 2 * value, 2);
+  } else {
+    *--d = '0' + value;
+  }
+  memcpy(p, d, end - d);
+  return p + (end - d);
+}
+
+}
+
+ResultWriter::ResultWriter(int fd, int format, uint64_t batch)
+  : fd_(fd), format_(format), failed_(false), batch_(batch), games_(0), batchFirst_(0), results_(),
+    buffer_(new char[BUFFER_BYTES]), used_(0) {
+  header();
+  // Everything between the seed and the moves only depends on the
+  // strategies, first mover and result: prepare every combination
+  for (int user = 0; user < NAMED_STRATEGIES; user++) {
+    for (int computer = 0; computer < NAMED_STRATEGIES; computer++) {
+      for (int first = 0; first < 2; first++) {
+        for (int result = 0; result < 4; result++) {
+          Fragment& f = fragments_[((user * NAMED_STRATEGIES + computer) * 2 + first) * 4 + result];
+          char* p = f.chars;
+          Text firstName = first ? TEXT("computer") : TEXT("user");
+          if (format_ == OUTPUT_CSV) {
+            p = put(put(p, TEXT(",")), STRATEGY_NAMES[user]);
+            p = put(put(p, TEXT(",")), STRATEGY_NAMES[computer]);
+            p = put(put(p, TEXT(",")), firstName);
+            p = put(put(p, TEXT(",")), RESULT_NAMES[result]);
+            p = put(p, TEXT(","));
+          } else {
+            p = put(put(p, TEXT(",\"user\":\"")), STRATEGY_NAMES[user]);
+            p = put(put(p, TEXT("\",\"computer\":\"")), STRATEGY_NAMES[computer]);
+            p = put(put(p, TEXT("\",\"first\":\"")), firstName);
+            p = put(put(p, TEXT("\",\"result\":\"")), RESULT_NAMES[result]);
+            p = put(p, TEXT("\",\"moves\":\""));
+          }
+          f.length = p - f.chars;
+        }
+      }
+    }
+  }
+}
+
+void ResultWriter::header() {
+  if (format_ != OUTPUT_CSV) { return; }
+  Text text = batch_ ? TEXT("first_game,games,user_won,computer_won,draw,in_progress\n")
+                     : TEXT("game,seed,user,computer,first,result,moves\n");
+  used_ = put(buffer_.get(), text) - buffer_.get();
+}
+
+void ResultWriter::line(const GameRecord& game) {
+  char* p = buffer_.get() + used_;
+  bool csv = (format_ == OUTPUT_CSV);
+  p = csv ? putUint(p, games_) : putUint(put(p, TEXT("{\"game\":")), games_);
+  p = csv ? putUint(put(p, TEXT(",")), game.seed) : putUint(put(p, TEXT(",\"seed\":")), game.seed);
+  int user = strategyName(game.userStrategy), computer = strategyName(game.computerStrategy);
+  const Fragment& f =
+    fragments_[((user * NAMED_STRATEGIES + computer) * 2 + (game.first == COMPUTER)) * 4 + resultCode(game.status)];
+  memcpy(p, f.chars, sizeof(f.chars));   // the buffer has room to spare
+  p += f.length;
+  // Nine digits, of which the first `moves` count
+  int moves = (game.moveCount < 9) ? game.moveCount : 9;
+  for (int i = 0; i < 9; i++) { p[i] = '0' + (game.moves[i] & 0xF) % 10; }
+  p += moves;
+  p = csv ? put(p, TEXT("\n")) : put(p, TEXT("\"}\n"));
+  used_ = p - buffer_.get();
+}
+
+void ResultWriter::summary() {
+  char* p = buffer_.get() + used_;
+  uint64_t games = games_ - batchFirst_;
+  if (format_ == OUTPUT_CSV) {
+    uint64_t fields[6] = {batchFirst_, games, results_[1], results_[2], results_[3], results_[0]};
+    for (int i = 0; i < 6; i++) {
+      p = putUint(p, fields[i]);
+      *p++ = (i < 5) ? ',' : '\n';
+    }
+  } else {
+    p = putUint(put(p, TEXT("{\"first_game\":")), batchFirst_);
+    p = putUint(put(p, TEXT(",\"games\":")), games);
+    p = putUint(put(p, TEXT(",\"user_won\":")), results_[resultCode(USER_WON)]);
+    p = putUint(put(p, TEXT(",\"computer_won\":")), results_[resultCode(COMPUTER_WON)]);
+    p = putUint(put(p, TEXT(",\"draw\":")), results_[resultCode(DRAW)]);
+    p = putUint(put(p, TEXT(",\"in_progress\":")), results_[resultCode(IN_PROGRESS)]);
+    p = put(p, TEXT("}\n"));
+  }
+  used_ = p - buffer_.get();
+  batchFirst_ = games_;
+  memset(results_, 0, sizeof(results_));
+}
+
+bool ResultWriter::flush() {
+  const char* p = buffer_.get();
+  size_t len = used_;
+  used_ = 0;
+  while (len > 0 && !failed_) {
+    ssize_t n = ::write(fd_, p, len);
+    if (n < 0 && errno == EINTR) { continue; }
+    if (n < 0) {
+      failed_ = true;
+      break;
+    }
+    p += n;
+    len -= n;
+  }
+  return !failed_;
+}
+
+bool ResultWriter::finish() {
+  if (batch_ && games_ > batchFirst_) { summary(); }
+  return flush();
+}
@@ -0,0 +1,91 @@
+#ifndef TICTACTOE_RESULT_WRITER_H
+#define TICTACTOE_RESULT_WRITER_H
+
+#include "game_record.h"
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+
+/**
+ * Structured results of headless runs, one line per game or per batch of
+ * games, as NDJSON or CSV:
+ *
+ *   {"game":0,"seed":0,"user":"random","computer":"smart","first":"user","result":"computer_won","moves":"40812"}
+ *   game,seed,user,computer,first,result,moves       (CSV, after a header line)
+ *
+ * `moves` lists the cells claimed in order, one digit each (row * 3 +
+ * col). With a batch size, each line instead sums up that many games:
+ *
+ *   {"first_game":0,"games":100000,"user_won":..,"computer_won":..,"draw":..,"in_progress":..}
+ *
+ * Lines are formatted straight into a large buffer, without printf or
+ * any per-line allocation, and written out only when it is full, so
+ * output keeps up with simulation. Not thread safe; use one writer per
+ * output.
+ */
+
+enum {OUTPUT_NDJSON, OUTPUT_CSV};
+
+class ResultWriter {
+ public:
+  static const size_t BUFFER_BYTES = 1 << 20;
+
+  /**
+   * Write to `fd`, which is left open.
+   *
+   * @param int      format  OUTPUT_NDJSON or OUTPUT_CSV
+   * @param uint64_t batch   Games per summary line, 0 for a line per game
+   */
+  ResultWriter(int fd, int format, uint64_t batch = 0);
+  ~ResultWriter() { finish(); }
+  ResultWriter(const ResultWriter&) = delete;
+  ResultWriter& operator=(const ResultWriter&) = delete;
+
+  /** @return bool  false (errno set) if a full buffer could not be written */
+  bool write(const GameRecord& game) {
+    if (batch_) {
+      results_[resultCode(game.status)]++;
+      if (++games_ - batchFirst_ == batch_) { summary(); }
+    } else {
+      line(game);
+      games_++;
+    }
+    return used_ + MAX_LINE <= BUFFER_BYTES || flush();
+  }
+
+  /**
+   * Write the summary of a partial last batch and whatever is buffered.
+   *
+   * @return bool  false (errno set) if any output failed
+   */
+  bool finish();
+
+  uint64_t games() const { return games_; }
+
+ private:
+  static const size_t MAX_LINE = 256;
+
+  /** Text of a line between the seed and the moves. */
+  struct Fragment {
+    char   chars[96];
+    size_t length;
+  };
+
+  void header();
+  void line(const GameRecord& game);
+  void summary();
+  bool flush();
+
+  int                     fd_;
+  int                     format_;
+  bool                    failed_;
+  uint64_t                batch_;
+  uint64_t                games_;
+  uint64_t                batchFirst_;   // first game of the current batch
+  uint64_t                results_[4];   // of the current batch, by `resultCode`
+  std::unique_ptr<char[]> buffer_;
+  size_t                  used_;
+  Fragment                fragments_[5 * 5 * 2 * 4];   // by strategies, first mover, result
+};
+
+#endif
@@ -0,0 +1,176 @@
+#include "server.h"
+#include "net.h"
+#include <algorithm>
+#include <cerrno>
+#include <cstdlib>
+#include <cstring>
+#include <new>
+#include <ctime>
+#include <pthread.h>
+#include <unistd.h>
+using namespace std;
+
+SharedBuffer* SharedBuffer::create(const void* data, size_t len) {
+  void* mem = malloc(sizeof(SharedBuffer) + len);
+  if (!mem) { throw std::bad_alloc(); }
+  SharedBuffer* buf = new (mem) SharedBuffer(len);
+  memcpy(static_cast<char*>(mem) + sizeof(SharedBuffer), data, len);
+  return buf;
+}
+
+void SharedBuffer::release() {
+  if (refs_.fetch_sub(1, memory_order_acq_rel) == 1) {
+    this->~SharedBuffer();
+    free(this);
+  }
+}
+
+Connection::~Connection() {
+  for (unsigned i = 0; i < sharedCount; i++) { shared[(sharedHead + i) % SHARED_SLOTS]->release(); }
+}
+
+bool Connection::reply(const void* data, size_t len) {
+  if (len > outSpace()) { return false; }
+  memcpy(out + outLen, data, len);
+  outLen += len;
+  return true;
+}
+
+bool Connection::share(SharedBuffer* buf) {
+  if (sharedCount == SHARED_SLOTS) { return false; }
+  buf->retain();
+  shared[(sharedHead + sharedCount) % SHARED_SLOTS] = buf;
+  sharedCount++;
+  return true;
+}
+
+unsigned Connection::dropShared() {
+  // Buffers being written, or partly written, have to go out whole
+  unsigned keep = max(sharedLocked, sharedOff > 0 ? 1u : 0u);
+  unsigned dropped = sharedCount > keep ? sharedCount - keep : 0;
+  for (unsigned i = keep; i < sharedCount; i++) { shared[(sharedHead + i) % SHARED_SLOTS]->release(); }
+  sharedCount -= dropped;
+  return dropped;
+}
+
+int Connection::gather(iovec* iov) {
+  int n = 0;
+  unsigned next = 0;
+  // A partly written shared buffer comes first so that its bytes stay
+  // together; own output queued since then follows it
+  if (sharedOff > 0) {
+    SharedBuffer* buf = shared[sharedHead];
+    iov[n++] = iovec{const_cast<char*>(buf->data()) + sharedOff, buf->size() - sharedOff};
+    next = 1;
+  }
+  if (outOff < outLen) { iov[n++] = iovec{out + outOff, outLen - outOff}; }
+  for (; next < sharedCount; next++) {
+    SharedBuffer* buf = shared[(sharedHead + next) % SHARED_SLOTS];
+    iov[n++] = iovec{const_cast<char*>(buf->data()), buf->size()};
+  }
+  gatheredOut  = outLen;
+  sharedLocked = sharedCount;
+  return n;
+}
+
+void Connection::written(size_t n) {
+  sharedLocked = 0;
+  // Consume the bytes in the order `gather` laid them out
+  bool headFirst = sharedOff > 0;
+  auto consumeShared = [this](size_t& n) {
+    SharedBuffer* buf = shared[sharedHead];
+    size_t take = min(n, buf->size() - sharedOff);
+    sharedOff += take;
+    n -= take;
+    if (sharedOff < buf->size()) { return false; }
+    buf->release();
+    sharedHead = (sharedHead + 1) % SHARED_SLOTS;
+    sharedCount--;
+    sharedOff = 0;
+    return true;
+  };
+  if (headFirst && !consumeShared(n)) { return; }
+  size_t take = min(n, gatheredOut - min(outOff, gatheredOut));
+  outOff += take;
+  n -= take;
+  if (outOff == outLen) { outOff = outLen = 0; }
+  while (n > 0 && consumeShared(n)) {}
+}
+
+bool Server::start(const ServerConfig& config, HandlerFactory factory, void* context) {
+  listenFd_ = listenOn(config.address);
+  if (listenFd_ < 0) { return false; }
+
+  for (int i = 0; i < config.threads; i++) {
+    Handler* handler = factory(i, context);
+    if (!handler) {
+      int saved = errno;
+      stop();
+      errno = saved;
+      return false;
+    }
+    handlers_.push_back(handler);
+    Reactor* reactor = (config.backend == BACKEND_URING) ? makeUringReactor(listenFd_, handler)
+                                                         : makeEpollReactor(listenFd_, handler);
+    if (!reactor) {
+      int saved = errno;
+      stop();
+      errno = saved;
+      return false;
+    }
+    reactors_.push_back(reactor);
+  }
+  for (int i = 0; i < config.threads; i++) { handlers_[i]->onStart(*this, i); }
+  for (Reactor* reactor : reactors_) {
+    threads_.emplace_back([reactor] { reactor->run(); });
+  }
+  return true;
+}
+
+void Server::stop() {
+  for (Reactor* reactor : reactors_) { reactor->stop(); }
+  for (thread& t : threads_)         { t.join(); }
+  for (Reactor* reactor : reactors_) { delete reactor; }
+  for (Handler* handler : handlers_) { delete handler; }
+  threads_.clear();
+  reactors_.clear();
+  handlers_.clear();
+  if (listenFd_ >= 0) {
+    close(listenFd_);
+    listenFd_ = -1;
+  }
+}
+
+double Server::cpuSeconds() const {
+  double total = 0;
+  for (const thread& t : threads_) {
+    clockid_t clock;
+    timespec ts;
+    if (pthread_getcpuclockid(const_cast<thread&>(t).native_handle(), &clock) == 0 && clock_gettime(clock, &ts) == 0) {
+      total += ts.tv_sec + ts.tv_nsec / 1e9;
+    }
+  }
+  return total;
+}
+
+PoolStats Server::connectionStats() const {
+  PoolStats total = {0, 0, 0};
+  for (const Reactor* reactor : reactors_) {
+    PoolStats s = reactor->connectionStats();
+    total.live += s.live;
+    total.capacity += s.capacity;
+    total.bytes += s.bytes;
+  }
+  return total;
+}
+
+PoolStats Server::sessionStats() const {
+  PoolStats total = {0, 0, 0};
+  for (const Handler* handler : handlers_) {
+    PoolStats s = handler->sessionStats();
+    total.live += s.live;
+    total.capacity += s.capacity;
+    total.bytes += s.bytes;
+  }
+  return total;
+}
@@ -0,0 +1,247 @@
+#ifndef TICTACTOE_SERVER_H
+#define TICTACTOE_SERVER_H
+
+#include "slab.h"
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <sys/uio.h>
+#include <thread>
+#include <vector>
+
+/**
+ * Event-driven server skeleton. The server runs one reactor per thread;
+ * each reactor owns its connections and a protocol `Handler`, so nothing
+ * on the request path is shared between threads. All reactors accept
+ * from the same listening socket.
+ */
+
+class Handler;
+class Reactor;
+class Server;
+
+/**
+ * Immutable, reference-counted block of output that many connections
+ * send without copying it, such as an event broadcast to every watcher of
+ * a game. Encoded once, queued on each connection with
+ * `Connection::share`, and freed when the last connection has written
+ * it. References may be taken and dropped from any thread.
+ */
+class SharedBuffer {
+ public:
+  /** A buffer holding a copy of `data`, with one reference. */
+  static SharedBuffer* create(const void* data, size_t len);
+
+  void retain() { refs_.fetch_add(1, std::memory_order_relaxed); }
+  void release();
+
+  const char* data() const { return reinterpret_cast<const char*>(this + 1); }
+  size_t      size() const { return size_; }
+
+ private:
+  SharedBuffer(size_t len): refs_(1), size_(len) {}
+
+  std::atomic<uint32_t> refs_;
+  uint32_t              size_;
+};
+
+/**
+ * A client connection. Input and output buffers are allocated once with
+ * the connection; a handler that cannot fit a reply in the output buffer
+ * stops consuming input until the reactor has drained it, which pushes
+ * back on clients that pipeline faster than they read.
+ *
+ * Besides its own output buffer, a connection has a short queue of
+ * shared buffers, written after `out` with one scatter-gather write.
+ */
+struct Connection {
+  static const size_t   BUFFER_SIZE  = 16 * 1024;
+  static const unsigned SHARED_SLOTS = 32;
+
+  int    fd;
+  size_t inLen;            // bytes of unprocessed input in `in`
+  size_t outLen;           // bytes of pending output in `out`
+  size_t outOff;           // bytes of `out` already written
+  bool   closing;          // close once the output has drained
+  bool   paused;           // the handler left input for the next iteration
+  void*  user;             // per-connection state owned by the handler
+
+  // Reactor bookkeeping
+  bool     dead;           // closed, freed at the end of the tick
+  bool     flushPending;   // on the reactor's flush list
+  bool     backlogged;     // on the reactor's list of input to process next iteration
+  unsigned interest;       // events currently requested from the kernel
+  uint32_t slot;           // index in the reactor's connection pool
+
+  // Shared output: a ring of SHARED_SLOTS buffers starting at `sharedHead`
+  SharedBuffer* shared[SHARED_SLOTS];
+  unsigned      sharedHead;
+  unsigned      sharedCount;
+  size_t        sharedOff;     // bytes of the head buffer already written
+  unsigned      sharedLocked;  // head buffers in a write still in flight
+  size_t        gatheredOut;   // end of `out` as of the last `gather`
+
+  char   in[BUFFER_SIZE];
+  char   out[BUFFER_SIZE];
+
+  explicit Connection(int f): fd(f), inLen(0), outLen(0), outOff(0), closing(false), paused(false), user(nullptr),
+                               dead(false), flushPending(false), backlogged(false), interest(0), slot(0),
+                               sharedHead(0), sharedCount(0), sharedOff(0), sharedLocked(0), gatheredOut(0) {}
+  ~Connection();
+
+  size_t outSpace() const { return BUFFER_SIZE - outLen; }
+
+  /** Output, own or shared, that has not been written yet. */
+  bool hasOutput() const { return outOff < outLen || sharedCount > 0; }
+
+  /**
+   * Queue `len` bytes of output.
+   *
+   * @return bool  false (nothing queued) if there is not enough room
+   */
+  bool reply(const void* data, size_t len);
+
+  /**
+   * Queue a reference to `buf`, to be written after the output queued so
+   * far. The handler must then ask the reactor to flush the connection
+   * (`Reactor::queueOutput`) unless it is in `onData`.
+   *
+   * @return bool  false (nothing queued) if the shared queue is full
+   */
+  bool share(SharedBuffer* buf);
+
+  /**
+   * Drop the queued shared buffers that have not started going out, to
+   * make room; used to cut off a consumer that falls behind.
+   *
+   * @return unsigned  Buffers dropped
+   */
+  unsigned dropShared();
+
+  // Reactor side: the pending output as an iovec list, in write order, and
+  // accounting for `n` bytes of it written. `iov` needs SHARED_SLOTS + 1
+  // entries. `written` must follow the `gather` it refers to, but output
+  // may be queued in between.
+  int  gather(iovec* iov);
+  void written(size_t n);
+};
+
+/**
+ * Protocol logic plugged into a reactor. A reactor calls its handler
+ * from a single thread only.
+ */
+class Handler {
+ public:
+  virtual ~Handler() {}
+
+  /**
+   * Process complete requests at the front of `data`, queueing replies
+   * on `conn`. Unconsumed bytes are presented again, with more data
+   * appended, on the next call. A handler that stops early with output
+   * space to spare (to bound the work done per iteration) sets
+   * `conn.paused`, and is called again on the next iteration even if no
+   * more data arrives.
+   *
+   * @return size_t  The number of bytes consumed
+   */
+  virtual size_t onData(Connection& conn, const char* data, size_t len) = 0;
+
+  /** The connection is about to be closed and freed. */
+  virtual void onClose(Connection& conn) { (void)conn; }
+
+  /**
+   * End of an event loop iteration, before output is flushed. Output
+   * queued by `onData` is never sent before the following `onTick`, so a
+   * handler may reserve room for a reply in `onData` and fill it in here.
+   */
+  virtual void onTick() {}
+
+  /**
+   * Occupancy of the pool holding per-client state, such as game
+   * sessions; zero for handlers without one. Safe to call from any thread.
+   */
+  virtual PoolStats sessionStats() const { return PoolStats{0, 0, 0}; }
+
+  /**
+   * Called by `Server::start` once all reactors exist and before any of
+   * them runs, with the index this handler was created for. Handlers
+   * that talk to each other look their peers up through `server`.
+   */
+  virtual void onStart(Server& server, int index) { (void)server; (void)index; }
+};
+
+/** Creates the handler for reactor `index`; nullptr (errno set) on failure. */
+typedef Handler* (*HandlerFactory)(int index, void* context);
+
+/** Event loop interface implemented by each network backend. */
+class Reactor {
+ public:
+  virtual ~Reactor() {}
+  /** Serve connections until `stop` is called. */
+  virtual void run() = 0;
+  /** Ask `run` to return; safe to call from any thread. */
+  virtual void stop() = 0;
+  /** Make `run` go through an iteration soon; safe to call from any thread. */
+  virtual void wake() = 0;
+  /**
+   * Write the output of `conn` at the end of this iteration. Only needed
+   * for output queued outside `onData`; reactor thread only.
+   */
+  virtual void queueOutput(Connection& conn) = 0;
+  /** Occupancy of the connection pool; safe to call from any thread. */
+  virtual PoolStats connectionStats() const = 0;
+};
+
+/** Network backends; both serve the same handlers. */
+enum {BACKEND_EPOLL, BACKEND_URING};
+
+Reactor* makeEpollReactor(int listenFd, Handler* handler);
+
+/** Returns nullptr (errno set) if the kernel does not support io_uring. */
+Reactor* makeUringReactor(int listenFd, Handler* handler);
+
+struct ServerConfig {
+  std::string address;            // see net.h for the format
+  int         threads = 1;        // reactors, normally one per core
+  int         backend = BACKEND_EPOLL;
+};
+
+/**
+ * Owns the listening socket, the reactors and their threads.
+ */
+class Server {
+ public:
+  Server(): listenFd_(-1) {}
+  ~Server() { stop(); }
+
+  /**
+   * Bind the address and start one reactor thread per `config.threads`.
+   *
+   * @return bool  false (errno set) if the address could not be bound or
+   *               a handler could not be created
+   */
+  bool start(const ServerConfig& config, HandlerFactory factory, void* context);
+
+  /** Stop all reactors and wait for their threads to exit. */
+  void stop();
+
+  /** CPU time consumed so far by the reactor threads, in seconds. */
+  double cpuSeconds() const;
+
+  int      threads() const        { return (int)reactors_.size(); }
+  Handler* handler(int index)     { return handlers_[index]; }
+  Reactor* reactor(int index)     { return reactors_[index]; }
+
+  /** Pool occupancy summed over the reactors (see `Handler::sessionStats`). */
+  PoolStats connectionStats() const;
+  PoolStats sessionStats() const;
+
+ private:
+  int                      listenFd_;
+  std::vector<Handler*>    handlers_;
+  std::vector<Reactor*>    reactors_;
+  std::vector<std::thread> threads_;
+};
+
+#endif
@@ -0,0 +1,120 @@
+#include "session.h"
+#include "engine.h"
+#include <string>
+
+int sessionApplyMove(Session& session, int cell) {
+  if (!sessionLegal(session, cell)) { return -1; }
+  sessionClaim(session, cell);
+  return session.status;
+}
+
+int sessionComputerMove(Session& session) {
+  if (session.status != IN_PROGRESS || session.toMove != COMPUTER) { return -1; }
+  int board[3][3];
+  for (int i = 0; i < 9; i++) { board[i / 3][i % 3] = sessionCell(session, i); }
+  Cell c = chooseMove(board, COMPUTER, session.strategy);
+  int cell = c.row * 3 + c.col;
+  sessionApplyMove(session, cell);
+  return cell;
+}
+
+namespace {
+
+Session freshSession(int strategy, int first) {
+  Session s = {};
+  s.strategy = strategy;
+  s.toMove   = first;
+  s.status   = IN_PROGRESS;
+  return s;
+}
+
+}
+
+bool SessionShard::open(const char* path) {
+  std::string name = std::string(path) + "." + std::to_string(shard_);
+  size_t maxSlabs = ((size_t)1 << SLOT_BITS) / SESSIONS_PER_SLAB;
+  std::unique_ptr<SessionStore> store(new SessionStore());
+  if (!store->open(name.c_str(), shard_, sizeof(Session), slots_.slabBytes(), maxSlabs)) { return false; }
+  store_ = std::move(store);
+  if (!slots_.attach(store_.get(), store_->header().capacity, [this] {
+        store_->replay([this](const LogRecord& record) { replay(record); });
+      })) {
+    return false;
+  }
+  store_->checkpoint();
+
+  // Their replies were lost with the old process; make the moves now so
+  // that the users find it their turn
+  for (uint32_t slot = 0; slot < store_->header().capacity; slot++) {
+    if (!slots_.live(slot)) { continue; }
+    Session& s = slots_[slot];
+    if (s.status != IN_PROGRESS || s.toMove != COMPUTER) { continue; }
+    uint32_t id = idOf(slot);
+    int board[3][3];
+    for (int i = 0; i < 9; i++) { board[i / 3][i % 3] = sessionCell(s, i); }
+    Cell c = chooseMove(board, COMPUTER, s.strategy);
+    logMove(id, s, c.row * 3 + c.col);
+    sessionClaim(s, c.row * 3 + c.col);
+  }
+  store_->checkpoint();
+  return true;
+}
+
+/**
+ * Redo the change in `record`, unless it was already made. The session
+ * may be further along than the record (later changes made it to the
+ * file too) but never behind the change before it, so a move is only
+ * made again when the session is right before it or, having been
+ * interrupted half way, right after it.
+ */
+void SessionShard::replay(const LogRecord& record) {
+  if (record.slot >= store_->header().capacity) { return; }
+  switch (record.kind) {
+    case LOG_NEW:
+      slots_.put(record.slot, freshSession(record.a, record.b));
+      return;
+    case LOG_CLOSE:
+      // Moves the generation on too, if the close did not get that far
+      slots_.erase(record.slot);
+      return;
+    case LOG_MOVE: {
+      if (!slots_.live(record.slot)) { return; }
+      Session& s = slots_[record.slot];
+      unsigned bit = 1u << record.b;
+      int ply = sessionPly(s);
+      bool claimed = (s.user | s.computer) & bit;
+      bool before = (ply == record.a && !claimed);
+      bool after  = (ply == record.a + 1 && claimed && sessionHistory(s, record.a) == record.b);
+      if (!before && !after) { return; }
+      s.user &= ~bit;
+      s.computer &= ~bit;
+      s.toMove = record.c;
+      sessionClaim(s, record.b);
+      return;
+    }
+  }
+}
+
+uint32_t SessionShard::create(int strategy, int first) {
+  uint32_t slot = slots_.create(freshSession(strategy, first));
+  if (slot == slots_.NONE) { return NO_SESSION; }
+  if (slot >= (1u << SLOT_BITS) - 1) {
+    // No room left in the id (the last slot would make NO_SESSION in the
+    // last shard); the slot goes back to the front of the free list
+    slots_.destroy(slot);
+    return NO_SESSION;
+  }
+  // Logged once made, since only then is the slot known; a crash before
+  // that loses a game whose id nobody was told
+  if (store_) {
+    store_->header().capacity = slots_.stats().capacity;
+    store_->append(LogRecord{slot, LOG_NEW, (uint8_t)strategy, (uint8_t)first, 0});
+  }
+  return idOf(slot);
+}
+
+void SessionShard::destroy(uint32_t id) {
+  if (!find(id)) { return; }
+  if (store_) { store_->append(LogRecord{slotOf(id), LOG_CLOSE, 0, 0, 0}); }
+  slots_.destroy(slotOf(id));
+}
@@ -0,0 +1,174 @@
+#ifndef TICTACTOE_SESSION_H
+#define TICTACTOE_SESSION_H
+
+#include "bitboard.h"
+#include "session_store.h"
+#include "slab.h"
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+
+/**
+ * Compact state of one hosted game: the same information main() keeps
+ * for the interactive game, packed into bytes so that a server can hold
+ * millions of them. The board is kept as bitboards (see bitboard.h), and
+ * `history` has the cell of every move so far, one per nibble, move `i`
+ * in the low nibble of byte `i / 2` when `i` is even.
+ */
+struct Session {
+  uint16_t user;        // cells owned by the user
+  uint16_t computer;    // cells owned by the computer
+  uint8_t  history[5];
+  uint8_t  strategy;    // strategy the computer plays with
+  uint8_t  toMove;      // USER or COMPUTER
+  uint8_t  status;      // IN_PROGRESS, USER_WON, ...
+};
+
+/** Number of moves played in `session`. */
+inline int sessionPly(const Session& session) {
+  return __builtin_popcount(session.user | session.computer);
+}
+
+/** Cell played by move `ply` (counted from 0) of `session`. */
+inline int sessionHistory(const Session& session, int ply) {
+  return (session.history[ply / 2] >> (4 * (ply % 2))) & 0xF;
+}
+
+/** The contents of `cell`: EMPTY, USER or COMPUTER. */
+inline int sessionCell(const Session& session, int cell) {
+  return ((session.user >> cell) & 1) ? USER : ((session.computer >> cell) & 1) ? COMPUTER : EMPTY;
+}
+
+/** Whether the player to move may claim `cell`. */
+inline bool sessionLegal(const Session& session, int cell) {
+  return cell >= 0 && cell <= 8 && session.status == IN_PROGRESS && sessionCell(session, cell) == EMPTY;
+}
+
+/**
+ * Claim `cell`, which must be legal, for the player to move, record it
+ * in the history and pass the turn.
+ */
+inline void sessionClaim(Session& session, int cell) {
+  int ply = sessionPly(session);
+  uint8_t& entry = session.history[ply / 2];
+  entry = (ply % 2) ? ((entry & 0x0F) | (cell << 4)) : cell;
+  if (session.toMove == USER) {
+    session.user |= 1u << cell;
+  } else {
+    session.computer |= 1u << cell;
+  }
+  session.status = bitboardStatus(session.user, session.computer);
+  session.toMove = (session.toMove == USER) ? COMPUTER : USER;
+}
+
+/**
+ * Claim `cell` for the player to move and pass the turn.
+ *
+ * @return int  The status after the move, or -1 if the move is illegal
+ */
+int sessionApplyMove(Session& session, int cell);
+
+/**
+ * Let the computer move if it is its turn.
+ *
+ * @return int  The cell played, or -1 if no move was made
+ */
+int sessionComputerMove(Session& session);
+
+/**
+ * The sessions owned by one reactor, kept in a slab pool so that the
+ * shard grows a slab at a time instead of reallocating, and a session
+ * never moves while it is live. Session ids carry the index of the
+ * owning shard in their low byte, then the slot in this shard, then the
+ * slot's generation in the top bits, so that the id of a closed session
+ * is not taken for the next session in its slot. The generation has
+ * GENERATION_BITS bits, so an id only stays dead until its slot has been
+ * reused 16 times; clients must not hold on to closed ids longer.
+ * Not thread safe: a shard is only touched by its reactor, except for
+ * `stats()`.
+ *
+ * A shard may be kept in a file (see session_store.h) with `open`, to
+ * survive restarts. Changes to its sessions must then be announced with
+ * `logMove` and made final with `checkpoint`.
+ */
+class SessionShard {
+ public:
+  static const int SHARD_BITS = 8;
+
+  static const int SLOT_BITS = 20;
+
+  static const int GENERATION_BITS = 32 - SHARD_BITS - SLOT_BITS;
+
+  static const size_t SESSIONS_PER_SLAB = 4096;
+
+  static const uint32_t NO_SESSION = 0xFFFFFFFF;
+
+  explicit SessionShard(int shard): shard_(shard) {}
+
+  /**
+   * Keep the sessions in the file at `path`, taking back those it holds.
+   * Games that were waiting for the computer get its move. Must be
+   * called before any session is created.
+   *
+   * @return bool  false (errno set) if the file cannot be used
+   */
+  bool open(const char* path);
+
+  /**
+   * Start a new game.
+   *
+   * @param  int strategy  Strategy the computer plays with
+   * @param  int first     Player to move first (USER or COMPUTER)
+   * @return uint32_t      Id of the new session, or NO_SESSION if the
+   *                       shard is full
+   */
+  uint32_t create(int strategy, int first);
+
+  /** The session with `id`, or nullptr if it is not live in this shard. */
+  Session* find(uint32_t id) {
+    uint32_t slot = slotOf(id);
+    if (shardOf(id) != shard_ || !slots_.live(slot) || idOf(slot) != id) { return nullptr; }
+    return &slots_[slot];
+  }
+
+  /**
+   * Where the session with `id` is stored, without checking that it is
+   * live; only for ids `find` has accepted. Cheap enough to prefetch.
+   */
+  Session* slot(uint32_t id) { return &slots_[slotOf(id)]; }
+
+  /** End the session with `id`; unknown ids are ignored. */
+  void destroy(uint32_t id);
+
+  /** `s`, the session with `id`, is about to claim `cell`. */
+  void logMove(uint32_t id, const Session& s, int cell) {
+    if (store_) { store_->append(LogRecord{slotOf(id), LOG_MOVE, (uint8_t)sessionPly(s), (uint8_t)cell, s.toMove}); }
+  }
+
+  /** Every change announced so far has been made. */
+  void checkpoint() {
+    if (store_) { store_->checkpoint(); }
+  }
+
+  size_t live() const { return slots_.stats().live; }
+
+  PoolStats stats() const { return slots_.stats(); }
+
+  static int shardOf(uint32_t id) { return id & ((1u << SHARD_BITS) - 1); }
+
+  static uint32_t slotOf(uint32_t id) { return (id >> SHARD_BITS) & ((1u << SLOT_BITS) - 1); }
+
+ private:
+  void replay(const LogRecord& record);
+
+  uint32_t idOf(uint32_t slot) const {
+    uint32_t generation = slots_.generation(slot) & ((1u << GENERATION_BITS) - 1);
+    return (generation << (SHARD_BITS + SLOT_BITS)) | (slot << SHARD_BITS) | shard_;
+  }
+
+  int                                   shard_;
+  std::unique_ptr<SessionStore>         store_;
+  SlabPool<Session, SESSIONS_PER_SLAB>  slots_;
+};
+
+#endif
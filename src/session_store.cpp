@@ -0,0 +1,87 @@
+#include "session_store.h"
+#include <cerrno>
+#include <cstring>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace {
+
+const size_t PAGE = 4096;
+
+/** The file grows this much at a time, so growing is rare. */
+const size_t GROWTH = 1 << 20;
+
+size_t roundUp(size_t n, size_t to) { return (n + to - 1) / to * to; }
+
+}
+
+SessionStore::~SessionStore() {
+  if (base_) { munmap(base_, reserved_); }
+  if (fd_ >= 0) { close(fd_); }
+}
+
+bool SessionStore::open(const char* path, int shard, size_t objectBytes, size_t slabBytes, size_t maxSlabs) {
+  fd_ = ::open(path, O_RDWR | O_CREAT | O_CLOEXEC, 0644);
+  if (fd_ < 0) { return false; }
+  struct stat st;
+  if (fstat(fd_, &st) < 0) { return false; }
+
+  slabBytes_ = slabBytes;
+  dataStart_ = PAGE + roundUp(LOG_RECORDS * sizeof(LogRecord), PAGE);
+  // Reserve address space for the largest the file can get, so that the
+  // mapping can grow in place and slabs never move
+  reserved_ = roundUp(dataStart_ + maxSlabs * slabBytes, PAGE);
+  void* mem = mmap(nullptr, reserved_, PROT_NONE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0);
+  if (mem == MAP_FAILED) {
+    base_ = nullptr;
+    return false;
+  }
+  base_ = static_cast<char*>(mem);
+
+  bool fresh = (st.st_size == 0);
+  if (!grow(fresh ? dataStart_ : st.st_size)) { return false; }
+  header_ = reinterpret_cast<StoreHeader*>(base_);
+  log_    = reinterpret_cast<LogRecord*>(base_ + PAGE);
+
+  if (fresh) {
+    header_->version     = StoreHeader::VERSION;
+    header_->shard       = shard;
+    header_->objectBytes = objectBytes;
+    header_->slabBytes   = slabBytes;
+    // Last, so a file is only ever recognized once it is initialized
+    std::atomic_signal_fence(std::memory_order_release);
+    header_->magic = StoreHeader::MAGIC;
+    return true;
+  }
+  if (header_->magic != StoreHeader::MAGIC || header_->version != StoreHeader::VERSION ||
+      header_->shard != (uint32_t)shard || header_->objectBytes != objectBytes ||
+      header_->slabBytes != slabBytes || header_->capacity > maxSlabs * (slabBytes / objectBytes)) {
+    errno = EINVAL;
+    return false;
+  }
+  return true;
+}
+
+void* SessionStore::slab(size_t index, size_t bytes) {
+  size_t end = dataStart_ + (index + 1) * slabBytes_;
+  if (bytes != slabBytes_ || end > reserved_) { return nullptr; }
+  if (end > mapped_ && !grow(end)) { return nullptr; }
+  return base_ + dataStart_ + index * slabBytes_;
+}
+
+/** Make the file, and its mapping, at least `bytes` long. */
+bool SessionStore::grow(size_t bytes) {
+  if (bytes <= mapped_) { return true; }
+  size_t size = roundUp(bytes, mapped_ ? GROWTH : PAGE);
+  if (size > reserved_) { size = reserved_; }
+  struct stat st;
+  if (fstat(fd_, &st) < 0) { return false; }
+  // New file space reads as zeros, which is what a new slab should be
+  if ((size_t)st.st_size < size && ftruncate(fd_, size) < 0) { return false; }
+  void* mem = mmap(base_ + mapped_, size - mapped_, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_FIXED, fd_, mapped_);
+  if (mem == MAP_FAILED) { return false; }
+  mapped_ = size;
+  return true;
+}
@@ -0,0 +1,124 @@
+#ifndef TICTACTOE_SESSION_STORE_H
+#define TICTACTOE_SESSION_STORE_H
+
+#include "slab.h"
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+
+/**
+ * File that keeps one SessionShard's sessions across restarts. The
+ * shard's slabs are mapped straight from the file, so sessions are
+ * updated in place and nothing is ever serialized: a new process maps
+ * the file and its sessions are back, at the same ids.
+ *
+ * Layout, all in host byte order:
+ *
+ *   page 0          StoreHeader
+ *   page 1..        write-ahead log, LOG_RECORDS LogRecords in a ring
+ *   after the log   the slabs, one after the other
+ *
+ * The log covers the one thing the mapping does not: a process killed
+ * in the middle of updating a session. Moves and closes are logged
+ * before they are made, new sessions right after, and `checkpoint` (once
+ * per event loop iteration) marks every change logged so far as complete. A restart replays the few records
+ * after the checkpoint; replaying a change that was already made leaves
+ * the session as it is.
+ *
+ * The files are written back by the kernel, so a restart or crash of
+ * the process loses nothing, but a crash of the machine loses what had
+ * not been written back yet.
+ */
+
+enum {LOG_NEW = 1, LOG_MOVE, LOG_CLOSE};
+
+/** A change to one session. */
+struct LogRecord {
+  uint32_t slot;      // of the session in the shard
+  uint8_t  kind;      // LOG_NEW, LOG_MOVE or LOG_CLOSE
+  uint8_t  a;         // LOG_NEW: strategy   LOG_MOVE: ply of the move
+  uint8_t  b;         // LOG_NEW: first      LOG_MOVE: cell
+  uint8_t  c;         //                     LOG_MOVE: player
+};
+
+struct StoreHeader {
+  static const uint64_t MAGIC   = 0x4554415453545454;  // "TTTSTATE"
+  static const uint32_t VERSION = 2;
+
+  uint64_t magic;
+  uint32_t version;
+  uint32_t shard;
+  uint32_t objectBytes;  // sizeof(Session)
+  uint32_t slabBytes;
+  uint64_t capacity;     // slots the shard's pool has handed out
+  uint64_t checkpoint;   // log records before this one are complete
+  uint64_t next;         // number of the next log record
+};
+
+class SessionStore : public SlabSource {
+ public:
+  static const size_t LOG_RECORDS = 8192;
+
+  SessionStore()
+    : fd_(-1), base_(nullptr), reserved_(0), mapped_(0), slabBytes_(0), dataStart_(0), header_(nullptr), log_(nullptr) {}
+  SessionStore(const SessionStore&) = delete;
+  SessionStore& operator=(const SessionStore&) = delete;
+  ~SessionStore();
+
+  /**
+   * Open or create the file at `path` and map what it holds. An existing
+   * file must have been written for the same shard and layout.
+   *
+   * @param  char*  path        File name
+   * @param  int    shard       Index of the shard it belongs to
+   * @param  size_t objectBytes Size of a session
+   * @param  size_t slabBytes   Size of a slab of the shard's pool
+   * @param  size_t maxSlabs    Most slabs the pool will ever ask for
+   * @return bool               false (errno set) on failure
+   */
+  bool open(const char* path, int shard, size_t objectBytes, size_t slabBytes, size_t maxSlabs);
+
+  void* slab(size_t index, size_t bytes);
+
+  StoreHeader& header() { return *header_; }
+
+  /** Log `record` before making the change it describes. */
+  void append(const LogRecord& record) {
+    uint64_t next = header_->next;
+    // Every change before this one is complete, so the ring never has to
+    // keep more than the records since the last checkpoint
+    if (next - header_->checkpoint >= LOG_RECORDS) { header_->checkpoint = next; }
+    log_[next % LOG_RECORDS] = record;
+    // A killed process leaves its stores in memory in program order as
+    // long as the compiler keeps them in that order
+    std::atomic_signal_fence(std::memory_order_release);
+    header_->next = next + 1;
+    std::atomic_signal_fence(std::memory_order_release);
+  }
+
+  /** Everything logged so far has been done. */
+  void checkpoint() {
+    std::atomic_signal_fence(std::memory_order_release);
+    header_->checkpoint = header_->next;
+  }
+
+  /** Call `f(const LogRecord&)` on every record after the checkpoint, in order. */
+  template <typename F>
+  void replay(F f) const {
+    for (uint64_t seq = header_->checkpoint; seq < header_->next; seq++) { f(log_[seq % LOG_RECORDS]); }
+  }
+
+ private:
+  bool grow(size_t bytes);
+
+  int          fd_;
+  char*        base_;       // address space reserved for the whole file
+  size_t       reserved_;
+  size_t       mapped_;     // bytes of the file mapped so far
+  size_t       slabBytes_;
+  size_t       dataStart_;  // offset of the first slab
+  StoreHeader* header_;
+  LogRecord*   log_;
+};
+
+#endif
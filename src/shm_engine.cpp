@@ -0,0 +1,118 @@
+#include "shm_engine.h"
+#include "engine.h"
+#include <chrono>
+#include <fcntl.h>
+#include <new>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <thread>
+#include <unistd.h>
+using namespace std;
+
+int runShmEngine(const char* name) {
+  // Start from a fresh object so no client can see a stale region
+  shm_unlink(name);
+  int fd = shm_open(name, O_CREAT | O_EXCL | O_RDWR, 0600);
+  if (fd < 0) { return 1; }
+  if (ftruncate(fd, sizeof(ShmEngineRegion)) < 0) { close(fd); return 1; }
+  void* mem = mmap(nullptr, sizeof(ShmEngineRegion), PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd, 0);
+  close(fd);
+  if (mem == MAP_FAILED) { return 1; }
+
+  ShmEngineRegion* region = static_cast<ShmEngineRegion*>(mem);
+  region->magic.store(0);
+  region->stop.store(0);
+  region->freeClients.store((1u << SHM_MAX_CLIENTS) - 1);
+  region->requests.init();
+  for (int i = 0; i < SHM_MAX_CLIENTS; i++) { region->responses[i].init(); }
+  region->magic.store(ShmEngineRegion::MAGIC, memory_order_release);
+
+  ShmMoveRequest req;
+  while (region->requests.pop(req, region->stop)) {
+    // Requests come from other processes: check every field before use
+    ShmMoveResponse rep = {req.id, -1, SHM_BAD_REQUEST};
+    bool valid = (req.player == USER || req.player == COMPUTER) && req.strategy <= GENIOUS
+              && req.position < POSITION_CODES;
+    int board[3][3];
+    if (valid) {
+      decodeBoard(req.position, board);
+      rep.status = isGameOver(board);
+    }
+    if (valid && rep.status == IN_PROGRESS) {
+      Cell c = chooseMove(board, req.player, req.strategy);
+      rep.cell = c.row * 3 + c.col;
+      board[c.row][c.col] = req.player;
+      rep.status = isGameOver(board);
+    }
+    if (req.client < SHM_MAX_CLIENTS) { region->responses[req.client].push(rep); }
+  }
+
+  munmap(mem, sizeof(ShmEngineRegion));
+  shm_unlink(name);
+  return 0;
+}
+
+ShmEngineClient::~ShmEngineClient() {
+  if (!region_) { return; }
+  if (claimed_) {
+    // Answers still on their way would land in the next client's queue
+    ShmMoveResponse rep;
+    while (outstanding_ > 0 && region_->responses[client_].pop(rep, region_->stop)) { outstanding_--; }
+    if (outstanding_ == 0) {
+      region_->responses[client_].init();
+      region_->freeClients.fetch_or(1u << client_, memory_order_release);
+    }
+  }
+  munmap(region_, sizeof(ShmEngineRegion));
+}
+
+bool ShmEngineClient::open(const char* name, int timeoutMs) {
+  chrono::steady_clock::time_point deadline = chrono::steady_clock::now() + chrono::milliseconds(timeoutMs);
+  for (;;) {
+    int fd = shm_open(name, O_RDWR, 0600);
+    if (fd >= 0) {
+      struct stat st;
+      if (fstat(fd, &st) == 0 && (size_t)st.st_size >= sizeof(ShmEngineRegion)) {
+        void* mem = mmap(nullptr, sizeof(ShmEngineRegion), PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd, 0);
+        close(fd);
+        if (mem == MAP_FAILED) { return false; }
+        region_ = static_cast<ShmEngineRegion*>(mem);
+        break;
+      }
+      close(fd);
+    }
+    if (chrono::steady_clock::now() > deadline) { return false; }
+    this_thread::sleep_for(chrono::milliseconds(1));
+  }
+
+  // The engine sets the magic once the queues are initialized
+  while (region_->magic.load(memory_order_acquire) != ShmEngineRegion::MAGIC) {
+    if (chrono::steady_clock::now() > deadline) { return false; }
+    this_thread::sleep_for(chrono::milliseconds(1));
+  }
+  uint32_t free = region_->freeClients.load(memory_order_acquire);
+  do {
+    if (free == 0) { return false; }
+  } while (!region_->freeClients.compare_exchange_weak(free, free & (free - 1), memory_order_acquire));
+  client_  = __builtin_ctz(free);
+  claimed_ = true;
+  return true;
+}
+
+uint32_t ShmEngineClient::submit(int board[][3], int player, int strategy) {
+  ShmMoveRequest req = {nextId_++, (uint16_t)encodeBoard(board), (uint8_t)player, (uint8_t)strategy, client_};
+  region_->requests.push(req);
+  outstanding_++;
+  return req.id;
+}
+
+ShmMoveResponse ShmEngineClient::wait() {
+  ShmMoveResponse rep = {0, -1, 0};
+  if (region_->responses[client_].pop(rep, region_->stop)) { outstanding_--; }
+  return rep;
+}
+
+void ShmEngineClient::shutdownEngine() {
+  region_->stop.store(1, memory_order_release);
+  region_->requests.ready.notify();
+}
@@ -0,0 +1,98 @@
+#ifndef TICTACTOE_SHM_ENGINE_H
+#define TICTACTOE_SHM_ENGINE_H
+
+#include "shm_ring.h"
+#include <cstdint>
+
+/**
+ * Engine running in its own process, reached through POSIX shared memory
+ * instead of a pipe or socket. The frontend(s) push fixed-size move
+ * requests onto one queue; the engine answers on a response queue per
+ * client. Neither side makes a system call while the other is busy: a
+ * side only sleeps on a futex once its queue has stayed empty for a
+ * short spin, and is only woken by a futex call if it is asleep.
+ */
+
+enum {SHM_MAX_CLIENTS = 8};
+
+/** A move to compute. `position` is an `encodeBoard` code. */
+struct ShmMoveRequest {
+  uint32_t id;        // echoed in the response
+  uint16_t position;
+  uint8_t  player;    // USER or COMPUTER
+  uint8_t  strategy;
+  uint8_t  client;    // response queue to answer on
+};
+
+/** `ShmMoveResponse::status` of a request with an unknown player or strategy, or no such position. */
+enum {SHM_BAD_REQUEST = 0xFF};
+
+struct ShmMoveResponse {
+  uint32_t id;
+  int8_t   cell;      // chosen cell, or -1 if the game is already over or the request is bad
+  uint8_t  status;    // game status after the move, or SHM_BAD_REQUEST
+};
+
+/** Layout of the shared memory object. */
+struct ShmEngineRegion {
+  static const uint32_t MAGIC = 0x54545431;  // "TTT1"
+
+  std::atomic<uint32_t> magic;        // set last, once the queues are ready
+  std::atomic<uint32_t> stop;         // asks the engine to exit
+  std::atomic<uint32_t> freeClients;  // bit i set while responses[i] is unclaimed
+  ShmQueue<ShmMoveRequest, 4096>  requests;
+  ShmQueue<ShmMoveResponse, 1024> responses[SHM_MAX_CLIENTS];
+};
+
+/**
+ * Create the shared memory object `name` (ex: "/ttt-engine") and answer
+ * requests until a client calls `ShmEngineClient::shutdownEngine`.
+ *
+ * @return int  0 on a clean exit, 1 if the region could not be created
+ */
+int runShmEngine(const char* name);
+
+/**
+ * Frontend side of the shared-memory engine. Each client owns one
+ * response queue, so up to SHM_MAX_CLIENTS clients may share an engine
+ * at a time; a single client must not be used from several threads at
+ * once. Destroying a client waits for the answers to its outstanding
+ * requests and hands its queue back for the next client to claim.
+ */
+class ShmEngineClient {
+ public:
+  ShmEngineClient(): region_(nullptr), client_(0), claimed_(false), nextId_(0), outstanding_(0) {}
+  ~ShmEngineClient();
+
+  /**
+   * Attach to the engine serving `name`, waiting up to `timeoutMs` for
+   * it to finish creating the region.
+   *
+   * @return bool  false if the engine is not there or has no free slot
+   */
+  bool open(const char* name, int timeoutMs = 5000);
+
+  /** Queue a request without waiting for the answer. @return its id */
+  uint32_t submit(int board[][3], int player, int strategy);
+
+  /** Wait for the next response to one of our requests. */
+  ShmMoveResponse wait();
+
+  /** Round trip: submit one request and wait for its answer. */
+  ShmMoveResponse call(int board[][3], int player, int strategy) {
+    submit(board, player, strategy);
+    return wait();
+  }
+
+  /** Ask the engine process to exit. */
+  void shutdownEngine();
+
+ private:
+  ShmEngineRegion* region_;
+  uint8_t          client_;
+  bool             claimed_;
+  uint32_t         nextId_;
+  uint32_t         outstanding_;   // requests submitted and not yet waited for
+};
+
+#endif
@@ -0,0 +1,160 @@
+#ifndef TICTACTOE_SHM_RING_H
+#define TICTACTOE_SHM_RING_H
+
+#include <atomic>
+#include <climits>
+#include <cstddef>
+#include <cstdint>
+#include <linux/futex.h>
+#include <sched.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+/**
+ * Building blocks for queues that live in memory shared between
+ * processes. Everything here is plain data (no pointers) so it works at
+ * whatever address each process maps it, and relies on lock-free atomics.
+ */
+
+static_assert(std::atomic<uint64_t>::is_always_lock_free, "shared-memory atomics must be lock free");
+
+/** Spin-wait hint to the CPU. */
+inline void cpuRelax() {
+#if defined(__x86_64__) || defined(__i386__)
+  __builtin_ia32_pause();
+#elif defined(__aarch64__)
+  asm volatile("yield");
+#endif
+}
+
+/**
+ * How long a consumer spins on an empty queue before sleeping. Spinning
+ * only pays off when the producer can run on another CPU meanwhile.
+ */
+inline int defaultSpins() {
+  static const int spins = (sysconf(_SC_NPROCESSORS_ONLN) > 1) ? 2000 : 0;
+  return spins;
+}
+
+/**
+ * Lets a consumer sleep in the kernel when its queue is empty, while
+ * producers only pay for a system call when someone is actually asleep.
+ *
+ * Consumer:                              Producer:
+ *   e = prepareWait()                      publish item
+ *   if (item available) cancelWait()       notify()
+ *   else wait(e)
+ */
+struct EventCount {
+  std::atomic<uint32_t> epoch;
+  std::atomic<uint32_t> waiters;
+
+  void init() { epoch.store(0); waiters.store(0); }
+
+  uint32_t prepareWait() {
+    uint32_t e = epoch.load(std::memory_order_acquire);
+    waiters.fetch_add(1, std::memory_order_seq_cst);
+    return e;
+  }
+
+  void cancelWait() { waiters.fetch_sub(1, std::memory_order_relaxed); }
+
+  void wait(uint32_t e) {
+    // Returns at once if a notify() moved the epoch on after prepareWait
+    syscall(SYS_futex, reinterpret_cast<uint32_t*>(&epoch), FUTEX_WAIT, e, nullptr, nullptr, 0);
+    waiters.fetch_sub(1, std::memory_order_relaxed);
+  }
+
+  void notify() {
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    if (waiters.load(std::memory_order_relaxed) > 0) {
+      epoch.fetch_add(1, std::memory_order_release);
+      syscall(SYS_futex, reinterpret_cast<uint32_t*>(&epoch), FUTEX_WAKE, INT_MAX, nullptr, nullptr, 0);
+    }
+  }
+};
+
+/**
+ * Bounded lock-free queue of fixed-size records (Vyukov's sequence-per-
+ * slot design). Any number of producers may push concurrently; this code
+ * only ever has one consumer per queue. N must be a power of two.
+ */
+template <typename T, size_t N>
+struct ShmQueue {
+  static_assert((N & (N - 1)) == 0, "queue size must be a power of two");
+
+  struct Slot {
+    std::atomic<uint64_t> seq;
+    T                     record;
+  };
+
+  alignas(64) std::atomic<uint64_t> head;   // next slot to consume
+  alignas(64) std::atomic<uint64_t> tail;   // next slot to produce
+  alignas(64) EventCount            ready;  // signalled after each push
+  alignas(64) Slot                  slots[N];
+
+  void init() {
+    head.store(0);
+    tail.store(0);
+    ready.init();
+    for (size_t i = 0; i < N; i++) { slots[i].seq.store(i, std::memory_order_relaxed); }
+  }
+
+  /** @return bool  false if the queue is full */
+  bool tryPush(const T& record) {
+    uint64_t pos = tail.load(std::memory_order_relaxed);
+    Slot* slot;
+    for (;;) {
+      slot = &slots[pos & (N - 1)];
+      int64_t diff = (int64_t)slot->seq.load(std::memory_order_acquire) - (int64_t)pos;
+      if (diff == 0) {
+        if (tail.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)) { break; }
+      } else if (diff < 0) {
+        return false;
+      } else {
+        pos = tail.load(std::memory_order_relaxed);
+      }
+    }
+    slot->record = record;
+    slot->seq.store(pos + 1, std::memory_order_release);
+    return true;
+  }
+
+  /** Push, yielding the CPU while the queue is full, then wake the consumer. */
+  void push(const T& record) {
+    while (!tryPush(record)) { sched_yield(); }
+    ready.notify();
+  }
+
+  /** @return bool  false if the queue is empty */
+  bool tryPop(T& record) {
+    uint64_t pos = head.load(std::memory_order_relaxed);
+    Slot& slot = slots[pos & (N - 1)];
+    if (slot.seq.load(std::memory_order_acquire) != pos + 1) { return false; }
+    record = slot.record;
+    head.store(pos + 1, std::memory_order_relaxed);
+    slot.seq.store(pos + N, std::memory_order_release);
+    return true;
+  }
+
+  /**
+   * Pop, spinning for a while (see `defaultSpins`) before sleeping until a
+   * producer pushes. Returns false only if `stop` becomes non-zero while
+   * waiting.
+   */
+  bool pop(T& record, const std::atomic<uint32_t>& stop) {
+    int spins = defaultSpins();
+    for (;;) {
+      for (int i = 0; i < spins; i++) {
+        if (tryPop(record)) { return true; }
+        cpuRelax();
+      }
+      uint32_t e = ready.prepareWait();
+      if (tryPop(record)) { ready.cancelWait(); return true; }
+      if (stop.load(std::memory_order_acquire)) { ready.cancelWait(); return false; }
+      ready.wait(e);
+    }
+  }
+};
+
+#endif
@@ -0,0 +1,218 @@
+#ifndef TICTACTOE_SLAB_H
+#define TICTACTOE_SLAB_H
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <new>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+/** Occupancy of a pool, safe to read from any thread. */
+struct PoolStats {
+  size_t live;       // objects in use
+  size_t capacity;   // slots allocated so far, used or not
+  size_t bytes;      // memory held by the pool
+};
+
+/**
+ * Where a SlabPool gets its slabs from when they should not come from
+ * the heap, ex: a memory-mapped file that outlives the process.
+ */
+class SlabSource {
+ public:
+  virtual ~SlabSource() {}
+
+  /**
+   * Memory for slab number `index`, `bytes` long, zero-filled the first
+   * time it is handed out and returned as left after that.
+   *
+   * @return void*  The slab, or nullptr if there is no room for it
+   */
+  virtual void* slab(size_t index, size_t bytes) = 0;
+};
+
+/**
+ * Pool of T carved out of fixed-size slabs of PER_SLAB objects. Objects
+ * are addressed by index and never move, so pointers to them stay valid
+ * until they are destroyed. Creating and destroying an object is O(1):
+ * freed slots go on a free list threaded through the slots themselves,
+ * and a new slab is only allocated once every slot is in use. Slabs are
+ * kept until the pool goes away. Each slot also counts how many times it
+ * has been freed, so that a handle can tell a later occupant of its
+ * slot apart from the object it was made for.
+ *
+ * A pool may instead be `attach`ed to a SlabSource, which then holds the
+ * slabs: objects and their live marks are all inside them, so a new pool
+ * attached to the same source picks up where the old one stopped. T must then be trivially copyable.
+ *
+ * Not thread safe: a pool belongs to one thread, which does all creates
+ * and destroys; only `stats()` may be called from elsewhere.
+ */
+template <typename T, size_t PER_SLAB>
+class SlabPool {
+ public:
+  static const uint32_t NONE = 0xFFFFFFFF;
+
+  SlabPool(): source_(nullptr), free_(NONE), live_(0), capacity_(0) {}
+  SlabPool(const SlabPool&) = delete;
+  SlabPool& operator=(const SlabPool&) = delete;
+
+  ~SlabPool() {
+    if (source_) { return; }   // the objects live on in the source
+    forEach([](T& object) { object.~T(); });
+    for (Slab* slab : slabs_) { delete slab; }
+  }
+
+  /**
+   * Take slabs from `source` from now on, first taking back the ones
+   * holding `capacity` slots that a previous pool left there. The pool
+   * must be empty. `repair()` is called once those objects are back and
+   * may `put` and `erase` objects by index; the free list and counts are
+   * rebuilt after it returns.
+   *
+   * @return bool  false if the source could not provide the slabs
+   */
+  template <typename F>
+  bool attach(SlabSource* source, size_t capacity, F repair) {
+    static_assert(std::is_trivially_copyable<T>::value, "objects outlive the pool");
+    source_ = source;
+    for (size_t i = 0; i < (capacity + PER_SLAB - 1) / PER_SLAB; i++) {
+      if (!addSlab()) { return false; }
+    }
+    capacity_.store(capacity, std::memory_order_relaxed);
+    repair();
+
+    // Free slots are pushed in reverse so that low indices are reused first
+    size_t count = 0;
+    free_ = NONE;
+    for (size_t index = capacity; index-- > 0;) {
+      if (live(index)) {
+        count++;
+      } else {
+        slot(index).next = free_;
+        free_ = index;
+      }
+    }
+    live_.store(count, std::memory_order_relaxed);
+    return true;
+  }
+
+  /** Only within `attach`'s repair: make the object at `index` a T(args). */
+  template <typename... Args>
+  void put(uint32_t index, Args&&... args) {
+    new (slot(index).storage) T(std::forward<Args>(args)...);
+    markLive(index, true);
+  }
+
+  /** Only within `attach`'s repair: make the live object at `index` free, as `destroy` would. */
+  void erase(uint32_t index) {
+    if (!live(index)) { return; }
+    slabs_[index / PER_SLAB]->generation[index % PER_SLAB]++;
+    markLive(index, false);
+  }
+
+  /** Construct a T from `args`. @return its index, or NONE if a source ran out of room */
+  template <typename... Args>
+  uint32_t create(Args&&... args) {
+    uint32_t index = free_;
+    if (index != NONE) {
+      free_ = slot(index).next;
+    } else {
+      index = capacity_.load(std::memory_order_relaxed);
+      if (index % PER_SLAB == 0 && !addSlab()) { return NONE; }
+      capacity_.store(index + 1, std::memory_order_relaxed);
+    }
+    new (slot(index).storage) T(std::forward<Args>(args)...);
+    markLive(index, true);
+    live_.store(live_.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+    return index;
+  }
+
+  /** Destroy the object at `index`, which must be live. */
+  void destroy(uint32_t index) {
+    (*this)[index].~T();
+    // Generation first: a slot that is free in a source must never still
+    // carry the generation of the object it held
+    slabs_[index / PER_SLAB]->generation[index % PER_SLAB]++;
+    markLive(index, false);
+    slot(index).next = free_;
+    free_ = index;
+    live_.store(live_.load(std::memory_order_relaxed) - 1, std::memory_order_relaxed);
+  }
+
+  /** The object at `index`, which must be live. */
+  T& operator[](uint32_t index) {
+    return *std::launder(reinterpret_cast<T*>(slot(index).storage));
+  }
+
+  bool live(uint32_t index) const {
+    if (index >= capacity_.load(std::memory_order_relaxed)) { return false; }
+    const Slab& slab = *slabs_[index / PER_SLAB];
+    size_t i = index % PER_SLAB;
+    return (slab.live[i / 64] >> (i % 64)) & 1;
+  }
+
+  /** Times the slot at `index` has been freed by `destroy` or `erase`, modulo 256. */
+  uint8_t generation(uint32_t index) const { return slabs_[index / PER_SLAB]->generation[index % PER_SLAB]; }
+
+  /** Call `f(T&)` on every live object. */
+  template <typename F>
+  void forEach(F f) {
+    uint32_t capacity = capacity_.load(std::memory_order_relaxed);
+    for (uint32_t index = 0; index < capacity; index++) {
+      if (live(index)) { f((*this)[index]); }
+    }
+  }
+
+  /** Size of one slab, for a SlabSource to plan with. */
+  static constexpr size_t slabBytes() { return sizeof(Slab); }
+
+  PoolStats stats() const {
+    size_t capacity = capacity_.load(std::memory_order_relaxed);
+    size_t slabs = (capacity + PER_SLAB - 1) / PER_SLAB;
+    return PoolStats{live_.load(std::memory_order_relaxed), capacity, slabs * sizeof(Slab)};
+  }
+
+ private:
+  union Slot {
+    uint32_t next;   // free list link while the slot is unused
+    alignas(T) unsigned char storage[sizeof(T)];
+  };
+
+  struct Slab {
+    Slot     slots[PER_SLAB];
+    uint64_t live[(PER_SLAB + 63) / 64] = {};
+    uint8_t  generation[PER_SLAB] = {};
+  };
+
+  Slot& slot(uint32_t index) { return slabs_[index / PER_SLAB]->slots[index % PER_SLAB]; }
+
+  bool addSlab() {
+    if (!source_) {
+      slabs_.push_back(new Slab);
+      return true;
+    }
+    void* memory = source_->slab(slabs_.size(), sizeof(Slab));
+    if (!memory) { return false; }
+    slabs_.push_back(static_cast<Slab*>(memory));
+    return true;
+  }
+
+  void markLive(uint32_t index, bool on) {
+    Slab& slab = *slabs_[index / PER_SLAB];
+    size_t i = index % PER_SLAB;
+    uint64_t bit = uint64_t(1) << (i % 64);
+    slab.live[i / 64] = on ? (slab.live[i / 64] | bit) : (slab.live[i / 64] & ~bit);
+  }
+
+  SlabSource*                        source_;
+  std::vector<Slab*>                 slabs_;
+  uint32_t                           free_;
+  // Written only by the owning thread; atomic so `stats()` can be read elsewhere
+  std::atomic<size_t>                live_;
+  std::atomic<size_t>                capacity_;
+};
+
+#endif
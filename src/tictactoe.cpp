@@ -0,0 +1,113 @@
+#include "tictactoe.h"
+#include "engine.h"
+#include <new>
+
+// The C constants are part of the stable ABI; keep them in step with the engine
+static_assert(TTT_EMPTY == EMPTY && TTT_USER == USER && TTT_COMPUTER == COMPUTER, "player values");
+static_assert(TTT_IN_PROGRESS == IN_PROGRESS && TTT_USER_WON == USER_WON
+              && TTT_COMPUTER_WON == COMPUTER_WON && TTT_DRAW == DRAW, "status values");
+static_assert(TTT_RANDOM == RANDOM && TTT_SMART == SMART && TTT_GENIOUS == GENIOUS, "strategy values");
+
+/**
+ * State behind a `ttt_game` handle. This is the same state main() keeps
+ * for the interactive game: the board, the status and whose turn it is.
+ */
+struct ttt_game {
+  int board[3][3];
+  int strategy;
+  int toMove;
+  int status;
+};
+
+static bool validStrategy(int strategy) { return strategy >= RANDOM && strategy <= GENIOUS; }
+static bool validPlayer(int player)     { return player == USER || player == COMPUTER; }
+
+extern "C" {
+
+ttt_game* ttt_game_create(int strategy, int first) {
+  if (!validStrategy(strategy) || !validPlayer(first)) { return nullptr; }
+  ttt_game* game = new (std::nothrow) ttt_game();
+  if (game) {
+    game->strategy = strategy;
+    game->toMove   = first;
+    game->status   = IN_PROGRESS;
+  }
+  return game;
+}
+
+void ttt_game_destroy(ttt_game* game) {
+  delete game;
+}
+
+int ttt_game_reset(ttt_game* game, int first) {
+  if (!game || !validPlayer(first)) { return TTT_ERR_ARGUMENT; }
+  for (int row = 0; row < 3; row++) {
+    for (int col = 0; col < 3; col++) { game->board[row][col] = EMPTY; }
+  }
+  game->toMove = first;
+  game->status = IN_PROGRESS;
+  return 0;
+}
+
+int ttt_set_strategy(ttt_game* game, int strategy) {
+  if (!game || !validStrategy(strategy)) { return TTT_ERR_ARGUMENT; }
+  game->strategy = strategy;
+  return 0;
+}
+
+int ttt_apply_move(ttt_game* game, int cell) {
+  if (!game || cell < 0 || cell > 8)   { return TTT_ERR_ARGUMENT; }
+  if (game->status != IN_PROGRESS)     { return TTT_ERR_GAME_OVER; }
+  int& target = game->board[cell / 3][cell % 3];
+  if (target != EMPTY)                 { return TTT_ERR_OCCUPIED; }
+
+  target = game->toMove;
+  game->status = isGameOver(game->board);
+  game->toMove = (game->toMove == USER) ? COMPUTER : USER;
+  return game->status;
+}
+
+int ttt_choose_move(ttt_game* game) {
+  if (!game)                       { return TTT_ERR_ARGUMENT; }
+  if (game->status != IN_PROGRESS) { return TTT_ERR_GAME_OVER; }
+  Cell c = chooseMove(game->board, game->toMove, game->strategy);
+  return c.row * 3 + c.col;
+}
+
+int ttt_status(const ttt_game* game) {
+  return game ? game->status : TTT_ERR_ARGUMENT;
+}
+
+int ttt_to_move(const ttt_game* game) {
+  return game ? game->toMove : TTT_ERR_ARGUMENT;
+}
+
+int ttt_cell(const ttt_game* game, int cell) {
+  if (!game || cell < 0 || cell > 8) { return TTT_ERR_ARGUMENT; }
+  return game->board[cell / 3][cell % 3];
+}
+
+size_t ttt_play_batch(ttt_game* const* games, size_t count, int* cells) {
+  size_t played = 0;
+  for (size_t i = 0; i < count; i++) {
+    int cell = ttt_choose_move(games[i]);
+    if (cell >= 0) {
+      ttt_apply_move(games[i], cell);
+      played++;
+    }
+    if (cells) { cells[i] = cell; }
+  }
+  return played;
+}
+
+size_t ttt_apply_batch(ttt_game* const* games, size_t count, const int* cells, int* status) {
+  size_t applied = 0;
+  for (size_t i = 0; i < count; i++) {
+    int result = ttt_apply_move(games[i], cells[i]);
+    if (result >= 0) { applied++; }
+    if (status) { status[i] = result; }
+  }
+  return applied;
+}
+
+}
@@ -0,0 +1,197 @@
+#include "trace.h"
+#include "bitboard.h"
+#include "engine.h"
+#include <atomic>
+#include <cerrno>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <memory>
+#include <string>
+#if defined(__x86_64__)
+#include <x86intrin.h>
+#endif
+
+namespace {
+
+/**
+ * Event timestamps: the cycle counter where there is one, a fraction of
+ * the cost of reading the clock, converted to time only on export.
+ */
+inline uint64_t now() {
+#if defined(__x86_64__)
+  return __rdtsc();
+#else
+  return std::chrono::duration_cast<std::chrono::nanoseconds>(
+           std::chrono::steady_clock::now().time_since_epoch()).count();
+#endif
+}
+
+uint64_t nanosNow() {
+  return std::chrono::duration_cast<std::chrono::nanoseconds>(
+           std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+// Both clocks when the first ring was made, to convert ticks with
+std::atomic<bool> started(false);
+uint64_t          startTicks = 0;
+uint64_t          startNanos = 0;
+
+struct Event {
+  uint64_t ticks;   // see `now`
+  uint16_t kind;
+  uint16_t unused;
+  uint32_t arg;
+};
+
+/** One thread's events; only that thread writes them. */
+struct Ring {
+  std::unique_ptr<Event[]> events{new Event[TRACE_RING_EVENTS]};
+  std::atomic<uint64_t>    written{0};
+  int                      thread = 0;
+  Ring*                    next = nullptr;
+};
+
+std::atomic<Ring*> allRings(nullptr);
+std::atomic<int>   nextThread(1);
+std::atomic<uint32_t> nextGame(1);
+thread_local Ring* myRing = nullptr;
+
+Ring& ring() {
+  if (!myRing) {
+    if (!started.load(std::memory_order_acquire) && !started.exchange(true)) {
+      startNanos = nanosNow();
+      startTicks = now();
+    }
+    myRing = new Ring();
+    myRing->thread = nextThread.fetch_add(1, std::memory_order_relaxed);
+    myRing->next = allRings.load(std::memory_order_relaxed);
+    while (!allRings.compare_exchange_weak(myRing->next, myRing, std::memory_order_release)) {}
+  }
+  return *myRing;
+}
+
+const char* const DECISION_NAMES[DECISIONS] = {
+  "center", "win (playerCanWin)", "block (playerCanWin)", "corner", "fell back to ai_smart", "random"
+};
+
+const char* playerName(uint32_t player) {
+  return (player == USER) ? "user" : (player == COMPUTER) ? "computer" : "none";
+}
+
+const char* statusName(uint32_t status) {
+  switch (status) {
+    case USER_WON:     return "user_won";
+    case COMPUTER_WON: return "computer_won";
+    case DRAW:         return "draw";
+    default:           return "in_progress";
+  }
+}
+
+/** The event as a Chrome trace event, without the trailing comma. */
+void writeEvent(FILE* out, const Event& e, int thread, uint64_t origin, double nanosPerTick) {
+  double micros = (int64_t)(e.ticks - origin) * nanosPerTick / 1000.0;
+  fprintf(out, "{\"pid\":1,\"tid\":%d,\"ts\":%.3f,", thread, micros);
+  switch (e.kind) {
+    case TRACE_GAME_BEGIN:
+      fprintf(out, "\"ph\":\"b\",\"cat\":\"game\",\"id\":%u,\"name\":\"game\",\"args\":{\"first\":\"%s\"}}",
+              e.arg >> 8, playerName(e.arg & 0xFF));
+      break;
+    case TRACE_GAME_END:
+      fprintf(out, "\"ph\":\"e\",\"cat\":\"game\",\"id\":%u,\"name\":\"game\",\"args\":{\"status\":\"%s\"}}",
+              e.arg >> 8, statusName(e.arg & 0xFF));
+      break;
+    case TRACE_MOVE:
+      fprintf(out, "\"ph\":\"i\",\"s\":\"t\",\"name\":\"move\",\"args\":{\"player\":\"%s\",\"cell\":\"%c%u\"}}",
+              playerName(e.arg >> 8), 'A' + (e.arg & 0xFF) % 3, (e.arg & 0xFF) / 3);
+      break;
+    case TRACE_DECISION:
+      fprintf(out, "\"ph\":\"i\",\"s\":\"t\",\"name\":\"%s\"}",
+              (e.arg < DECISIONS) ? DECISION_NAMES[e.arg] : "decision");
+      break;
+    case TRACE_SEARCH_BEGIN:
+      fprintf(out, "\"ph\":\"B\",\"name\":\"search\",\"args\":{\"arg\":%u}}", e.arg);
+      break;
+    default:
+      fprintf(out, "\"ph\":\"E\",\"name\":\"search\"}");
+      break;
+  }
+}
+
+std::string exitPath;
+
+void writeAtExit() { writeChromeTrace(exitPath.c_str()); }
+
+}
+
+void traceRecord(int kind, uint32_t arg) {
+  Ring& mine = ring();
+  uint64_t n = mine.written.load(std::memory_order_relaxed);
+  Event& e = mine.events[n & (TRACE_RING_EVENTS - 1)];
+  e.ticks = now();
+  e.kind = kind;
+  e.arg = arg;
+  mine.written.store(n + 1, std::memory_order_release);
+}
+
+int moveDecision(int strategy, unsigned computer, unsigned user, int cell) {
+  // Both strategies take a free B1 before anything else, and GENIOUS a
+  // win before a block
+  if (cell < 0)            { return DECISION_RANDOM; }
+  if (cell == 4)           { return DECISION_CENTER; }
+  if (strategy != GENIOUS) { return DECISION_CORNER; }
+  if (cell == bitboardWinningCell(computer, user)) { return DECISION_WIN; }
+  if (cell == bitboardWinningCell(user, computer)) { return DECISION_BLOCK; }
+  return DECISION_FELL_BACK_SMART;
+}
+
+uint32_t traceGameBegin(int first) {
+  uint32_t game = nextGame.fetch_add(1, std::memory_order_relaxed) & 0xFFFFFF;
+  traceRecord(TRACE_GAME_BEGIN, game << 8 | first);
+  return game;
+}
+
+uint64_t traceEvents() {
+  uint64_t total = 0;
+  for (Ring* r = allRings.load(std::memory_order_acquire); r; r = r->next) {
+    total += r->written.load(std::memory_order_acquire);
+  }
+  return total;
+}
+
+bool writeChromeTrace(const char* path) {
+  FILE* out = fopen(path, "w");
+  if (!out) { return false; }
+  // Timestamps from the oldest event kept
+  uint64_t ticks = now(), nanos = nanosNow();
+  double nanosPerTick = (ticks > startTicks) ? double(nanos - startNanos) / (ticks - startTicks) : 1;
+  uint64_t origin = ~0ull;
+  for (Ring* r = allRings.load(std::memory_order_acquire); r; r = r->next) {
+    uint64_t written = r->written.load(std::memory_order_acquire);
+    uint64_t first = (written > TRACE_RING_EVENTS) ? written - TRACE_RING_EVENTS : 0;
+    if (written > first && r->events[first & (TRACE_RING_EVENTS - 1)].ticks < origin) {
+      origin = r->events[first & (TRACE_RING_EVENTS - 1)].ticks;
+    }
+  }
+  fprintf(out, "{\"displayTimeUnit\":\"ns\",\"traceEvents\":[\n");
+  bool any = false;
+  for (Ring* r = allRings.load(std::memory_order_acquire); r; r = r->next) {
+    uint64_t written = r->written.load(std::memory_order_acquire);
+    for (uint64_t i = (written > TRACE_RING_EVENTS) ? written - TRACE_RING_EVENTS : 0; i < written; i++) {
+      fprintf(out, any ? ",\n" : "");
+      writeEvent(out, r->events[i & (TRACE_RING_EVENTS - 1)], r->thread, origin, nanosPerTick);
+      any = true;
+    }
+  }
+  fprintf(out, "\n]}\n");
+  bool ok = !ferror(out);
+  int saved = errno;
+  if (fclose(out) != 0) { return false; }
+  errno = saved;
+  return ok;
+}
+
+void writeTraceAtExit(const char* path) {
+  exitPath = path;
+  atexit(writeAtExit);
+}
@@ -0,0 +1,110 @@
+#ifndef TICTACTOE_TRACE_H
+#define TICTACTOE_TRACE_H
+
+#include <cstdint>
+
+/**
+ * Tracing hooks in the engine's hot paths: games starting and ending,
+ * every move, the reason behind each strategy decision and the spans of
+ * search work. Built with the TTT_TRACE CMake option the hooks record
+ * into a binary ring buffer per thread, which can be written out as a
+ * Chrome trace (chrome://tracing, ui.perfetto.dev); without it
+ * `TRACE_ENABLED` is false and every hook compiles to nothing.
+ *
+ * An event is 16 bytes: a timestamp, its kind and one argument. Only
+ * the owning thread writes its ring, and once full it overwrites its
+ * oldest events, so recording never blocks or allocates after a
+ * thread's first event. Write the trace out once the threads are quiet,
+ * ex: at exit, or it may hold a few torn events.
+ */
+
+#ifndef TTT_TRACE
+#define TTT_TRACE 0
+#endif
+
+constexpr bool TRACE_ENABLED = TTT_TRACE;
+
+enum {
+  TRACE_GAME_BEGIN,     // arg: game << 8 | player moving first
+  TRACE_GAME_END,       // arg: game << 8 | status
+  TRACE_MOVE,           // arg: player << 8 | cell
+  TRACE_DECISION,       // arg: DECISION_...
+  TRACE_SEARCH_BEGIN,   // arg: what is searched, ex: a perft subtree
+  TRACE_SEARCH_END,
+  TRACE_KINDS
+};
+
+/** Why a strategy picked its cell. */
+enum {
+  DECISION_CENTER,           // B1 was free
+  DECISION_WIN,              // playerCanWin found a winning cell
+  DECISION_BLOCK,            // playerCanWin found the user's winning cell
+  DECISION_CORNER,           // a free corner
+  DECISION_FELL_BACK_SMART,  // GENIOUS fell back to SMART's corner
+  DECISION_RANDOM,           // no preference, a random cell
+  DECISIONS
+};
+
+/** Events per thread before the oldest are overwritten. */
+const unsigned TRACE_RING_EVENTS = 1 << 16;
+
+/** Record an event; only called when TRACE_ENABLED. */
+void traceRecord(int kind, uint32_t arg);
+
+inline void trace(int kind, uint32_t arg = 0) {
+  if constexpr (TRACE_ENABLED) { traceRecord(kind, arg); }
+}
+
+/**
+ * Why `strategy` claimed `cell` (-1 for a random cell) for the computer,
+ * given the bitboards before the move: one of DECISION_...
+ */
+int moveDecision(int strategy, unsigned computer, unsigned user, int cell);
+
+/**
+ * Record the decision behind a computer move that is being played, as
+ * opposed to a preference looked up for some other purpose, ex: building
+ * the move tables.
+ */
+inline void traceDecision(int strategy, unsigned computer, unsigned user, int cell) {
+  if constexpr (TRACE_ENABLED) { traceRecord(TRACE_DECISION, moveDecision(strategy, computer, user, cell)); }
+}
+
+/**
+ * Start tracing a game; games are numbered so that the many a thread
+ * may play at once, ex: as coroutines, can be told apart.
+ *
+ * @return uint32_t  The game's number, for `traceGameEnd` (0 untraced)
+ */
+uint32_t traceGameBegin(int first);
+
+inline uint32_t traceGame(int first) {
+  if constexpr (TRACE_ENABLED) { return traceGameBegin(first); }
+  return 0;
+}
+
+inline void traceGameEnd(uint32_t game, int status) { trace(TRACE_GAME_END, game << 8 | status); }
+
+/** A search span lasting as long as the object. */
+class TraceSpan {
+ public:
+  explicit TraceSpan(uint32_t arg) { trace(TRACE_SEARCH_BEGIN, arg); }
+  ~TraceSpan() { trace(TRACE_SEARCH_END); }
+  TraceSpan(const TraceSpan&) = delete;
+  TraceSpan& operator=(const TraceSpan&) = delete;
+};
+
+/** Events recorded so far, over every thread, including overwritten ones. */
+uint64_t traceEvents();
+
+/**
+ * Write every thread's ring to `path` in the Chrome trace event format.
+ *
+ * @return bool  false (errno set) if the file could not be written
+ */
+bool writeChromeTrace(const char* path);
+
+/** Write the trace to `path` when the process exits. */
+void writeTraceAtExit(const char* path);
+
+#endif